@@ -0,0 +1,272 @@
+#include <benchmark/benchmark.h>
+
+#include "ml/data.hpp"
+#include "ml/math.hpp"
+#include "ml/autograd.hpp"
+#include "ml/metrics.hpp"
+#include "ml/optimizers.hpp"
+#include "ml/regression.hpp"
+#include "ml/nets.hpp"
+
+#include <cmath>
+#include <vector>
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+using namespace ml::autograd;
+
+namespace
+{
+	// Synthetic CSV with a header and `columns` numeric columns, written once per shape
+	std::filesystem::path synthetic_csv(size_t rows, size_t columns)
+	{
+		auto path = std::filesystem::temp_directory_path() / ("ml_bench_" + std::to_string(rows) + "x" + std::to_string(columns) + ".csv");
+		if (std::filesystem::exists(path)) { return path; }
+
+		nd::random_generator generator(rows * 31 + columns);
+		nd::array<> values = nd::array<>::random({ rows, columns }, generator);
+
+		std::ofstream file(path);
+		for (size_t j = 0; j < columns; ++j)
+		{
+			file << "c" << j << ((j + 1 < columns) ? "," : "\n");
+		}
+		for (size_t i = 0; i < rows; ++i)
+		{
+			for (size_t j = 0; j < columns; ++j)
+			{
+				file << values(i, j) << ((j + 1 < columns) ? "," : "\n");
+			}
+		}
+		return path;
+	}
+
+	/*
+	* Logistic data with `features` standard normal features and labels drawn from a fixed random
+	* weight vector, so every run trains on the same problem.
+	*/
+	void synthetic_logistic(size_t rows, size_t features, ml::matrix_t& X, ml::matrix_t& y)
+	{
+		nd::random_generator generator(17);
+		X = nd::array<>::random_normal({ rows, features }, 0.0, 1.0, generator);
+		ml::matrix_t w = nd::array<>::random_normal({ features, 1 }, 0.0, 1.0, generator);
+		ml::matrix_t noise = nd::array<>::random({ rows, 1 }, generator);
+
+		ml::matrix_t p = ml::sigmoid(X * w);
+		y = ml::matrix_t({ rows, 1 });
+		for (size_t i = 0; i < rows; ++i)
+		{
+			y.data()[i] = (noise.data()[i] < p.data()[i]) ? 1.0 : 0.0;
+		}
+	}
+
+	/*
+	* Sparse logistic data in libsvm format: every row activates `perRow` of `features` binary
+	* features and its label is drawn from a fixed random weight vector. Written once per shape.
+	*/
+	std::filesystem::path synthetic_libsvm(size_t rows, size_t features, size_t perRow)
+	{
+		auto path = std::filesystem::temp_directory_path() / ("ml_bench_" + std::to_string(rows) + "x" + std::to_string(features) + "_" + std::to_string(perRow) + ".svm");
+		if (std::filesystem::exists(path)) { return path; }
+
+		nd::random_generator generator(29);
+		std::vector<double> w(features), picks(rows * perRow), noise(rows);
+		generator.normal(w.data(), w.size(), 0.0, 1.0);
+		generator.uniform(picks.data(), picks.size());
+		generator.uniform(noise.data(), noise.size());
+
+		std::ofstream file(path);
+		std::vector<size_t> active(perRow);
+		for (size_t i = 0; i < rows; ++i)
+		{
+			double margin = 0.0;
+			for (size_t k = 0; k < perRow; ++k)
+			{
+				active[k] = static_cast<size_t>(picks[i * perRow + k] * features);
+				margin += w[active[k]];
+			}
+			std::sort(active.begin(), active.end());
+			active.erase(std::unique(active.begin(), active.end()), active.end());
+
+			double p = 1.0 / (1.0 + std::exp(-margin / std::sqrt(static_cast<double>(perRow))));
+			file << ((noise[i] < p) ? 1 : 0);
+			for (size_t j : active)
+			{
+				file << " " << (j + 1) << ":1";
+			}
+			file << "\n";
+			active.resize(perRow);
+		}
+		return path;
+	}
+
+	void set_samples(benchmark::State& state, size_t samplesPerIteration)
+	{
+		state.counters["samples/s"] = benchmark::Counter(static_cast<double>(samplesPerIteration), benchmark::Counter::kIsIterationInvariantRate);
+	}
+}
+
+
+
+/*
+* DATA LOADING
+*/
+
+static void BM_ReadCsv(benchmark::State& state)
+{
+	size_t rows = static_cast<size_t>(state.range(0));
+	size_t columns = 16;
+	auto path = synthetic_csv(rows, columns);
+	data::csv_props props{ true, {} };
+
+	for (auto _ : state)
+	{
+		nd::array<> X = data::read_csv<double>(path.string(), props, data::default_column_parser{});
+		benchmark::DoNotOptimize(X.data());
+	}
+	state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * std::filesystem::file_size(path)));
+	state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * rows));
+}
+BENCHMARK(BM_ReadCsv)->RangeMultiplier(10)->Range(1000, 100000)->Unit(benchmark::kMillisecond);
+
+
+
+/*
+* AUTOGRAD
+*/
+
+// Backward sweep through a chain of `depth` blocks y = sigmoid(0.9 * y + x), x receives a gradient from every block
+static void BM_PartialWrtDepth(benchmark::State& state)
+{
+	size_t depth = static_cast<size_t>(state.range(0));
+	parameter x(ml::random({ 64, 1 }));
+	parameter y = x;
+	for (size_t d = 0; d < depth; ++d)
+	{
+		y = sigmoid(y * 0.9 + x);
+	}
+
+	for (auto _ : state)
+	{
+		ml::matrix_t grad = y.partial_wrt(x.id());
+		benchmark::DoNotOptimize(grad.data());
+	}
+	state.counters["nodes"] = static_cast<double>(3 * depth);
+}
+BENCHMARK(BM_PartialWrtDepth)->RangeMultiplier(2)->Range(2, 64);
+
+
+
+/*
+* TRAINING
+*/
+
+// One SGD::optimize epoch of logistic regression on 8192 rows, range(0) is the batch size (0 for full batch)
+static void BM_SGDLogistic(benchmark::State& state)
+{
+	size_t batchSize = static_cast<size_t>(state.range(0));
+	size_t rows = 8192;
+	size_t features = static_cast<size_t>(state.range(1));
+
+	ml::matrix_t X, y;
+	synthetic_logistic(rows, features, X, y);
+	ml::regression::logistic model(y, X);
+
+	ml::optimizers::SGD sgd(ml::metrics::cross_entropy, 0.01, 1, batchSize, false);
+	for (auto _ : state)
+	{
+		sgd.optimize(model, { X }, y);
+	}
+	set_samples(state, rows);
+}
+BENCHMARK(BM_SGDLogistic)->ArgsProduct({ { 0, 256 }, { 16, 128 } })->Unit(benchmark::kMillisecond);
+
+/*
+* One epoch over 16384 rows in batches of 2048 with every batch sharded across range(0) workers.
+* Timed in wall-clock time, since the work runs on the optimizer's pool rather than this thread.
+*/
+static void BM_DataParallelLogistic(benchmark::State& state)
+{
+	size_t workers = static_cast<size_t>(state.range(0));
+	size_t rows = 16384;
+
+	ml::matrix_t X, y;
+	synthetic_logistic(rows, 64, X, y);
+	ml::regression::logistic model(y, X);
+
+	ml::optimizers::SGD sgd(ml::metrics::cross_entropy, 0.01, 1, 2048, false);
+	sgd.set_workers(workers);
+	for (auto _ : state)
+	{
+		sgd.optimize(model, { X }, y);
+	}
+	set_samples(state, rows);
+}
+BENCHMARK(BM_DataParallelLogistic)->RangeMultiplier(2)->Range(1, 32)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+// As above for a 64-128-64-1 network, where the per-shard backward pass outweighs the reduction
+static void BM_DataParallelMlp(benchmark::State& state)
+{
+	size_t workers = static_cast<size_t>(state.range(0));
+	size_t rows = 16384;
+
+	ml::matrix_t X, y;
+	synthetic_logistic(rows, 64, X, y);
+	ml::nets::mlp net({ 64, 128, 64, 1 }, ml::layers::activation::relu, ml::layers::activation::sigmoid);
+
+	ml::optimizers::SGD sgd(ml::metrics::cross_entropy, 0.01, 1, 2048, false);
+	sgd.set_workers(workers);
+	for (auto _ : state)
+	{
+		sgd.optimize(net, { X }, y);
+	}
+	set_samples(state, rows);
+}
+BENCHMARK(BM_DataParallelMlp)->RangeMultiplier(2)->Range(1, 32)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+/*
+* Hogwild on a sparse logistic problem read from libsvm: 65536 rows over 2^16 features with 16
+* active per row, so concurrent updates rarely touch the same weight. range(0) is the number of
+* threads; each iteration trains 5 epochs from the same initial weights. Reports the final mean
+* log loss, the training seconds summed from history() and the seconds until the mean loss first
+* drops below 0.3 (-1 when it never does).
+*/
+static void BM_HogwildSparseLogistic(benchmark::State& state)
+{
+	size_t threads = static_cast<size_t>(state.range(0));
+	size_t rows = 65536;
+	size_t features = 1 << 16;
+	auto [X, y] = data::read_libsvm<double>(synthetic_libsvm(rows, features, 16).string(), features);
+
+	// Only the number of features matters to the model, Hogwild trains on the CSR rows
+	ml::regression::logistic initial(ml::matrix_t({ 1, 1 }), ml::matrix_t({ 1, features }));
+	const double target = 0.3;
+
+	double finalLoss = 0.0, seconds = 0.0, toTarget = -1.0;
+	for (auto _ : state)
+	{
+		state.PauseTiming();
+		ml::regression::logistic model = initial;
+		ml::optimizers::Hogwild hogwild(0.1, 5, threads);
+		hogwild.seed(3);
+		state.ResumeTiming();
+
+		hogwild.optimize(model, X, y);
+
+		seconds = 0.0;
+		toTarget = -1.0;
+		for (auto& epoch : hogwild.history())
+		{
+			seconds += epoch.seconds;
+			if (toTarget < 0.0 && epoch.cost / rows < target) { toTarget = seconds; }
+		}
+		finalLoss = hogwild.history().back().cost / rows;
+	}
+	state.counters["final_loss"] = finalLoss;
+	state.counters["train_s"] = seconds;
+	state.counters["s_to_target"] = toTarget;
+	set_samples(state, 5 * rows);
+}
+BENCHMARK(BM_HogwildSparseLogistic)->RangeMultiplier(2)->Range(1, 64)->Unit(benchmark::kMillisecond)->UseRealTime();
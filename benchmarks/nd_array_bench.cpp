@@ -0,0 +1,326 @@
+#include <benchmark/benchmark.h>
+
+#include "ndimensions/array.hpp"
+#include "ndimensions/random.hpp"
+
+#include <vector>
+#include <functional>
+
+namespace
+{
+	nd::array<> random_matrix(size_t rows, size_t columns, uint64_t seed = 1)
+	{
+		nd::random_generator generator(seed);
+		return nd::array<>::random({ rows, columns }, generator);
+	}
+
+	void set_items(benchmark::State& state, size_t itemsPerIteration)
+	{
+		state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * itemsPerIteration));
+		state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * itemsPerIteration * sizeof(double)));
+	}
+
+	void set_flops(benchmark::State& state, double flopsPerIteration)
+	{
+		state.counters["FLOPS"] = benchmark::Counter(flopsPerIteration, benchmark::Counter::kIsIterationInvariantRate);
+	}
+}
+
+
+
+/*
+* ELEMENTWISE
+*/
+
+static void BM_Add(benchmark::State& state)
+{
+	size_t n = static_cast<size_t>(state.range(0));
+	nd::array<> A = random_matrix(n, n, 1);
+	nd::array<> B = random_matrix(n, n, 2);
+
+	for (auto _ : state)
+	{
+		nd::array<> C = A + B;
+		benchmark::DoNotOptimize(C.data());
+	}
+	set_items(state, n * n);
+}
+BENCHMARK(BM_Add)->RangeMultiplier(4)->Range(64, 4096);
+
+static void BM_AddInto(benchmark::State& state)
+{
+	size_t n = static_cast<size_t>(state.range(0));
+	nd::array<> A = random_matrix(n, n, 1);
+	nd::array<> B = random_matrix(n, n, 2);
+	nd::array<> C;
+
+	for (auto _ : state)
+	{
+		nd::array<>::add_into(C, A, B);
+		benchmark::DoNotOptimize(C.data());
+	}
+	set_items(state, n * n);
+}
+BENCHMARK(BM_AddInto)->RangeMultiplier(4)->Range(64, 4096);
+
+static void BM_ScalarMultiply(benchmark::State& state)
+{
+	size_t n = static_cast<size_t>(state.range(0));
+	nd::array<> A = random_matrix(n, n);
+
+	for (auto _ : state)
+	{
+		nd::array<> C = A * 1.5;
+		benchmark::DoNotOptimize(C.data());
+	}
+	set_items(state, n * n);
+}
+BENCHMARK(BM_ScalarMultiply)->RangeMultiplier(4)->Range(64, 4096);
+
+static void BM_Hadamard(benchmark::State& state)
+{
+	size_t n = static_cast<size_t>(state.range(0));
+	nd::array<> A = random_matrix(n, n, 1);
+	nd::array<> B = random_matrix(n, n, 2);
+
+	for (auto _ : state)
+	{
+		nd::array<> C = A.hadamard(B);
+		benchmark::DoNotOptimize(C.data());
+	}
+	set_items(state, n * n);
+}
+BENCHMARK(BM_Hadamard)->RangeMultiplier(4)->Range(64, 4096);
+
+// map() goes through a std::function, map_into inlines the callable
+static void BM_Map(benchmark::State& state)
+{
+	size_t n = static_cast<size_t>(state.range(0));
+	nd::array<> A = random_matrix(n, n);
+
+	for (auto _ : state)
+	{
+		nd::array<> C = A.map([](double x) { return x * x + 1.0; });
+		benchmark::DoNotOptimize(C.data());
+	}
+	set_items(state, n * n);
+}
+BENCHMARK(BM_Map)->RangeMultiplier(4)->Range(64, 4096);
+
+static void BM_MapInto(benchmark::State& state)
+{
+	size_t n = static_cast<size_t>(state.range(0));
+	nd::array<> A = random_matrix(n, n);
+	nd::array<> C;
+
+	for (auto _ : state)
+	{
+		nd::array<>::map_into(C, A, [](double x) { return x * x + 1.0; });
+		benchmark::DoNotOptimize(C.data());
+	}
+	set_items(state, n * n);
+}
+BENCHMARK(BM_MapInto)->RangeMultiplier(4)->Range(64, 4096);
+
+
+
+/*
+* REDUCTIONS
+*/
+
+static void BM_Sum(benchmark::State& state)
+{
+	size_t n = static_cast<size_t>(state.range(0));
+	nd::array<> A = random_matrix(n, n);
+
+	for (auto _ : state)
+	{
+		benchmark::DoNotOptimize(A.sum());
+	}
+	set_items(state, n * n);
+}
+BENCHMARK(BM_Sum)->RangeMultiplier(4)->Range(64, 4096);
+
+// Axis 0 reduces along the contiguous dimension, axis 1 across it
+static void BM_SumAxis(benchmark::State& state)
+{
+	size_t n = static_cast<size_t>(state.range(0));
+	size_t axis = static_cast<size_t>(state.range(1));
+	nd::array<> A = random_matrix(n, n);
+
+	for (auto _ : state)
+	{
+		nd::array<> s = A.sum(axis);
+		benchmark::DoNotOptimize(s.data());
+	}
+	set_items(state, n * n);
+}
+BENCHMARK(BM_SumAxis)->ArgsProduct({ { 256, 1024, 4096 }, { 0, 1 } });
+
+static void BM_VarianceAxis(benchmark::State& state)
+{
+	size_t n = static_cast<size_t>(state.range(0));
+	size_t axis = static_cast<size_t>(state.range(1));
+	nd::array<> A = random_matrix(n, n);
+
+	for (auto _ : state)
+	{
+		nd::array<> v = A.variance(axis);
+		benchmark::DoNotOptimize(v.data());
+	}
+	set_items(state, n * n);
+}
+BENCHMARK(BM_VarianceAxis)->ArgsProduct({ { 256, 1024, 4096 }, { 0, 1 } });
+
+static void BM_ArgmaxRows(benchmark::State& state)
+{
+	size_t n = static_cast<size_t>(state.range(0));
+	nd::array<> A = random_matrix(n, 64);
+
+	for (auto _ : state)
+	{
+		nd::array<> classes = A.argmax(1);
+		benchmark::DoNotOptimize(classes.data());
+	}
+	set_items(state, n * 64);
+}
+BENCHMARK(BM_ArgmaxRows)->RangeMultiplier(8)->Range(512, 1 << 18);
+
+
+
+/*
+* LAYOUT
+*/
+
+static void BM_Transpose(benchmark::State& state)
+{
+	size_t n = static_cast<size_t>(state.range(0));
+	nd::array<> A = random_matrix(n, n);
+
+	for (auto _ : state)
+	{
+		nd::array<> At = A.T();
+		benchmark::DoNotOptimize(At.data());
+	}
+	set_items(state, n * n);
+}
+BENCHMARK(BM_Transpose)->RangeMultiplier(4)->Range(64, 4096);
+
+// Central block of half the rows and columns
+static void BM_Slice(benchmark::State& state)
+{
+	size_t n = static_cast<size_t>(state.range(0));
+	nd::array<> A = random_matrix(n, n);
+	std::vector<nd::range> block = { nd::range(n / 4, n / 4 + n / 2), nd::range(n / 4, n / 4 + n / 2) };
+
+	for (auto _ : state)
+	{
+		nd::array<> S = A(block);
+		benchmark::DoNotOptimize(S.data());
+	}
+	set_items(state, (n / 2) * (n / 2));
+}
+BENCHMARK(BM_Slice)->RangeMultiplier(4)->Range(64, 4096);
+
+static void BM_Concat(benchmark::State& state)
+{
+	size_t n = static_cast<size_t>(state.range(0));
+	size_t dimension = static_cast<size_t>(state.range(1));
+	std::vector<nd::array<>> parts;
+	for (uint64_t k = 0; k < 8; ++k)
+	{
+		parts.push_back(random_matrix(n, n, k));
+	}
+
+	for (auto _ : state)
+	{
+		nd::array<> C = nd::array<>::concatenate(std::span<const nd::array<>>(parts), dimension);
+		benchmark::DoNotOptimize(C.data());
+	}
+	set_items(state, 8 * n * n);
+}
+BENCHMARK(BM_Concat)->ArgsProduct({ { 64, 512, 2048 }, { 0, 1 } });
+
+static void BM_ConcatPairwise(benchmark::State& state)
+{
+	size_t n = static_cast<size_t>(state.range(0));
+	nd::array<> A = random_matrix(n, n, 1);
+	nd::array<> B = random_matrix(n, n, 2);
+
+	for (auto _ : state)
+	{
+		nd::array<> C = A.concat(B, 0);
+		benchmark::DoNotOptimize(C.data());
+	}
+	set_items(state, 2 * n * n);
+}
+BENCHMARK(BM_ConcatPairwise)->RangeMultiplier(4)->Range(64, 4096);
+
+
+
+/*
+* MATRIX PRODUCTS
+*/
+
+static void BM_Gemm(benchmark::State& state)
+{
+	size_t n = static_cast<size_t>(state.range(0));
+	nd::array<> A = random_matrix(n, n, 1);
+	nd::array<> B = random_matrix(n, n, 2);
+
+	for (auto _ : state)
+	{
+		nd::array<> C = A * B;
+		benchmark::DoNotOptimize(C.data());
+	}
+	set_flops(state, 2.0 * n * n * n);
+}
+BENCHMARK(BM_Gemm)->RangeMultiplier(2)->Range(32, 2048)->UseRealTime();
+
+static void BM_GemmInto(benchmark::State& state)
+{
+	size_t n = static_cast<size_t>(state.range(0));
+	nd::array<> A = random_matrix(n, n, 1);
+	nd::array<> B = random_matrix(n, n, 2);
+	nd::array<> C({ n, n }, 0.0);
+
+	for (auto _ : state)
+	{
+		nd::array<>::gemm_into(C, A, B, 1.0, 1.0);
+		benchmark::DoNotOptimize(C.data());
+	}
+	set_flops(state, 2.0 * n * n * n);
+}
+BENCHMARK(BM_GemmInto)->RangeMultiplier(2)->Range(32, 2048)->UseRealTime();
+
+// Tall data times an {n, 1} weight vector, as in the regression models
+static void BM_Gemv(benchmark::State& state)
+{
+	size_t rows = static_cast<size_t>(state.range(0));
+	size_t n = 256;
+	nd::array<> X = random_matrix(rows, n, 1);
+	nd::array<> w = random_matrix(n, 1, 2);
+
+	for (auto _ : state)
+	{
+		nd::array<> y = X * w;
+		benchmark::DoNotOptimize(y.data());
+	}
+	set_flops(state, 2.0 * rows * n);
+}
+BENCHMARK(BM_Gemv)->RangeMultiplier(4)->Range(1024, 1 << 18)->UseRealTime();
+
+static void BM_Gram(benchmark::State& state)
+{
+	size_t rows = static_cast<size_t>(state.range(0));
+	size_t n = 256;
+	nd::array<> X = random_matrix(rows, n);
+
+	for (auto _ : state)
+	{
+		nd::array<> G = X.gram();
+		benchmark::DoNotOptimize(G.data());
+	}
+	set_flops(state, 1.0 * rows * n * n);
+}
+BENCHMARK(BM_Gram)->RangeMultiplier(4)->Range(1024, 1 << 16)->UseRealTime();
@@ -1,6 +1,12 @@
 #pragma once
 
 #include "math.hpp"
+#include "kernels.hpp"
+
+#include <atomic>
+#include <functional>
+#include <unordered_map>
+#include <unordered_set>
 
 /*
 * https://github.com/mattjj/autodidact
@@ -8,7 +14,13 @@
 
 namespace ml::optimizers
 {
-	class SGD;
+	class optimizer;
+	class Hogwild;
+};
+
+namespace ml::serialization
+{
+	class checkpoint;
 };
 
 namespace ml::autograd
@@ -26,6 +38,7 @@ namespace ml::autograd
 			swap(_parents, other._parents);
 			swap(_partials, other._partials);
 			swap(_gradFns, other._gradFns);
+			swap(_sharedGradFn, other._sharedGradFn);
 			swap(fnName, other.fnName);
 		}
 
@@ -34,7 +47,8 @@ namespace ml::autograd
 			_id(_increment_id()),
 			_parents(),
 			_partials(),
-			_gradFns()
+			_gradFns(),
+			_sharedGradFn()
 		{
 		}
 
@@ -43,7 +57,8 @@ namespace ml::autograd
 			_id(_increment_id()),
 			_parents(),
 			_partials(),
-			_gradFns()
+			_gradFns(),
+			_sharedGradFn()
 		{
 		}
 
@@ -53,7 +68,8 @@ namespace ml::autograd
 			_id(other._id),
 			_parents(other._parents),
 			_partials(other._partials),
-			_gradFns(other._gradFns)
+			_gradFns(other._gradFns),
+			_sharedGradFn(other._sharedGradFn)
 		{
 		}
 
@@ -73,6 +89,8 @@ namespace ml::autograd
 
 		const matrix_t& value() const { return _value; }
 
+		matrix_t& value() { return _value; }
+
 		void set_value(const matrix_t& newVal)
 		{
 			_value = newVal;
@@ -80,22 +98,101 @@ namespace ml::autograd
 
 		matrix_t partial_wrt(size_t paramID) const
 		{
-			std::vector<std::pair<parameter, matrix_t>> stack = { {*this, ones(_value.shape())} };
+			return gradients({ paramID }).front();
+		}
 
+		/*
+		* Derivatives with respect to every parameter in `paramIDs` from a single backward sweep. Nodes
+		* are visited in reverse topological order, so the gradient flowing into a node is complete
+		* before it is propagated, and only nodes that lead to a requested parameter are expanded.
+		* Gradient functions write into or accumulate onto the parent's adjoint, and adjoints that are
+		* no longer needed are recycled as buffers for later ones of the same size.
+		*/
+		std::vector<matrix_t> gradients(const std::vector<size_t>& paramIDs) const
+		{
+			std::unordered_set<size_t> targets(paramIDs.begin(), paramIDs.end());
+			std::unordered_map<size_t, bool> leadsToTarget;
+			std::vector<const parameter*> order;
+
+			// Iterative post-order DFS, copies of a node share its id and are visited once
+			std::vector<std::pair<const parameter*, size_t>> stack = { { this, 0 } };
+			leadsToTarget.emplace(_id, false);
 			while (!stack.empty())
 			{
-				auto node = stack.back();
+				auto& [node, next] = stack.back();
+				if (next < node->_parents.size())
+				{
+					const parameter* parent = &node->_parents[next++];
+					if (leadsToTarget.emplace(parent->_id, false).second)
+					{
+						stack.push_back({ parent, 0 });
+					}
+					continue;
+				}
+
+				bool leads = targets.contains(node->_id);
+				for (auto& parent : node->_parents)
+				{
+					leads = leads || leadsToTarget[parent._id];
+				}
+				leadsToTarget[node->_id] = leads;
+				order.push_back(node);
 				stack.pop_back();
+			}
 
-				if (node.first._id == paramID) { return node.second; }
+			std::unordered_map<size_t, matrix_t> adjoints;
+			std::unordered_multimap<size_t, matrix_t> freeBuffers;
+			adjoints.emplace(_id, ones(_value.shape()));
+			for (auto it = order.rbegin(); it != order.rend(); ++it)
+			{
+				const parameter& node = **it;
+				auto adjoint = adjoints.find(node._id);
+				if (!leadsToTarget[node._id] || adjoint == adjoints.end() || node._parents.empty()) { continue; }
+				ND_PROFILE_SCOPE("backward", node.fnName);
+				if (node._sharedGradFn) { node._sharedGradFn(adjoint->second); }
 
-				auto& parents = node.first._parents;
-				for (size_t i = 0; i < parents.size(); ++i)
+				for (size_t i = 0; i < node._parents.size(); ++i)
 				{
-					auto gradFn = node.first._gradFns[i];
-					stack.push_back({ parents[i], gradFn(node.second, node.first._partials[i]) });
+					const parameter& parent = node._parents[i];
+					if (!leadsToTarget[parent._id]) { continue; }
+
+					auto existing = adjoints.find(parent._id);
+					if (existing != adjoints.end())
+					{
+						node._gradFns[i](existing->second, adjoint->second, node._partials[i], true);
+						continue;
+					}
+
+					matrix_t grad;
+					auto buffer = freeBuffers.find(parent._value.N());
+					if (buffer != freeBuffers.end())
+					{
+						grad = std::move(buffer->second);
+						grad.reshape(parent._value.shape());
+						freeBuffers.erase(buffer);
+					}
+					node._gradFns[i](grad, adjoint->second, node._partials[i], false);
+					adjoints.emplace(parent._id, std::move(grad));
+				}
+
+				// Intermediate gradients are not needed once they have been propagated
+				if (!targets.contains(node._id))
+				{
+					size_t n = adjoint->second.N();
+					freeBuffers.emplace(n, std::move(adjoint->second));
+					adjoints.erase(adjoint);
 				}
 			}
+
+			std::vector<matrix_t> result;
+			result.reserve(paramIDs.size());
+			for (auto id : paramIDs)
+			{
+				auto it = adjoints.find(id);
+				if (it == adjoints.end()) { throw std::invalid_argument("Parameter is not part of this graph"); }
+				result.push_back(it->second);
+			}
+			return result;
 		}
 
 		const std::vector<parameter>& parent_params() const { return _parents; }
@@ -108,6 +205,7 @@ namespace ml::autograd
 		{
 			parameter result;
 			result.fnName = "mat + mat";
+			ND_PROFILE_SCOPE("autograd", result.fnName);
 			result._value = _value + other._value;
 			result._parents = { *this, other };
 			result._partials = { ones(_value.shape()), ones(other._value.shape()) };
@@ -119,6 +217,7 @@ namespace ml::autograd
 		{
 			parameter result;
 			result.fnName = "mat - mat";
+			ND_PROFILE_SCOPE("autograd", result.fnName);
 			result._value = _value - other._value;
 			result._parents = { *this, other };
 			result._partials = { ones(_value.shape()), ones(other._value.shape()) * -1.0 };
@@ -130,20 +229,22 @@ namespace ml::autograd
 		{
 			parameter result;
 			result.fnName = "mat * mat";
+			ND_PROFILE_SCOPE("autograd", result.fnName);
 			result._value = _value * other._value;
 			result._parents = { *this, other };
 
 			if (_value.matrix() && other._value.matrix())
 			{
-				result._partials = { other._value.T(), _value.T()};
-				auto gradFn1 = [](const matrix_t& dzdy, const matrix_t& dydx)
+				// Partials are the operands themselves, the products run transposed instead of forming B' and A'
+				result._partials = { other._value, _value };
+				auto gradFn1 = [](matrix_t& grad, const matrix_t& dzdy, const matrix_t& dydx, bool accumulate)
 					{
-						return dzdy * dydx;
+						matrix_t::gemm_into(grad, dzdy, dydx, 1.0, accumulate ? 1.0 : 0.0, false, true);
 					};
 
-				auto gradFn2 = [](const matrix_t& dzdy, const matrix_t& dydx)
+				auto gradFn2 = [](matrix_t& grad, const matrix_t& dzdy, const matrix_t& dydx, bool accumulate)
 					{
-						return dydx * dzdy;
+						matrix_t::gemm_into(grad, dydx, dzdy, 1.0, accumulate ? 1.0 : 0.0, true, false);
 					};
 
 				result._gradFns = { gradFn1, gradFn2 };
@@ -151,9 +252,9 @@ namespace ml::autograd
 			else
 			{
 				result._partials = { other._value, _value };
-				auto gradFn = [](const matrix_t& dzdy, const matrix_t& dydx)
+				auto gradFn = [](matrix_t& grad, const matrix_t& dzdy, const matrix_t& dydx, bool accumulate)
 					{
-						return dzdy * dydx;
+						_store(grad, dzdy * dydx, accumulate);
 					};
 
 				result._gradFns = { gradFn, gradFn };
@@ -170,16 +271,18 @@ namespace ml::autograd
 
 			parameter result;
 			result.fnName = "dot";
+			ND_PROFILE_SCOPE("autograd", result.fnName);
 			result._value = _value.dot(other._value);
 			result._parents = { *this, other };
 			result._partials = { other._value, _value };
 
-			auto gradFn = [](const matrix_t& dzdy, const matrix_t& dydx)
+			// The upstream gradient is a scalar scaling the other operand
+			auto gradFn = [](matrix_t& grad, const matrix_t& dzdy, const matrix_t& dydx, bool accumulate)
 				{
-					return dzdy.dot(dydx);
+					_scale_into(grad, dydx, dzdy.data()[0], accumulate);
 				};
 
-			result._gradFns = { _default_grad_fn, _default_grad_fn };
+			result._gradFns = { gradFn, gradFn };
 			return result;
 		}
 
@@ -187,6 +290,7 @@ namespace ml::autograd
 		{
 			parameter result;
 			result.fnName = "hadamard";
+			ND_PROFILE_SCOPE("autograd", result.fnName);
 			result._value = _value.hadamard(other._value);
 			result._parents = { *this, other };
 			result._partials = { other._value, _value };
@@ -198,6 +302,7 @@ namespace ml::autograd
 		{
 			parameter result;
 			result.fnName = "scalar - mat";
+			ND_PROFILE_SCOPE("autograd", result.fnName);
 			result._value = scalar - X._value;
 			result._parents = { X };
 			result._partials = { -1.0 * ones(X._value.shape()) };
@@ -209,15 +314,11 @@ namespace ml::autograd
 		{
 			parameter result;
 			result.fnName = "mat * scalar";
+			ND_PROFILE_SCOPE("autograd", result.fnName);
 			result._value = _value * scalar;
 			result._parents = { *this };
 			result._partials = { scalar };
-
-			auto gradFn = [](const matrix_t& dzdy, const matrix_t& dydx)
-				{
-					return dzdy * dydx.at({ 0 });
-				};
-			result._gradFns = { gradFn };
+			result._gradFns = { _scalar_grad_fn };
 			return result;
 		}
 
@@ -227,15 +328,11 @@ namespace ml::autograd
 		{
 			parameter result;
 			result.fnName = "mat / scalar";
+			ND_PROFILE_SCOPE("autograd", result.fnName);
 			result._value = _value / scalar;
 			result._parents = { *this };
 			result._partials = { 1.0 / scalar };
-
-			auto gradFn = [](const matrix_t& dzdy, const matrix_t& dydx)
-				{
-					return dzdy * dydx.at({ 0 });
-				};
-			result._gradFns = { _default_grad_fn };
+			result._gradFns = { _scalar_grad_fn };
 			return result;
 		}
 
@@ -243,15 +340,11 @@ namespace ml::autograd
 		{
 			parameter result;
 			result.fnName = "scalar / mat";
+			ND_PROFILE_SCOPE("autograd", result.fnName);
 			result._value = scalar / X._value;
 			result._parents = { X };
 			auto xsq = X._value.hadamard(X._value);
 			result._partials = { -1 / xsq };
-
-			auto gradFn = [](const matrix_t& dzdy, const matrix_t& dydx)
-				{
-					return dzdy * dydx.at({ 0 });
-				};
 			result._gradFns = { _default_grad_fn };
 			return result;
 		}
@@ -263,30 +356,62 @@ namespace ml::autograd
 		{
 			parameter result;
 			result.fnName = "T";
+			ND_PROFILE_SCOPE("autograd", result.fnName);
 			result._value = _value.T();
 			result._parents = { *this };
-			result._partials = { _value };
-			result._gradFns = { _default_grad_fn };
+			result._partials = { matrix_t() };
+
+			auto gradFn = [](matrix_t& grad, const matrix_t& dzdy, const matrix_t& dydx, bool accumulate)
+				{
+					if (!accumulate) { matrix_t::transpose_into(grad, dzdy); }
+					else { grad += dzdy.T(); }
+				};
+			result._gradFns = { gradFn };
+			return result;
 		}
 
 	private:
-		typedef matrix_t(*_grad_fn)(const matrix_t&, const matrix_t&);
+		// Writes the gradient flowing to a parent into `grad`, or adds it to `grad` when accumulating
+		typedef std::function<void(matrix_t& grad, const matrix_t& dzdy, const matrix_t& dydx, bool accumulate)> _grad_fn;
+
+		static void _default_grad_fn(matrix_t& grad, const matrix_t& dzdy, const matrix_t& dydx, bool accumulate)
+		{
+			if (accumulate) { grad.add_hadamard(dzdy, dydx); }
+			else { matrix_t::hadamard_into(grad, dzdy, dydx); }
+		}
 
-		static matrix_t _default_grad_fn(const matrix_t& dzdy, const matrix_t& dydx)
+		// The partial is a 1x1 factor
+		static void _scalar_grad_fn(matrix_t& grad, const matrix_t& dzdy, const matrix_t& dydx, bool accumulate)
 		{
-			return dzdy.hadamard(dydx);
+			_scale_into(grad, dzdy, dydx.data()[0], accumulate);
+		}
+
+		static void _scale_into(matrix_t& grad, const matrix_t& X, double factor, bool accumulate)
+		{
+			if (accumulate) { grad.add_scaled(X, factor); }
+			else { matrix_t::multiply_into(grad, X, factor); }
+		}
+
+		// For gradients that are computed as a new array anyway
+		static void _store(matrix_t& grad, matrix_t&& value, bool accumulate)
+		{
+			if (accumulate) { grad += value; }
+			else { grad = std::move(value); }
 		}
 		
 		size_t _id;
 		matrix_t _value;
-		const char* fnName;
+		const char* fnName = "parameter";
 		std::vector<parameter> _parents;
 		std::vector<matrix_t> _partials;
 		std::vector<_grad_fn> _gradFns;
 
+		// Runs once per sweep with the node's gradient before its _gradFns, for work they have in common
+		std::function<void(const matrix_t& dzdy)> _sharedGradFn;
+
 		size_t _increment_id()
 		{
-			static size_t counter = 0;
+			static std::atomic<size_t> counter = 0;
 			return counter++;
 		}
 
@@ -298,6 +423,7 @@ namespace ml::autograd
 		{
 			parameter result;
 			result.fnName = "sqrt";
+			ND_PROFILE_SCOPE("autograd", result.fnName);
 			result._value = sqrt(X._value);
 			result._parents = { X };
 			result._partials = { d_sqrt(X._value) };
@@ -309,6 +435,7 @@ namespace ml::autograd
 		{
 			parameter result;
 			result.fnName = "exp";
+			ND_PROFILE_SCOPE("autograd", result.fnName);
 			result._value = exp(X._value);
 			result._parents = { X };
 			result._partials = { exp(X._value) };
@@ -320,6 +447,7 @@ namespace ml::autograd
 		{
 			parameter result;
 			result.fnName = "log";
+			ND_PROFILE_SCOPE("autograd", result.fnName);
 			result._value = log(X._value);
 			result._parents = { X };
 			result._partials = { d_log(X._value) };
@@ -331,6 +459,7 @@ namespace ml::autograd
 		{
 			parameter result;
 			result.fnName = "sin";
+			ND_PROFILE_SCOPE("autograd", result.fnName);
 			result._value = sin(X._value);
 			result._parents = { X };
 			result._partials = { d_sin(X._value) };
@@ -342,6 +471,7 @@ namespace ml::autograd
 		{
 			parameter result;
 			result.fnName = "cos";
+			ND_PROFILE_SCOPE("autograd", result.fnName);
 			result._value = cos(X._value);
 			result._parents = { X };
 			result._partials = { d_cos(X._value) };
@@ -353,6 +483,7 @@ namespace ml::autograd
 		{
 			parameter result;
 			result.fnName = "tan";
+			ND_PROFILE_SCOPE("autograd", result.fnName);
 			result._value = tan(X._value);
 			result._parents = { X };
 			result._partials = { d_tan(X._value) };
@@ -364,6 +495,7 @@ namespace ml::autograd
 		{
 			parameter result;
 			result.fnName = "sigmoid";
+			ND_PROFILE_SCOPE("autograd", result.fnName);
 			result._value = sigmoid(X._value);
 			result._parents = { X };
 			result._partials = { d_sigmoid(X._value) };
@@ -375,12 +507,122 @@ namespace ml::autograd
 		{
 			parameter result;
 			result.fnName = "softmax";
+			ND_PROFILE_SCOPE("autograd", result.fnName);
 			result._value = softmax(X._value);
 			result._parents = { X };
 			result._partials = { d_softmax(X._value) };
 			result._gradFns = { parameter::_default_grad_fn };
 			return result;
 		}
+
+		/*
+		* Product of a constant sparse input and a dense parameter. The node keeps a reference to the
+		* sparse buffers and its backward pass computes X' * dz without forming X' or a dense X.
+		*/
+		friend parameter operator*(const sparse_t& X, const parameter& W)
+		{
+			parameter result;
+			result.fnName = "sparse * mat";
+			ND_PROFILE_SCOPE("autograd", result.fnName);
+			result._value = X * W._value;
+			result._parents = { W };
+			result._partials = { matrix_t() };
+
+			auto gradFn = [X](matrix_t& grad, const matrix_t& dzdy, const matrix_t& dydx, bool accumulate)
+				{
+					_store(grad, X.transpose_multiply(dzdy), accumulate);
+				};
+			result._gradFns = { gradFn };
+			return result;
+		}
+
+		/*
+		* Fused dense layer f(X * W + b). The forward pass runs kernels::dense_forward. In the backward
+		* sweep the node's shared step computes dZ and the bias gradient once from the saved activations,
+		* and the parents' gradients are X' dZ, dZ W' and the cached column sums, so no intermediate
+		* pre-activation, bias broadcast or Jacobian is ever stored. Later sweeps reuse the cache buffers.
+		*/
+		friend parameter fused_dense(const parameter& X, const parameter& W, const parameter& b, kernels::activation f)
+		{
+			struct saved
+			{
+				matrix_t X;
+				matrix_t W;
+				matrix_t out;
+				kernels::activation f;
+				matrix_t dZ;
+				matrix_t db;
+			};
+
+			parameter result;
+			result.fnName = "fused_dense";
+			ND_PROFILE_SCOPE("autograd", result.fnName);
+			kernels::dense_forward(X._value, W._value, b._value, f, result._value);
+
+			auto state = std::make_shared<saved>(saved{ X._value, W._value, result._value, f, matrix_t(), matrix_t() });
+			result._parents = { X, W, b };
+			result._partials = { matrix_t(), matrix_t(), matrix_t() };
+
+			result._sharedGradFn = [state](const matrix_t& dzdy)
+				{
+					kernels::dense_backward_activation(state->out, dzdy, state->f, state->dZ, state->db);
+				};
+
+			auto gradX = [state](matrix_t& grad, const matrix_t& dzdy, const matrix_t& dydx, bool accumulate)
+				{
+					matrix_t::gemm_into(grad, state->dZ, state->W, 1.0, accumulate ? 1.0 : 0.0, false, true);
+				};
+
+			auto gradW = [state](matrix_t& grad, const matrix_t& dzdy, const matrix_t& dydx, bool accumulate)
+				{
+					matrix_t::gemm_into(grad, state->X, state->dZ, 1.0, accumulate ? 1.0 : 0.0, true, false);
+				};
+
+			auto gradB = [state](matrix_t& grad, const matrix_t& dzdy, const matrix_t& dydx, bool accumulate)
+				{
+					if (accumulate) { grad += state->db; }
+					else { grad = state->db; }
+				};
+
+			result._gradFns = { gradX, gradW, gradB };
+			return result;
+		}
+
+		friend parameter softmax_cross_entropy(const parameter& logits, const parameter& y)
+		{
+			parameter result;
+			result.fnName = "softmax_cross_entropy";
+			ND_PROFILE_SCOPE("autograd", result.fnName);
+			matrix_t dlogits;
+			softmax_cross_entropy(logits._value, y._value, result._value, dlogits);
+			result._parents = { logits };
+			result._partials = { std::move(dlogits) };
+
+			// The upstream gradient holds one value per sample, which scales that sample's row
+			auto gradFn = [](matrix_t& grad, const matrix_t& dzdy, const matrix_t& dydx, bool accumulate)
+				{
+					size_t N = dydx.shape()[0];
+					if (grad.shape() != dydx.shape())
+					{
+						if (accumulate) { throw std::invalid_argument("Cannot accumulate into an array of a different shape"); }
+						grad = matrix_t(dydx.shape());
+					}
+
+					double* pg = grad.data();
+					const double* px = dydx.data();
+					const double* scale = dzdy.data();
+					for (size_t k = 0; k < dydx.shape()[1]; ++k)
+					{
+						for (size_t i = 0; i < N; ++i)
+						{
+							double g = px[k * N + i] * scale[i];
+							pg[k * N + i] = accumulate ? pg[k * N + i] + g : g;
+						}
+					}
+				};
+			result._gradFns = { gradFn };
+			return result;
+		}
 	};
 
 
@@ -389,10 +631,16 @@ namespace ml::autograd
 	public:
 		virtual parameter operator()(const std::vector<parameter>& params) const = 0;
 
+		// Models that support sparse inputs override this, X holds one sample per row
+		virtual parameter operator()(const sparse_t& X) const { throw std::invalid_argument("Model does not accept sparse inputs"); }
+
 	protected:
 		virtual std::vector<size_t> _trainable_param_ids() const { return {}; }
 		virtual void _update_parameter(size_t id, const matrix_t& delta) {}
+		virtual matrix_t& _parameter_value(size_t id) { throw std::invalid_argument("Model has no trainable parameter with this id"); }
 
-		friend class ml::optimizers::SGD;
+		friend class ml::optimizers::optimizer;
+		friend class ml::optimizers::Hogwild;
+		friend class ml::serialization::checkpoint;
 	};
 }
\ No newline at end of file
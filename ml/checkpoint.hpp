@@ -0,0 +1,569 @@
+#pragma once
+
+#include "optimizers.hpp"
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <filesystem>
+#include <map>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <optional>
+
+namespace ml::serialization
+{
+	using namespace ml::autograd;
+
+	/*
+	* FILE FORMAT (version 1, little-endian)
+	*
+	*   header  "MLCK", uint32 version, uint64 number of tensors
+	*   index   per tensor: uint32 name length, name, uint32 dtype, uint32 rank, uint64 shape[rank],
+	*           uint64 offset of its values from the start of the file
+	*   data    the values of every tensor in nd::array (column-major) order, each aligned to 64 bytes
+	*           so a mapped file can be used in place
+	*/
+	constexpr char file_magic[4] = { 'M', 'L', 'C', 'K' };
+	constexpr uint32_t file_version = 1;
+	constexpr size_t data_alignment = 64;
+
+	enum class dtype : uint32_t
+	{
+		f64 = 1
+	};
+
+	typedef std::map<std::string, matrix_t> tensor_map;
+
+	inline size_t _align(size_t offset) { return (offset + data_alignment - 1) / data_alignment * data_alignment; }
+
+	/*
+	* Writes all tensors to `path`. The file is written next to the target and renamed over it when
+	* complete, so readers never see a partially written checkpoint.
+	*/
+	inline void write_tensors(const std::string& path, const tensor_map& tensors)
+	{
+		size_t indexEnd = sizeof(file_magic) + sizeof(uint32_t) + sizeof(uint64_t);
+		for (auto& [name, value] : tensors)
+		{
+			indexEnd += sizeof(uint32_t) + name.size() + 2 * sizeof(uint32_t) + value.dims() * sizeof(uint64_t) + sizeof(uint64_t);
+		}
+
+		std::vector<uint64_t> offsets;
+		size_t offset = _align(indexEnd);
+		for (auto& [name, value] : tensors)
+		{
+			offsets.push_back(offset);
+			offset = _align(offset + value.N() * sizeof(double));
+		}
+
+		std::string tmpPath = path + ".tmp";
+		{
+			std::ofstream out(tmpPath, std::ios::binary | std::ios::trunc);
+			if (!out.is_open()) { throw std::invalid_argument("Could not open " + tmpPath); }
+
+			auto write = [&out](const auto& value) { out.write(reinterpret_cast<const char*>(&value), sizeof(value)); };
+
+			out.write(file_magic, sizeof(file_magic));
+			write(file_version);
+			write(static_cast<uint64_t>(tensors.size()));
+
+			size_t k = 0;
+			for (auto& [name, value] : tensors)
+			{
+				write(static_cast<uint32_t>(name.size()));
+				out.write(name.data(), name.size());
+				write(static_cast<uint32_t>(dtype::f64));
+				write(static_cast<uint32_t>(value.dims()));
+				for (auto n : value.shape()) { write(static_cast<uint64_t>(n)); }
+				write(offsets[k++]);
+			}
+
+			k = 0;
+			for (auto& [name, value] : tensors)
+			{
+				size_t position = static_cast<size_t>(out.tellp());
+				std::vector<char> padding(offsets[k++] - position, 0);
+				out.write(padding.data(), padding.size());
+				out.write(reinterpret_cast<const char*>(value.data()), value.N() * sizeof(double));
+			}
+
+			if (!out.good()) { throw std::invalid_argument("Could not write " + tmpPath); }
+		}
+
+		std::filesystem::rename(tmpPath, path);
+	}
+
+
+
+	/*
+	* Read-only file mapped copy-on-write: pages are shared with the page cache until written to,
+	* and writes stay private to the process.
+	*/
+	class mapped_file
+	{
+	public:
+
+		explicit mapped_file(const std::string& path)
+			: _data(nullptr),
+			_size(0)
+		{
+#ifdef _WIN32
+			_file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+			if (_file == INVALID_HANDLE_VALUE) { throw std::invalid_argument("Could not open " + path); }
+
+			LARGE_INTEGER size;
+			if (!GetFileSizeEx(_file, &size))
+			{
+				CloseHandle(_file);
+				throw std::invalid_argument("Could not read the size of " + path);
+			}
+			_size = static_cast<size_t>(size.QuadPart);
+
+			_mapping = CreateFileMappingA(_file, nullptr, PAGE_WRITECOPY, 0, 0, nullptr);
+			if (_mapping == nullptr)
+			{
+				CloseHandle(_file);
+				throw std::invalid_argument("Could not map " + path);
+			}
+
+			_data = static_cast<std::byte*>(MapViewOfFile(_mapping, FILE_MAP_COPY, 0, 0, 0));
+			if (_data == nullptr)
+			{
+				CloseHandle(_mapping);
+				CloseHandle(_file);
+				throw std::invalid_argument("Could not map " + path);
+			}
+#else
+			int fd = open(path.c_str(), O_RDONLY);
+			if (fd < 0) { throw std::invalid_argument("Could not open " + path); }
+
+			struct stat info;
+			if (fstat(fd, &info) != 0)
+			{
+				close(fd);
+				throw std::invalid_argument("Could not read the size of " + path);
+			}
+			_size = static_cast<size_t>(info.st_size);
+
+			void* data = mmap(nullptr, _size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+			close(fd);
+			if (data == MAP_FAILED) { throw std::invalid_argument("Could not map " + path); }
+			_data = static_cast<std::byte*>(data);
+#endif
+		}
+
+		mapped_file(const mapped_file&) = delete;
+		mapped_file& operator=(const mapped_file&) = delete;
+
+		~mapped_file()
+		{
+#ifdef _WIN32
+			UnmapViewOfFile(_data);
+			CloseHandle(_mapping);
+			CloseHandle(_file);
+#else
+			munmap(_data, _size);
+#endif
+		}
+
+		inline std::byte* data() const { return _data; }
+
+		inline size_t size() const { return _size; }
+
+	private:
+		std::byte* _data;
+		size_t _size;
+#ifdef _WIN32
+		HANDLE _file;
+		HANDLE _mapping;
+#endif
+	};
+
+
+
+	/*
+	* A checkpoint file opened through a memory mapping. Model parameters are stored as "param.<k>"
+	* in the order of the model's trainable parameters, optimizer state as "optimizer.<name>".
+	*/
+	class checkpoint
+	{
+	public:
+
+		static tensor_map tensors_of(const differentiable& model)
+		{
+			auto& source = const_cast<differentiable&>(model);
+
+			tensor_map tensors;
+			std::vector<size_t> ids = source._trainable_param_ids();
+			for (size_t k = 0; k < ids.size(); ++k)
+			{
+				tensors["param." + std::to_string(k)] = source._parameter_value(ids[k]);
+			}
+			return tensors;
+		}
+
+		static tensor_map tensors_of(const differentiable& model, const optimizers::optimizer& opt)
+		{
+			tensor_map tensors = tensors_of(model);
+			for (auto& [name, value] : opt.export_state(model))
+			{
+				tensors["optimizer." + name] = value;
+			}
+			return tensors;
+		}
+
+		static void save(const std::string& path, const differentiable& model)
+		{
+			write_tensors(path, tensors_of(model));
+		}
+
+		static void save(const std::string& path, const differentiable& model, const optimizers::optimizer& opt)
+		{
+			write_tensors(path, tensors_of(model, opt));
+		}
+
+		explicit checkpoint(const std::string& path)
+			: _file(std::make_shared<mapped_file>(path)),
+			_version(0),
+			_entries()
+		{
+			_parse();
+		}
+
+		inline uint32_t version() const { return _version; }
+
+		inline bool contains(const std::string& name) const { return _entries.contains(name); }
+
+		std::vector<std::string> names() const
+		{
+			std::vector<std::string> result;
+			for (auto& [name, entry] : _entries) { result.push_back(name); }
+			return result;
+		}
+
+		// Non-owning array over the mapped values, valid while this checkpoint is alive
+		matrix_t view(const std::string& name) const
+		{
+			auto& entry = _entry(name);
+			return matrix_t::view(reinterpret_cast<double*>(_file->data() + entry.offset), entry.shape);
+		}
+
+		matrix_t copy(const std::string& name) const
+		{
+			matrix_t mapped = view(name);
+			return matrix_t(mapped);
+		}
+
+		/*
+		* Restores the parameters of `model`, which must have the same architecture as the saved one. With
+		* zeroCopy the parameters point straight into the mapping, so loading costs no copies and pages are
+		* only read on first use. The checkpoint must then outlive the model.
+		*/
+		void load(differentiable& model, bool zeroCopy = false) const
+		{
+			std::vector<size_t> ids = model._trainable_param_ids();
+			for (size_t k = 0; k < ids.size(); ++k)
+			{
+				std::string name = "param." + std::to_string(k);
+				matrix_t& target = model._parameter_value(ids[k]);
+				if (_entry(name).shape != target.shape()) { throw std::invalid_argument("Shape of " + name + " does not match the model"); }
+
+				target = zeroCopy ? view(name) : copy(name);
+			}
+		}
+
+		void load(optimizers::optimizer& opt, const differentiable& model) const
+		{
+			const std::string prefix = "optimizer.";
+
+			optimizers::optimizer::state_map state;
+			for (auto& [name, entry] : _entries)
+			{
+				if (name.starts_with(prefix)) { state[name.substr(prefix.size())] = copy(name); }
+			}
+			opt.import_state(model, state);
+		}
+
+	private:
+
+		struct _tensor_entry
+		{
+			nd::shape_t shape;
+			size_t offset;
+		};
+
+		std::shared_ptr<mapped_file> _file;
+		uint32_t _version;
+		std::map<std::string, _tensor_entry> _entries;
+
+		const _tensor_entry& _entry(const std::string& name) const
+		{
+			auto it = _entries.find(name);
+			if (it == _entries.end()) { throw std::invalid_argument("Checkpoint has no tensor named " + name); }
+			return it->second;
+		}
+
+		void _parse()
+		{
+			const std::byte* data = _file->data();
+			size_t size = _file->size();
+			size_t position = 0;
+
+			auto read = [&](void* dest, size_t n)
+				{
+					if (position + n > size) { throw std::invalid_argument("Checkpoint is truncated"); }
+					std::memcpy(dest, data + position, n);
+					position += n;
+				};
+
+			char magic[4];
+			read(magic, sizeof(magic));
+			if (std::memcmp(magic, file_magic, sizeof(magic)) != 0) { throw std::invalid_argument("File is not a checkpoint"); }
+
+			read(&_version, sizeof(_version));
+			if (_version == 0 || _version > file_version) { throw std::invalid_argument("Unsupported checkpoint version " + std::to_string(_version)); }
+
+			uint64_t nTensors;
+			read(&nTensors, sizeof(nTensors));
+			for (uint64_t t = 0; t < nTensors; ++t)
+			{
+				uint32_t nameLength, type, rank;
+				read(&nameLength, sizeof(nameLength));
+				std::string name(nameLength, '\0');
+				read(name.data(), nameLength);
+				read(&type, sizeof(type));
+				read(&rank, sizeof(rank));
+				if (rank > (size - position) / sizeof(uint64_t)) { throw std::invalid_argument("Checkpoint is truncated"); }
+
+				_tensor_entry entry{ nd::shape_t(rank), 0 };
+				size_t nItems = 1;
+				bool overflow = false;
+				for (auto& n : entry.shape)
+				{
+					uint64_t dim;
+					read(&dim, sizeof(dim));
+					n = static_cast<size_t>(dim);
+					overflow = overflow || dim > SIZE_MAX || (n != 0 && nItems > SIZE_MAX / n);
+					nItems *= n;
+				}
+
+				uint64_t offset;
+				read(&offset, sizeof(offset));
+				entry.offset = static_cast<size_t>(offset);
+
+				if (type != static_cast<uint32_t>(dtype::f64)) { throw std::invalid_argument("Unsupported dtype for " + name); }
+				if (overflow || nItems > SIZE_MAX / sizeof(double)) { throw std::invalid_argument("Shape of " + name + " is too large"); }
+				if (offset % data_alignment != 0) { throw std::invalid_argument("Values of " + name + " are not aligned to " + std::to_string(data_alignment) + " bytes"); }
+				if (offset > size || nItems * sizeof(double) > size - entry.offset) { throw std::invalid_argument("Checkpoint is truncated"); }
+
+				_entries.emplace(std::move(name), std::move(entry));
+			}
+		}
+	};
+
+
+
+	/*
+	* Streams row blocks of a design matrix X and targets y stored as tensors of a checkpoint file, e.g.
+	* one written with write_tensors(path, { { "X", X }, { "y", y } }), for regression::linear::update().
+	* The file is memory mapped, so only the pages of the current block are read and the page cache
+	* can drop them again; next() copies the block's rows out of the column-major tensors into
+	* buffers that are reused across calls. Memory is O(blockRows * features) however large the file.
+	*/
+	class block_reader
+	{
+	public:
+
+		explicit block_reader(const std::string& path, size_t blockRows = 8192, const std::string& yName = "y", const std::string& XName = "X")
+			: _file(path),
+			_y(_file.view(yName)),
+			_X(_file.view(XName)),
+			_blockRows(std::max<size_t>(blockRows, 1)),
+			_next(0)
+		{
+			if (!_X.matrix()) { throw std::invalid_argument("Design matrix " + XName + " must be two-dimensional"); }
+			if (_y.empty() || _y.shape()[0] != _X.shape()[0]) { throw std::invalid_argument(XName + " and " + yName + " must have the same number of rows"); }
+		}
+
+		inline size_t rows() const { return _X.shape()[0]; }
+
+		inline size_t features() const { return _X.shape()[1]; }
+
+		inline size_t blocks() const { return (rows() + _blockRows - 1) / _blockRows; }
+
+		inline void rewind() { _next = 0; }
+
+		// Reads the next block into y and X, returns false once all rows have been read
+		bool next(matrix_t& y, matrix_t& X)
+		{
+			if (_next >= rows()) { return false; }
+
+			size_t count = std::min(_blockRows, rows() - _next);
+			_copy_rows(_y, _next, count, y);
+			_copy_rows(_X, _next, count, X);
+			_next += count;
+			return true;
+		}
+
+	private:
+		checkpoint _file;
+		matrix_t _y;
+		matrix_t _X;
+		size_t _blockRows;
+		size_t _next;
+
+		// Rows [first, first + count) of every column, the columns of a block are contiguous runs in the file
+		static void _copy_rows(const matrix_t& source, size_t first, size_t count, matrix_t& block)
+		{
+			size_t n = source.shape()[0];
+			size_t columns = source.N() / n;
+			if (block.shape() != nd::shape_t{ count, columns }) { block = matrix_t({ count, columns }); }
+
+			for (size_t j = 0; j < columns; ++j)
+			{
+				std::memcpy(block.data() + j * count, source.data() + j * n + first, count * sizeof(double));
+			}
+		}
+	};
+
+
+
+	/*
+	* Writes checkpoints on a worker thread. submit() copies the weights (and optimizer state), which
+	* is a memcpy of the parameters, and returns; serialization and file I/O happen off the training
+	* thread. If a snapshot is still waiting when a new one arrives, only the newer one is written.
+	*/
+	class background_checkpointer
+	{
+	public:
+
+		explicit background_checkpointer(const std::string& path)
+			: _path(path),
+			_mutex(),
+			_ready(),
+			_idle(),
+			_pending(),
+			_busy(false),
+			_stopping(false),
+			_written(0),
+			_error(),
+			_worker([this]() { _work(); })
+		{
+		}
+
+		background_checkpointer(const background_checkpointer&) = delete;
+		background_checkpointer& operator=(const background_checkpointer&) = delete;
+
+		// Pending snapshots are written before the worker exits
+		~background_checkpointer()
+		{
+			{
+				std::lock_guard<std::mutex> lock(_mutex);
+				_stopping = true;
+			}
+			_ready.notify_all();
+			_worker.join();
+		}
+
+		void submit(const differentiable& model)
+		{
+			_submit(checkpoint::tensors_of(model));
+		}
+
+		void submit(const differentiable& model, const optimizers::optimizer& opt)
+		{
+			_submit(checkpoint::tensors_of(model, opt));
+		}
+
+		// Blocks until every submitted snapshot is on disk and rethrows the last write error, if any
+		void wait()
+		{
+			std::unique_lock<std::mutex> lock(_mutex);
+			_idle.wait(lock, [this]() { return !_pending && !_busy; });
+
+			if (_error)
+			{
+				auto error = _error;
+				_error = nullptr;
+				std::rethrow_exception(error);
+			}
+		}
+
+		size_t written() const
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			return _written;
+		}
+
+	private:
+		std::string _path;
+		mutable std::mutex _mutex;
+		std::condition_variable _ready;
+		std::condition_variable _idle;
+		std::optional<tensor_map> _pending;
+		bool _busy;
+		bool _stopping;
+		size_t _written;
+		std::exception_ptr _error;
+		std::thread _worker;
+
+		void _submit(tensor_map&& tensors)
+		{
+			{
+				std::lock_guard<std::mutex> lock(_mutex);
+				_pending = std::move(tensors);
+			}
+			_ready.notify_one();
+		}
+
+		void _work()
+		{
+			while (true)
+			{
+				tensor_map tensors;
+				{
+					std::unique_lock<std::mutex> lock(_mutex);
+					_ready.wait(lock, [this]() { return _stopping || _pending; });
+					if (!_pending) { return; }
+
+					tensors = std::move(*_pending);
+					_pending.reset();
+					_busy = true;
+				}
+
+				std::exception_ptr error;
+				try
+				{
+					write_tensors(_path, tensors);
+				}
+				catch (...)
+				{
+					error = std::current_exception();
+				}
+
+				{
+					std::lock_guard<std::mutex> lock(_mutex);
+					_busy = false;
+					if (error) { _error = error; }
+					else { _written++; }
+				}
+				_idle.notify_all();
+			}
+		}
+	};
+}
@@ -7,6 +7,7 @@
 #include <unordered_set>
 
 #include "ndimensions/array.hpp"
+#include "ndimensions/sparse.hpp"
 
 namespace data
 {
@@ -24,6 +25,39 @@ namespace data
 		}
 	};
 
+	inline std::vector<std::string> split_csv_line(const std::string& line)
+	{
+		std::stringstream linestream(line);
+		linestream >> std::ws;
+
+		std::vector<std::string> cells;
+		bool quoteIsOpen = false;
+		std::string cell;
+		while (linestream.good())
+		{
+			char c;
+			linestream >> c;
+			if (c == '"')
+			{
+				quoteIsOpen = !quoteIsOpen;
+			}
+			else if (c == ',' && !quoteIsOpen)
+			{
+				cells.push_back(cell);
+				cell.clear();
+				continue;
+			}
+
+			if (linestream.good())
+			{
+				cell.push_back(c);
+			}
+
+		}
+		cells.push_back(cell);
+		return cells;
+	}
+
 	template <typename T, class ColParser = default_column_parser>
 	nd::array<T> read_csv(const std::string& filepath, csv_props props, ColParser columnParser)
 	{
@@ -36,34 +70,7 @@ namespace data
 
 		while (std::getline(csvFile, line))
 		{
-			std::stringstream linestream(line);
-			linestream >> std::ws;
-
-			cells.push_back(std::vector<std::string>{});
-			bool quoteIsOpen = false;
-			std::string cell;
-			while (linestream.good())
-			{
-				char c;
-				linestream >> c;
-				if (c == '"')
-				{
-					quoteIsOpen = !quoteIsOpen;
-				}
-				else if (c == ',' && !quoteIsOpen)
-				{
-					cells.back().push_back(cell);
-					cell.clear();
-					continue;
-				}
-
-				if (linestream.good())
-				{
-					cell.push_back(c);
-				}
-				
-			}
-			cells.back().push_back(cell);
+			cells.push_back(split_csv_line(line));
 		}
 
 		size_t rows = (props.ignoreHeader) ? cells.size() - 1 : cells.size();
@@ -88,4 +95,162 @@ namespace data
 
 		return mat;
 	}
+
+	/*
+	* Reads a CSV file in blocks of rows so files larger than memory can be processed incrementally.
+	* The header row, if any, is read once and passed to the column parser for every block.
+	*/
+	template <typename T, class ColParser = default_column_parser>
+	class csv_reader
+	{
+	public:
+
+		csv_reader(const std::string& filepath, csv_props props, ColParser columnParser = ColParser{})
+			: _csvFile(filepath),
+			_columnsToExclude(props.excludedCols.begin(), props.excludedCols.end()),
+			_headers(),
+			_parser(columnParser)
+		{
+			if (!_csvFile.is_open()) { throw std::invalid_argument("Could not open " + filepath); }
+
+			std::string line;
+			if (props.ignoreHeader && std::getline(_csvFile, line))
+			{
+				_headers = split_csv_line(line);
+			}
+		}
+
+		bool next(nd::array<T>& block, size_t maxRows)
+		{
+			std::vector<std::vector<std::string>> cells;
+			std::string line;
+			while (cells.size() < maxRows && std::getline(_csvFile, line))
+			{
+				if (line.empty()) { continue; }
+				cells.push_back(split_csv_line(line));
+			}
+
+			if (cells.empty()) { return false; }
+			if (_headers.empty()) { _headers = cells.front(); }
+
+			size_t rows = cells.size();
+			size_t cols = cells.front().size();
+			block = nd::array<T>({ rows, cols - _columnsToExclude.size() });
+
+			size_t matCol = 0;
+			for (size_t c = 0; c < cols; ++c)
+			{
+				if (_columnsToExclude.contains(c)) { continue; }
+
+				for (size_t r = 0; r < rows; ++r)
+				{
+					block({ r, matCol }) = _parser(_headers[c], cells[r][c]);
+				}
+
+				matCol++;
+			}
+
+			return true;
+		}
+
+	private:
+		std::ifstream _csvFile;
+		std::unordered_set<size_t> _columnsToExclude;
+		std::vector<std::string> _headers;
+		ColParser _parser;
+	};
+
+	/*
+	* Reads a CSV file straight into CSR form. Rows are parsed in blocks through csv_reader, so only
+	* the non-zeros of the whole file and one dense block are held in memory at a time.
+	*/
+	template <typename T, class ColParser = default_column_parser>
+	nd::sparse_array<T> read_csv_sparse(const std::string& filepath, csv_props props, ColParser columnParser = ColParser{}, size_t blockRows = 4096)
+	{
+		using index_type = typename nd::sparse_array<T>::index_type;
+
+		csv_reader<T, ColParser> reader(filepath, props, columnParser);
+		std::vector<index_type> rowStart = { 0 };
+		std::vector<index_type> cols;
+		std::vector<T> values;
+		size_t nCols = 0;
+
+		nd::array<T> block;
+		while (reader.next(block, blockRows))
+		{
+			size_t rows = block.shape()[0];
+			nCols = block.shape()[1];
+			const T* px = block.data();
+
+			for (size_t r = 0; r < rows; ++r)
+			{
+				for (size_t c = 0; c < nCols; ++c)
+				{
+					if (px[c * rows + r] != T(0))
+					{
+						cols.push_back(static_cast<index_type>(c));
+						values.push_back(px[c * rows + r]);
+					}
+				}
+				rowStart.push_back(static_cast<index_type>(values.size()));
+			}
+		}
+
+		size_t nRows = rowStart.size() - 1;
+		return nd::sparse_array<T>({ nRows, nCols }, nd::sparse_format::csr, std::move(rowStart), std::move(cols), std::move(values));
+	}
+
+	/*
+	* Reads a file in libsvm format, one sample per line as `label index:value index:value ...` with
+	* one-based feature indices. Returns the CSR features and a column of labels. The
+	* number of features is inferred from the largest index unless `nFeatures` is given.
+	*/
+	template <typename T = double>
+	std::pair<nd::sparse_array<T>, nd::array<T>> read_libsvm(const std::string& filepath, size_t nFeatures = 0)
+	{
+		using index_type = typename nd::sparse_array<T>::index_type;
+
+		std::ifstream file(filepath);
+		if (!file.is_open()) { throw std::invalid_argument("Could not open " + filepath); }
+
+		std::vector<index_type> rowStart = { 0 };
+		std::vector<index_type> cols;
+		std::vector<T> values;
+		std::vector<T> labels;
+		size_t maxIndex = 0;
+
+		std::string line;
+		while (std::getline(file, line))
+		{
+			std::stringstream linestream(line);
+			std::string token;
+			if (!(linestream >> token) || token[0] == '#') { continue; }
+
+			labels.push_back(static_cast<T>(std::stod(token)));
+			while (linestream >> token)
+			{
+				if (token[0] == '#') { break; }
+
+				size_t colon = token.find(':');
+				if (colon == std::string::npos) { throw std::invalid_argument("Malformed libsvm feature: " + token); }
+
+				size_t index = std::stoul(token.substr(0, colon));
+				if (index == 0) { throw std::invalid_argument("libsvm feature indices start at 1"); }
+
+				cols.push_back(static_cast<index_type>(index - 1));
+				values.push_back(static_cast<T>(std::stod(token.substr(colon + 1))));
+				maxIndex = std::max(maxIndex, index);
+			}
+			rowStart.push_back(static_cast<index_type>(values.size()));
+		}
+
+		if (nFeatures == 0) { nFeatures = maxIndex; }
+		if (maxIndex > nFeatures) { throw std::invalid_argument("libsvm file has more features than requested"); }
+
+		size_t nRows = labels.size();
+		nd::array<T> y({ nRows, 1 });
+		std::copy(labels.begin(), labels.end(), y.data());
+
+		return { nd::sparse_array<T>({ nRows, nFeatures }, nd::sparse_format::csr, std::move(rowStart), std::move(cols), std::move(values)), y };
+	}
 }
\ No newline at end of file
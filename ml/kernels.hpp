@@ -0,0 +1,197 @@
+#pragma once
+
+#include "math.hpp"
+#include "ndimensions/parallel.hpp"
+#include "ndimensions/profiler.hpp"
+
+#include <mkl/mkl_cblas.h>
+
+namespace ml::kernels
+{
+	enum class activation
+	{
+		identity,
+		sigmoid,
+		relu,
+		tanh,
+		softmax
+	};
+
+	/*
+	* Output tiles are small enough to stay in L2 between the GEMM that writes them and the epilogue
+	* that adds the bias and applies the activation, so each activation is written once by BLAS and
+	* read and written once more while still cached.
+	*/
+	constexpr size_t tile_rows = 128;
+	constexpr size_t tile_cols = 64;
+
+	// Adds b (one value per column, may be null) and applies f to at most tile_rows rows in place
+	inline void bias_activation_tile(double* out, size_t ld, size_t rows, size_t cols, const double* b, activation f)
+	{
+		for (size_t j = 0; j < cols; ++j)
+		{
+			double* col = out + j * ld;
+			const double bj = b ? b[j] : 0.0;
+			switch (f)
+			{
+			case activation::sigmoid:
+				for (size_t i = 0; i < rows; ++i) { col[i] = 1.0 / (1.0 + std::exp(-(col[i] + bj))); }
+				break;
+			case activation::relu:
+				for (size_t i = 0; i < rows; ++i) { col[i] = std::max(col[i] + bj, 0.0); }
+				break;
+			case activation::tanh:
+				for (size_t i = 0; i < rows; ++i) { col[i] = std::tanh(col[i] + bj); }
+				break;
+			default:
+				for (size_t i = 0; i < rows; ++i) { col[i] += bj; }
+				break;
+			}
+		}
+
+		if (f != activation::softmax) { return; }
+
+		// Softmax tiles always span every column, the row maxima and sums are kept in a stack buffer
+		double rowMax[tile_rows];
+		double rowSum[tile_rows];
+		for (size_t i = 0; i < rows; ++i) { rowMax[i] = out[i]; rowSum[i] = 0.0; }
+		for (size_t j = 1; j < cols; ++j)
+		{
+			const double* col = out + j * ld;
+			for (size_t i = 0; i < rows; ++i) { rowMax[i] = std::max(rowMax[i], col[i]); }
+		}
+		for (size_t j = 0; j < cols; ++j)
+		{
+			double* col = out + j * ld;
+			for (size_t i = 0; i < rows; ++i)
+			{
+				col[i] = std::exp(col[i] - rowMax[i]);
+				rowSum[i] += col[i];
+			}
+		}
+		for (size_t j = 0; j < cols; ++j)
+		{
+			double* col = out + j * ld;
+			for (size_t i = 0; i < rows; ++i) { col[i] /= rowSum[i]; }
+		}
+	}
+
+	/*
+	* out = f(X * W + b) for a batch X (rows x nIn, leading dimension ldx), weights W (nIn x nOut),
+	* biases b (nOut, may be null) and output with leading dimension ldout. Each output tile is
+	* produced by its own GEMM and finished by the epilogue before the next tile is touched.
+	*/
+	inline void dense_forward(const double* X, size_t rows, size_t ldx, const double* W, size_t nIn, size_t nOut, const double* b, activation f, double* out, size_t ldout)
+	{
+		ND_PROFILE_SCOPE("kernels", "dense_forward");
+		ND_PROFILE_FLOPS(2.0 * rows * nIn * nOut);
+		size_t tileCols = (f == activation::softmax) ? nOut : tile_cols;
+		size_t rowTiles = (rows + tile_rows - 1) / tile_rows;
+		size_t colTiles = (nOut + tileCols - 1) / tileCols;
+
+		nd::parallel_for(0, rowTiles * colTiles, [&](size_t first, size_t last)
+			{
+				for (size_t t = first; t < last; ++t)
+				{
+					size_t r0 = (t / colTiles) * tile_rows;
+					size_t c0 = (t % colTiles) * tileCols;
+					size_t nRows = std::min(tile_rows, rows - r0);
+					size_t nCols = std::min(tileCols, nOut - c0);
+					double* tile = out + c0 * ldout + r0;
+
+					cblas_dgemm(CblasColMajor, CblasNoTrans, CblasNoTrans,
+						static_cast<int>(nRows), static_cast<int>(nCols), static_cast<int>(nIn),
+						1.0, X + r0, static_cast<int>(ldx), W + c0 * nIn, static_cast<int>(nIn),
+						0.0, tile, static_cast<int>(ldout));
+
+					bias_activation_tile(tile, ldout, nRows, nCols, b ? b + c0 : nullptr, f);
+				}
+			});
+	}
+
+	inline void dense_forward(const matrix_t& X, const matrix_t& W, const matrix_t& b, activation f, matrix_t& out)
+	{
+		if (!X.matrix() || !W.matrix() || X.shape()[1] != W.shape()[0]) { throw std::invalid_argument("Dense kernel requires X to be [n, a] and W to be [a, b]"); }
+		if (!b.empty() && b.N() != W.shape()[1]) { throw std::invalid_argument("Dense kernel requires one bias per output"); }
+
+		size_t rows = X.shape()[0];
+		if (out.shape() != nd::shape_t{ rows, W.shape()[1] }) { out = matrix_t({ rows, W.shape()[1] }); }
+
+		dense_forward(X.data(), rows, rows, W.data(), W.shape()[0], W.shape()[1], b.empty() ? nullptr : b.data(), f, out.data(), rows);
+	}
+
+	/*
+	* Turns the gradient with respect to the activations into the gradient with respect to the
+	* pre-activations, dZ, using only the stored activations `out`. The bias gradient (column sums
+	* of dZ) is accumulated in the same pass.
+	*/
+	inline void activation_backward(const double* out, const double* dOut, size_t rows, size_t cols, activation f, double* dZ, double* db)
+	{
+		ND_PROFILE_SCOPE("kernels", "activation_backward");
+		if (f == activation::softmax)
+		{
+			nd::parallel_for(0, rows, [&](size_t first, size_t last)
+				{
+					for (size_t i = first; i < last; ++i)
+					{
+						double dot = 0.0;
+						for (size_t j = 0; j < cols; ++j) { dot += dOut[j * rows + i] * out[j * rows + i]; }
+						for (size_t j = 0; j < cols; ++j) { dZ[j * rows + i] = out[j * rows + i] * (dOut[j * rows + i] - dot); }
+					}
+				}, tile_rows);
+
+			for (size_t j = 0; j < cols; ++j)
+			{
+				double sum = 0.0;
+				for (size_t i = 0; i < rows; ++i) { sum += dZ[j * rows + i]; }
+				db[j] = sum;
+			}
+			return;
+		}
+
+		nd::parallel_for(0, cols, [&](size_t first, size_t last)
+			{
+				for (size_t j = first; j < last; ++j)
+				{
+					const double* y = out + j * rows;
+					const double* g = dOut + j * rows;
+					double* dz = dZ + j * rows;
+					double sum = 0.0;
+
+					switch (f)
+					{
+					case activation::sigmoid:
+						for (size_t i = 0; i < rows; ++i) { dz[i] = g[i] * y[i] * (1.0 - y[i]); sum += dz[i]; }
+						break;
+					case activation::relu:
+						for (size_t i = 0; i < rows; ++i) { dz[i] = (y[i] > 0.0) ? g[i] : 0.0; sum += dz[i]; }
+						break;
+					case activation::tanh:
+						for (size_t i = 0; i < rows; ++i) { dz[i] = g[i] * (1.0 - y[i] * y[i]); sum += dz[i]; }
+						break;
+					default:
+						for (size_t i = 0; i < rows; ++i) { dz[i] = g[i]; sum += dz[i]; }
+						break;
+					}
+
+					db[j] = sum;
+				}
+			}, std::max<size_t>(1, 4096 / std::max<size_t>(rows, 1)));
+	}
+
+	/*
+	* dZ and the bias gradient of a dense layer from its activations `out` and the incoming gradient
+	* dOut, the part of the backward pass shared by all three parents; the remaining gradients are
+	* dX = dZ W' and dW = X' dZ. Reuses dZ and db when they already have the right shape.
+	*/
+	inline void dense_backward_activation(const matrix_t& out, const matrix_t& dOut, activation f, matrix_t& dZ, matrix_t& db)
+	{
+		if (!out.matrix() || out.shape() != dOut.shape()) { throw std::invalid_argument("Gradient does not match the layer output"); }
+
+		size_t rows = out.shape()[0];
+		size_t nOut = out.shape()[1];
+		if (dZ.shape() != out.shape()) { dZ = matrix_t(out.shape()); }
+		if (db.shape() != nd::shape_t{ 1, nOut }) { db = matrix_t({ 1, nOut }); }
+		activation_backward(out.data(), dOut.data(), rows, nOut, f, dZ.data(), db.data());
+	}
+}
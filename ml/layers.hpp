@@ -1,42 +1,105 @@
 #pragma once
 
 #include "math.hpp"
+#include "kernels.hpp"
+#include "autograd.hpp"
+
+namespace ml::nets
+{
+	class mlp;
+}
 
 namespace ml::layers
 {
-	typedef matrix_t(*activation_fn)(const matrix_t&);
+	using namespace ml::autograd;
+	using kernels::activation;
 
-	class dense
+	/*
+	* Fully connected layer computing f(X * W + b) for a batch X with one sample per row.
+	* W is stored as {inputs, units} and b as {1, units}, so a batch is one GEMM with the bias
+	* and activation fused into its epilogue (see kernels::dense_forward). W and b are trainable
+	* parameters and the backward pass is the fused GEMM-based kernel as well.
+	*/
+	class dense : public differentiable
 	{
 	public:
 
 		dense()
+			: _W(),
+			_b(),
+			_f(activation::identity)
 		{
 		}
 
-		dense(const nd::shape_t& shape, activation_fn activation = sigmoid)
-			: _W(nd::array<>::random(shape)),
-			_f(activation)
+		dense(size_t nInputs, size_t nUnits, activation f = activation::sigmoid)
+			: _W(xavier_uniform(nInputs, nUnits)),
+			_b(matrix_t({ 1, nUnits })),
+			_f(f)
 		{
 		}
 
-		inline size_t size() const { return _W.shape()[0]; }
+		inline size_t inputs() const { return _W.value().shape()[0]; }
+
+		inline size_t size() const { return _W.value().shape()[1]; }
+
+		inline activation activation_type() const { return _f; }
+
+		inline const matrix_t& weights() const { return _W.value(); }
+
+		inline const matrix_t& biases() const { return _b.value(); }
+
+		matrix_t operator()(const matrix_t& X) const
+		{
+			if (!X.matrix() || X.shape()[1] != inputs()) { throw std::invalid_argument("Input does not match the number of inputs of the layer"); }
+
+			size_t rows = X.shape()[0];
+			matrix_t out({ rows, size() });
+			forward(X.data(), rows, rows, out.data(), rows);
+			return out;
+		}
+
+		parameter operator()(const parameter& X) const
+		{
+			return fused_dense(X, _W, _b, _f);
+		}
 
-		inline matrix_t operator()(const matrix_t& X) const { return _f(_add_biases(_W) * X); }
+		parameter operator()(const std::vector<parameter>& params) const
+		{
+			return (*this)(params[0]);
+		}
 
-		void resize(const nd::shape_t& shape)
+		/*
+		* Writes the activations of `rows` samples into `out`. Both operands are column-major with
+		* leading dimensions `ldx` and `ldout`, so callers can pass a slice of a larger batch or a
+		* preallocated buffer without copying.
+		*/
+		void forward(const double* X, size_t rows, size_t ldx, double* out, size_t ldout) const
 		{
-			_W = nd::array<>::random(shape);
+			kernels::dense_forward(X, rows, ldx, _W.value().data(), inputs(), size(), _b.value().data(), _f, out, ldout);
 		}
 
 	private:
-		matrix_t _W;
-		activation_fn _f;
+		parameter _W;
+		parameter _b;
+		activation _f;
+
+		friend class ml::nets::mlp;
+
+		std::vector<size_t> _trainable_param_ids() const
+		{
+			return { _W.id(), _b.id() };
+		}
+
+		void _update_parameter(size_t id, const matrix_t& delta)
+		{
+			_parameter_value(id) -= delta;
+		}
 
-		matrix_t _add_biases(const matrix_t& X) const
+		matrix_t& _parameter_value(size_t id)
 		{
-			matrix_t ones({ 1, X.shape()[1] });
-			return X.concat(ones);
+			if (id == _W.id()) { return _W.value(); }
+			if (id == _b.id()) { return _b.value(); }
+			throw std::invalid_argument("Layer has no trainable parameter with this id");
 		}
 	};
-}
\ No newline at end of file
+}
@@ -1,4 +1,67 @@
+#include <iostream>
+#include <iomanip>
+
+#include "optimizers.hpp"
+#include "nets.hpp"
+
+using namespace ml;
+
+/*
+* Training throughput of nets::mlp in samples per second for a few representative layer sizes.
+* Each configuration runs a couple of mini-batch SGD epochs on random data and reports the
+* best epoch, so one-off allocation and thread pool start-up costs are excluded.
+*/
+void benchmark_mlp_training(size_t nSamples, size_t batchSize, size_t epochs)
+{
+	std::vector<std::vector<size_t>> configs = {
+		{ 32, 64, 10 },
+		{ 128, 256, 256, 10 },
+		{ 784, 512, 256, 10 },
+	};
+
+	std::cout << "mlp training, " << nSamples << " samples, batch " << batchSize << std::endl;
+	for (auto& sizes : configs)
+	{
+		matrix_t X = random({ nSamples, sizes.front() });
+		matrix_t labels({ nSamples, 1 });
+		for (size_t i = 0; i < nSamples; ++i)
+		{
+			labels({ i, 0 }) = static_cast<double>(i % sizes.back());
+		}
+		matrix_t Y = one_hot(labels, sizes.back());
+
+		nets::mlp net(sizes, layers::activation::relu, layers::activation::identity);
+		optimizers::SGD sgd(metrics::categorical_cross_entropy, 0.01, epochs, batchSize);
+		sgd.optimize(net, { autograd::parameter(X) }, Y);
+
+		double best = 0.0;
+		for (auto& epoch : sgd.history())
+		{
+			best = std::max(best, epoch.samplesPerSec);
+		}
+
+		std::cout << "  {";
+		for (size_t i = 0; i < sizes.size(); ++i)
+		{
+			std::cout << sizes[i] << (i + 1 < sizes.size() ? ", " : "}");
+		}
+		std::cout << "\t" << std::fixed << std::setprecision(0) << best << " samples/sec" << std::endl;
+	}
+}
+
 int main(int argc, char* argv[])
 {
+	try
+	{
+		size_t nSamples = (argc > 1) ? std::stoul(argv[1]) : 8192;
+		size_t batchSize = (argc > 2) ? std::stoul(argv[2]) : 128;
+		benchmark_mlp_training(nSamples, batchSize, 3);
+	}
+	catch (std::exception& e)
+	{
+		std::cerr << e.what() << std::endl;
+		return 1;
+	}
+
 	return 0;
-}
\ No newline at end of file
+}
@@ -1,148 +1,399 @@
 #pragma once
 
 #include "ndimensions/array.hpp"
+#include "ndimensions/sparse.hpp"
+#include "ndimensions/parallel.hpp"
 
 namespace ml
 {
 	using matrix_t = nd::array<double>;
+	using sparse_t = nd::sparse_array<double>;
 
 	inline matrix_t identity(size_t n) { return nd::array<double>::identity(n); }
 	inline matrix_t ones(const nd::shape_t& shape) { return nd::array<double>::ones(shape); }
 	inline matrix_t random(const nd::shape_t& shape) { return nd::array<double>::random(shape); }
+	inline matrix_t random_normal(const nd::shape_t& shape, double mean = 0.0, double stddev = 1.0) { return nd::array<double>::random_normal(shape, mean, stddev); }
+	inline matrix_t bernoulli(const nd::shape_t& shape, double p) { return nd::array<double>::bernoulli(shape, p); }
+
+	// Seeds the generator behind every random matrix, so initialization and sampling become reproducible
+	inline void seed(uint64_t seed) { nd::seed(seed); }
+
+	/*
+	* Weight initializers for a {fanIn, fanOut} matrix. Xavier (Glorot) keeps the activation variance
+	* constant for symmetric activations such as tanh and sigmoid, He scales for ReLU.
+	*/
+	inline matrix_t xavier_uniform(size_t fanIn, size_t fanOut)
+	{
+		matrix_t W({ fanIn, fanOut });
+		double limit = std::sqrt(6.0 / (fanIn + fanOut));
+		nd::default_generator().uniform(W.data(), W.N(), -limit, limit);
+		return W;
+	}
+
+	inline matrix_t xavier_normal(size_t fanIn, size_t fanOut) { return random_normal({ fanIn, fanOut }, 0.0, std::sqrt(2.0 / (fanIn + fanOut))); }
+
+	inline matrix_t he_uniform(size_t fanIn, size_t fanOut)
+	{
+		matrix_t W({ fanIn, fanOut });
+		double limit = std::sqrt(6.0 / fanIn);
+		nd::default_generator().uniform(W.data(), W.N(), -limit, limit);
+		return W;
+	}
+
+	inline matrix_t he_normal(size_t fanIn, size_t fanOut) { return random_normal({ fanIn, fanOut }, 0.0, std::sqrt(2.0 / fanIn)); }
+
+	/*
+	* Every function has an _into(out, X) form following nd::array's output convention: the buffer of
+	* `out` is reused when it has the right shape, and out may be X itself to work in place.
+	*/
+
+	inline void pow_into(matrix_t& out, const matrix_t& X, double p) { matrix_t::map_into(out, X, [p](double x) { return std::pow(x, p); }); }
 
 	inline matrix_t pow(const matrix_t& X, double p)
 	{
-		auto fn = [p](double x)
-			{
-				return std::pow(x, p);
-			};
+		matrix_t out;
+		pow_into(out, X, p);
+		return out;
+	}
 
-		return X.map(fn);
+	inline void sqrt_into(matrix_t& out, const matrix_t& X) { matrix_t::map_into(out, X, [](double x) { return std::sqrt(x); }); }
+
+	inline matrix_t sqrt(const matrix_t& X)
+	{
+		matrix_t out;
+		sqrt_into(out, X);
+		return out;
 	}
 
-	inline matrix_t sqrt(const matrix_t& X) { return X.map(matrix_t::unary_fn{ &sqrtl }); }
+	inline void d_sqrt_into(matrix_t& out, const matrix_t& X) { matrix_t::map_into(out, X, [](double x) { return 1.0 / (2 * std::sqrt(x)); }); }
 
 	inline matrix_t d_sqrt(const matrix_t& X)
 	{
-		auto dx = [](double x)
-			{
-				return 1.0 / (2 * std::sqrt(x));
-			};
+		matrix_t out;
+		d_sqrt_into(out, X);
+		return out;
+	}
+
+	inline void log_into(matrix_t& out, const matrix_t& X) { matrix_t::map_into(out, X, [](double x) { return std::log(x); }); }
 
-		return X.map(dx);
+	inline matrix_t log(const matrix_t& X)
+	{
+		matrix_t out;
+		log_into(out, X);
+		return out;
 	}
 
-	inline matrix_t log(const matrix_t& X) { return X.map(logl);}
+	inline void d_log_into(matrix_t& out, const matrix_t& X) { matrix_t::map_into(out, X, [](double x) { return 1.0 / x; }); }
 
 	inline matrix_t d_log(const matrix_t& X)
 	{
-		auto dx = [](double x)
-			{
-				return 1.0 / x;
-			};
+		matrix_t out;
+		d_log_into(out, X);
+		return out;
+	}
 
-		return X.map(dx);
+	inline void exp_into(matrix_t& out, const matrix_t& X) { matrix_t::map_into(out, X, [](double x) { return std::exp(x); }); }
+
+	inline matrix_t exp(const matrix_t& X)
+	{
+		matrix_t out;
+		exp_into(out, X);
+		return out;
 	}
 
-	inline matrix_t exp(const matrix_t& X) { return X.map(expl); }
+	inline void sigmoid_into(matrix_t& out, const matrix_t& X) { matrix_t::map_into(out, X, [](double x) { return 1.0 / (1.0 + std::exp(-x)); }); }
 
 	inline matrix_t sigmoid(const matrix_t& X)
 	{
-		auto sig = [](double x)
-			{
-				return 1.0 / (1.0 + std::exp(-x));
-			};
-
-		return X.map(sig);
+		matrix_t out;
+		sigmoid_into(out, X);
+		return out;
 	}
 
-	inline matrix_t d_sigmoid(const matrix_t& X)
+	inline void d_sigmoid_into(matrix_t& out, const matrix_t& X)
 	{
 		auto d_sig = [](double x)
 			{
-				float sx = 1.0 / (1.0 + std::exp(-x));
+				double sx = 1.0 / (1.0 + std::exp(-x));
 				return sx * (1.0 - sx);
 			};
 
-		return X.map(d_sig);
+		matrix_t::map_into(out, X, d_sig);
+	}
+
+	inline matrix_t d_sigmoid(const matrix_t& X)
+	{
+		matrix_t out;
+		d_sigmoid_into(out, X);
+		return out;
+	}
+
+	inline void softmax_into(matrix_t& out, const matrix_t& X)
+	{
+		double maxVal = X.max();
+		matrix_t::map_into(out, X, [maxVal](double x) { return std::exp(x - maxVal); });
+		out /= out.sum();
 	}
 
 	inline matrix_t softmax(const matrix_t& X)
 	{
-		matrix_t stableX = X - X.max();
-		matrix_t expVals = exp(stableX);
-		double sum = expVals.sum();
+		matrix_t out;
+		softmax_into(out, X);
+		return out;
+	}
+
+	// Jacobian diag(s) - s * s' of the softmax s of a vector, written directly instead of through matrix products
+	inline void d_softmax_into(matrix_t& J, const matrix_t& X)
+	{
+		matrix_t S = softmax(X);
+		size_t N = S.N();
+		const double* s = S.data();
 
-		return expVals / sum;
+		if (J.shape() != nd::shape_t{ N, N }) { J = matrix_t({ N, N }); }
+		double* jac = J.data();
+		nd::parallel_for(0, N, [&](size_t first, size_t last)
+			{
+				for (size_t j = first; j < last; ++j)
+				{
+					double* col = jac + j * N;
+					for (size_t i = 0; i < N; ++i) { col[i] = -s[i] * s[j]; }
+					col[j] += s[j];
+				}
+			}, 64);
 	}
 
 	inline matrix_t d_softmax(const matrix_t& X)
 	{
+		matrix_t J;
+		d_softmax_into(J, X);
+		return J;
+	}
+
+	inline void row_softmax_into(matrix_t& S, const matrix_t& X)
+	{
+		if (!X.matrix()) { throw std::invalid_argument("Row softmax requires a matrix"); }
+
 		size_t N = X.shape()[0];
-		matrix_t S = softmax(X);
-		matrix_t S_vec = S({ nd::range(N), nd::range(1) });
-		matrix_t S_mat = S_vec;
-		for (size_t i = 1; i < S.shape()[0]; ++i)
-		{
-			S_mat = S_mat.concat(S_vec, 1);
-		}
+		size_t K = X.shape()[1];
+		if (S.shape() != X.shape()) { S = X; }
+		else if (S.data() != X.data()) { std::copy(X.data(), X.data() + X.N(), S.data()); }
+		double* s = S.data();
 
-		matrix_t S_diag = matrix_t::from_diag(S_vec.squeeze());
+		nd::parallel_for(0, N, [&](size_t first, size_t last)
+			{
+				for (size_t i = first; i < last; ++i)
+				{
+					double rowMax = s[i];
+					for (size_t k = 1; k < K; ++k) { rowMax = std::max(rowMax, s[k * N + i]); }
+
+					double rowSum = 0.0;
+					for (size_t k = 0; k < K; ++k)
+					{
+						s[k * N + i] = std::exp(s[k * N + i] - rowMax);
+						rowSum += s[k * N + i];
+					}
+					for (size_t k = 0; k < K; ++k) { s[k * N + i] /= rowSum; }
+				}
+			}, 1024);
+	}
 
-		return S_diag - (S_mat * S_mat.T());
+	inline matrix_t row_softmax(const matrix_t& X)
+	{
+		matrix_t S;
+		row_softmax_into(S, X);
+		return S;
 	}
 
-	inline matrix_t relu(const matrix_t& X)
+	/*
+	* Fused log-softmax and cross-entropy over the rows of `logits` (N x K) against targets `y` (N x K,
+	* usually one-hot). Writes the per-sample loss (N x 1) and its derivative with respect to the logits,
+	* softmax * sum(y) - y, without forming probabilities separately or any Jacobian. Rows are processed
+	* in blocks so every pass over a class column is contiguous.
+	*/
+	inline void softmax_cross_entropy(const matrix_t& logits, const matrix_t& y, matrix_t& loss, matrix_t& dlogits)
 	{
-		auto fn = [](double x)
+		if (!logits.matrix() || logits.shape() != y.shape()) { throw std::invalid_argument("Logits and targets must be matrices of the same shape"); }
+
+		size_t N = logits.shape()[0];
+		size_t K = logits.shape()[1];
+		if (loss.shape() != nd::shape_t{ N, 1 }) { loss = matrix_t({ N, 1 }); }
+		if (dlogits.shape() != logits.shape()) { dlogits = matrix_t(logits.shape()); }
+
+		const double* z = logits.data();
+		const double* t = y.data();
+		double* l = loss.data();
+		double* g = dlogits.data();
+
+		nd::parallel_for(0, N, [&](size_t first, size_t last)
 			{
-				return (x > 0.0) ? x : 0.0;
-			};
+				const size_t blockRows = 256;
+				double rowMax[blockRows];
+				double rowSum[blockRows];
+				double rowMass[blockRows];
+
+				for (size_t r0 = first; r0 < last; r0 += blockRows)
+				{
+					size_t n = std::min(blockRows, last - r0);
+
+					std::copy(z + r0, z + r0 + n, rowMax);
+					for (size_t k = 1; k < K; ++k)
+					{
+						const double* zk = z + k * N + r0;
+						for (size_t i = 0; i < n; ++i) { rowMax[i] = std::max(rowMax[i], zk[i]); }
+					}
+
+					std::fill(rowSum, rowSum + n, 0.0);
+					std::fill(rowMass, rowMass + n, 0.0);
+					std::fill(l + r0, l + r0 + n, 0.0);
+					for (size_t k = 0; k < K; ++k)
+					{
+						const double* zk = z + k * N + r0;
+						const double* tk = t + k * N + r0;
+						double* gk = g + k * N + r0;
+						for (size_t i = 0; i < n; ++i)
+						{
+							double shifted = zk[i] - rowMax[i];
+							gk[i] = std::exp(shifted);
+							rowSum[i] += gk[i];
+							rowMass[i] += tk[i];
+							l[r0 + i] -= tk[i] * shifted;
+						}
+					}
+
+					for (size_t i = 0; i < n; ++i)
+					{
+						double logSum = std::log(rowSum[i]);
+						l[r0 + i] += rowMass[i] * logSum;
+						rowSum[i] = rowMass[i] / rowSum[i];
+					}
+
+					for (size_t k = 0; k < K; ++k)
+					{
+						const double* tk = t + k * N + r0;
+						double* gk = g + k * N + r0;
+						for (size_t i = 0; i < n; ++i) { gk[i] = gk[i] * rowSum[i] - tk[i]; }
+					}
+				}
+			}, 1024);
+	}
+
+	inline matrix_t one_hot(const matrix_t& labels, size_t nClasses)
+	{
+		size_t N = labels.N();
+		matrix_t Y({ N, nClasses });
+		for (size_t i = 0; i < N; ++i)
+		{
+			size_t label = static_cast<size_t>(labels.data()[i]);
+			if (label >= nClasses) { throw std::invalid_argument("Label exceeds number of classes"); }
+			Y({ i, label }) = 1.0;
+		}
+		return Y;
+	}
 
-		return X.map(fn);
+	inline void relu_into(matrix_t& out, const matrix_t& X) { matrix_t::map_into(out, X, [](double x) { return (x > 0.0) ? x : 0.0; }); }
+
+	inline matrix_t relu(const matrix_t& X)
+	{
+		matrix_t out;
+		relu_into(out, X);
+		return out;
 	}
 
+	inline void d_relu_into(matrix_t& out, const matrix_t& X) { matrix_t::map_into(out, X, [](double x) { return (x > 0.0) ? 1.0 : 0.0; }); }
+
 	inline matrix_t d_relu(const matrix_t& X)
+	{
+		matrix_t out;
+		d_relu_into(out, X);
+		return out;
+	}
+
+	inline void tanh_into(matrix_t& out, const matrix_t& X) { matrix_t::map_into(out, X, [](double x) { return std::tanh(x); }); }
+
+	inline matrix_t tanh(const matrix_t& X)
+	{
+		matrix_t out;
+		tanh_into(out, X);
+		return out;
+	}
+
+	inline void d_tanh_into(matrix_t& out, const matrix_t& X)
 	{
 		auto fn = [](double x)
 			{
-				return (x > 0.0) ? 1.0 : 0.0;
+				double t = std::tanh(x);
+				return 1.0 - t * t;
 			};
 
-		return X.map(fn);
+		matrix_t::map_into(out, X, fn);
 	}
 
-	inline matrix_t sin(const matrix_t& X) { return X.map(sinl); }
+	inline matrix_t d_tanh(const matrix_t& X)
+	{
+		matrix_t out;
+		d_tanh_into(out, X);
+		return out;
+	}
 
-	inline matrix_t cos(const matrix_t& X) { return X.map(cosl); }
+	inline void sin_into(matrix_t& out, const matrix_t& X) { matrix_t::map_into(out, X, [](double x) { return std::sin(x); }); }
 
-	inline matrix_t tan(const matrix_t& X) { return X.map(tanl); }
+	inline matrix_t sin(const matrix_t& X)
+	{
+		matrix_t out;
+		sin_into(out, X);
+		return out;
+	}
 
-	inline matrix_t sec(const matrix_t& X)
+	inline void cos_into(matrix_t& out, const matrix_t& X) { matrix_t::map_into(out, X, [](double x) { return std::cos(x); }); }
+
+	inline matrix_t cos(const matrix_t& X)
 	{
-		auto fn = [](double x)
-			{
-				return 1.0 / std::cos(x);
-			};
+		matrix_t out;
+		cos_into(out, X);
+		return out;
+	}
+
+	inline void tan_into(matrix_t& out, const matrix_t& X) { matrix_t::map_into(out, X, [](double x) { return std::tan(x); }); }
 
-		return X.map(fn);
+	inline matrix_t tan(const matrix_t& X)
+	{
+		matrix_t out;
+		tan_into(out, X);
+		return out;
 	}
 
-	inline matrix_t csc(const matrix_t& X)
+	inline void sec_into(matrix_t& out, const matrix_t& X) { matrix_t::map_into(out, X, [](double x) { return 1.0 / std::cos(x); }); }
+
+	inline matrix_t sec(const matrix_t& X)
 	{
-		auto fn = [](double x)
-			{
-				return 1.0 / std::sin(x);
-			};
+		matrix_t out;
+		sec_into(out, X);
+		return out;
+	}
+
+	inline void csc_into(matrix_t& out, const matrix_t& X) { matrix_t::map_into(out, X, [](double x) { return 1.0 / std::sin(x); }); }
 
-		return X.map(fn);
+	inline matrix_t csc(const matrix_t& X)
+	{
+		matrix_t out;
+		csc_into(out, X);
+		return out;
 	}
 
+	inline void d_sin_into(matrix_t& out, const matrix_t& X) { cos_into(out, X); }
+
 	inline matrix_t d_sin(const matrix_t& X) { return cos(X); }
 
-	inline matrix_t d_cos(const matrix_t& X) { return -1 * sin(X); }
+	inline void d_cos_into(matrix_t& out, const matrix_t& X) { matrix_t::map_into(out, X, [](double x) { return -std::sin(x); }); }
 
-	inline matrix_t d_tan(const matrix_t& X)
+	inline matrix_t d_cos(const matrix_t& X)
+	{
+		matrix_t out;
+		d_cos_into(out, X);
+		return out;
+	}
+
+	inline void d_tan_into(matrix_t& out, const matrix_t& X)
 	{
 		auto fn = [](double x)
 			{
@@ -150,6 +401,13 @@ namespace ml
 				return 1.0 / (c * c);
 			};
 
-		return X.map(fn);
+		matrix_t::map_into(out, X, fn);
+	}
+
+	inline matrix_t d_tan(const matrix_t& X)
+	{
+		matrix_t out;
+		d_tan_into(out, X);
+		return out;
 	}
 }
\ No newline at end of file
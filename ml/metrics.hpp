@@ -13,6 +13,12 @@ namespace ml::metrics
 		return -1.0 * (y.hadamard(log(yhat)) + (1.0 - y).hadamard(log(1.0 - yhat)));
 	}
 
+	// Multi-class cross-entropy taking raw logits, with the softmax fused in for numerical stability
+	inline parameter categorical_cross_entropy(const parameter& y, const parameter& logits)
+	{
+		return softmax_cross_entropy(logits, y);
+	}
+
 	class metrics
 	{
 	};
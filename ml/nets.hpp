@@ -4,36 +4,118 @@
 
 namespace ml::nets
 {
-	class mlp
+	using namespace ml::autograd;
+
+	/*
+	* Multi-layer perceptron described by its layer widths {inputs, hidden..., outputs}. Inference
+	* runs in chunks of up to `maxBatch` samples through two activation buffers that are allocated
+	* once, so a forward pass only allocates its result. As a differentiable model the weights and
+	* biases of every layer are trainable by any optimizer.
+	*/
+	class mlp : public differentiable
 	{
 	public:
 
-		mlp(const std::vector<size_t>& layerSizes, layers::activation_fn activation = sigmoid)
-			: _layers(layerSizes.size())
+		mlp(const std::vector<size_t>& layerSizes, layers::activation hidden = layers::activation::sigmoid,
+			layers::activation output = layers::activation::sigmoid, size_t maxBatch = 256)
+			: _layers(),
+			_maxBatch(std::max<size_t>(maxBatch, 1)),
+			_buffers()
 		{
-			_layers[0] = layers::dense({ 1, layerSizes[0] });
-			for (size_t i = 1; i < _layers.size(); ++i)
+			if (layerSizes.size() < 2) { throw std::invalid_argument("An MLP needs at least an input and an output size"); }
+
+			size_t widest = 0;
+			_layers.reserve(layerSizes.size() - 1);
+			for (size_t i = 1; i < layerSizes.size(); ++i)
+			{
+				bool last = i + 1 == layerSizes.size();
+				_layers.emplace_back(layerSizes[i - 1], layerSizes[i], last ? output : hidden);
+				if (!last) { widest = std::max(widest, layerSizes[i]); }
+			}
+
+			// Hidden activations alternate between the two buffers, the output layer writes straight into the result
+			for (auto& buffer : _buffers)
 			{
-				size_t nInputs = _layers[i - 1].size();
-				_layers[i] = layers::dense({ layerSizes[i], nInputs }, activation);
+				buffer = matrix_t({ _maxBatch, std::max<size_t>(widest, 1) });
 			}
 		}
 
-	private:
-		matrix_t _X;
-		std::vector<ml::layers::dense> _layers;
+		inline size_t inputs() const { return _layers.front().inputs(); }
+
+		inline size_t outputs() const { return _layers.back().size(); }
+
+		inline const std::vector<layers::dense>& layers() const { return _layers; }
+
+		matrix_t predict(const matrix_t& X)
+		{
+			if (!X.matrix() || X.shape()[1] != inputs()) { throw std::invalid_argument("Input does not match the number of inputs of the network"); }
+
+			size_t N = X.shape()[0];
+			matrix_t result({ N, outputs() });
+
+			for (size_t first = 0; first < N; first += _maxBatch)
+			{
+				size_t rows = std::min(_maxBatch, N - first);
+				const double* in = X.data() + first;
+				size_t ldIn = N;
+
+				for (size_t l = 0; l < _layers.size(); ++l)
+				{
+					bool last = l + 1 == _layers.size();
+					double* out = last ? result.data() + first : _buffers[l % 2].data();
+					size_t ldOut = last ? N : _maxBatch;
+
+					_layers[l].forward(in, rows, ldIn, out, ldOut);
+					in = out;
+					ldIn = ldOut;
+				}
+			}
+
+			return result;
+		}
+
+		inline matrix_t operator()(const matrix_t& X) { return predict(X); }
 
-		matrix_t _feed_forward(const matrix_t& X)
+		parameter operator()(const std::vector<parameter>& params) const
 		{
-			_layers[0].resize({ _layers[0].size(), X.shape()[0] });
+			parameter h = params[0];
+			for (auto& layer : _layers)
+			{
+				h = layer(h);
+			}
+			return h;
+		}
+
+	private:
+		std::vector<layers::dense> _layers;
+		size_t _maxBatch;
+		matrix_t _buffers[2];
 
-			matrix_t prevLayer = X;
+		std::vector<size_t> _trainable_param_ids() const
+		{
+			std::vector<size_t> ids;
+			ids.reserve(2 * _layers.size());
 			for (auto& layer : _layers)
 			{
-				prevLayer = layer(prevLayer);
+				ids.push_back(layer._W.id());
+				ids.push_back(layer._b.id());
 			}
+			return ids;
+		}
+
+		void _update_parameter(size_t id, const matrix_t& delta)
+		{
+			_parameter_value(id) -= delta;
+		}
 
-			return prevLayer;
+		matrix_t& _parameter_value(size_t id)
+		{
+			for (auto& layer : _layers)
+			{
+				if (id == layer._W.id()) { return layer._W.value(); }
+				if (id == layer._b.id()) { return layer._b.value(); }
+			}
+			throw std::invalid_argument("Model has no trainable parameter with this id");
 		}
 	};
-}
\ No newline at end of file
+}
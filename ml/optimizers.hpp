@@ -1,45 +1,886 @@
 #pragma once
 
 #include "metrics.hpp"
+#include "regression.hpp"
+#include "ndimensions/parallel.hpp"
+
+#include <chrono>
+#include <random>
+#include <numeric>
+#include <algorithm>
+#include <unordered_map>
+#include <memory>
+#include <atomic>
+#include <deque>
+#include <map>
+#include <string>
+#include <functional>
 
 namespace ml::optimizers
 {
 	using namespace ml::autograd;
 	using namespace ml::metrics;
 
-	
+	struct epoch_stats
+	{
+		size_t epoch;
+		size_t samples;
+		double seconds;
+		double samplesPerSec;
+		double cost;
+	};
 
-	class SGD
+	class optimizer
 	{
 	public:
 
-		SGD(cost_function costFn, double learningRate = 0.05, size_t maxIterations = 100)
+		typedef std::map<std::string, matrix_t> state_map;
+
+		optimizer(cost_function costFn, double learningRate, size_t maxIterations, size_t batchSize, bool shuffle)
 			: _lr(learningRate),
 			_maxIter(maxIterations),
-			_costFn(costFn)
+			_batchSize(batchSize),
+			_shuffle(shuffle),
+			_costFn(costFn),
+			_rng(std::random_device{}()),
+			_history(),
+			_nWorkers(1),
+			_pool(),
+			_onEpoch()
+		{
+		}
+
+		virtual ~optimizer() = default;
+
+		void seed(uint64_t value) { _rng.seed(value); }
+
+		void set_shuffle(bool shuffle) { _shuffle = shuffle; }
+
+		/*
+		* Shards every batch across `nWorkers` threads. Each worker runs the forward and backward
+		* pass on its rows, the per-worker gradients are summed with a tree reduction and a single
+		* update is applied, so results match a single-threaded run up to rounding.
+		*/
+		void set_workers(size_t nWorkers)
+		{
+			_nWorkers = std::max<size_t>(nWorkers, 1);
+			_pool = (_nWorkers > 1) ? std::make_shared<nd::thread_pool>(_nWorkers) : nullptr;
+		}
+
+		const std::vector<epoch_stats>& history() const { return _history; }
+
+		// Called after every epoch with its statistics, e.g. to hand a snapshot to a background checkpointer
+		void on_epoch(std::function<void(const epoch_stats&)> callback) { _onEpoch = callback; }
+
+		/*
+		* Per-parameter state such as velocities or moments, keyed by the position of each parameter
+		* among the model's trainable parameters so it can be restored into a reloaded model whose
+		* parameter ids differ.
+		*/
+		virtual state_map export_state(const differentiable& model) const { return {}; }
+
+		virtual void import_state(const differentiable& model, const state_map& state) {}
+
+		virtual void optimize(differentiable& model, const std::vector<parameter>& inputs, const matrix_t& y)
+		{
+			_optimize(model, inputs, y);
+		}
+
+		// Trains on a sparse design matrix with one sample per row, batches are gathered from its CSR rows
+		virtual void optimize(differentiable& model, const sparse_t& X, const matrix_t& y)
+		{
+			_optimize(model, X.to_format(nd::sparse_format::csr), y);
+		}
+
+	protected:
+		double _lr;
+		size_t _maxIter;
+		size_t _batchSize;
+		bool _shuffle;
+		cost_function _costFn;
+		std::mt19937_64 _rng;
+		std::vector<epoch_stats> _history;
+		size_t _nWorkers;
+		std::shared_ptr<nd::thread_pool> _pool;
+		std::function<void(const epoch_stats&)> _onEpoch;
+
+		/*
+		* Applies one update to the weights of parameter `id` in place. Implementations
+		* touch each element once and keep any state they need between calls.
+		*/
+		virtual void _update(size_t id, matrix_t& w, const matrix_t& grad) = 0;
+
+		template <class Inputs>
+		void _optimize(differentiable& model, const Inputs& inputs, const matrix_t& y)
+		{
+			size_t nSamples = y.shape()[0];
+			size_t batchSize = (_batchSize == 0 || _batchSize > nSamples) ? nSamples : _batchSize;
+
+			std::vector<size_t> order(nSamples);
+			std::iota(order.begin(), order.end(), (size_t)0);
+
+			_history.clear();
+			for (size_t epoch = 0; epoch < _maxIter; ++epoch)
+			{
+				auto start = std::chrono::steady_clock::now();
+				double cost = 0.0;
+
+				if (batchSize == nSamples)
+				{
+					cost += _step(model, inputs, y, order);
+				}
+				else
+				{
+					if (_shuffle) { std::shuffle(order.begin(), order.end(), _rng); }
+
+					for (size_t first = 0; first < nSamples; first += batchSize)
+					{
+						cost += _step(model, inputs, y, std::span<const size_t>(order.data() + first, std::min(batchSize, nSamples - first)));
+					}
+				}
+
+				std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+				_history.push_back({ epoch, nSamples, elapsed.count(), nSamples / elapsed.count(), cost });
+				if (_onEpoch) { _onEpoch(_history.back()); }
+			}
+		}
+
+		template <class Inputs>
+		double _step(differentiable& model, const Inputs& inputs, const matrix_t& y, std::span<const size_t> rows)
+		{
+			std::vector<size_t> ids = model._trainable_param_ids();
+
+			double cost = 0.0;
+			auto grads = _batch_gradients(model, ids, inputs, y, rows, cost);
+			for (size_t k = 0; k < ids.size(); ++k)
+			{
+				_update(ids[k], model._parameter_value(ids[k]), grads[k]);
+			}
+			return cost;
+		}
+
+		template <class Inputs>
+		std::vector<matrix_t> _batch_gradients(const differentiable& model, const std::vector<size_t>& ids, const Inputs& inputs, const matrix_t& y, std::span<const size_t> rows, double& totalCost)
+		{
+			size_t nShards = std::min(_nWorkers, rows.size());
+			if (nShards <= 1)
+			{
+				return (rows.size() == y.shape()[0]) ? _gradients(model, ids, inputs, y, totalCost) : _gradients(model, ids, inputs, y, rows, totalCost);
+			}
+
+			std::vector<std::vector<matrix_t>> shardGrads(nShards);
+			std::vector<double> shardCosts(nShards);
+			_pool->run(nShards, [&](size_t s)
+				{
+					size_t first = s * rows.size() / nShards;
+					size_t last = (s + 1) * rows.size() / nShards;
+					shardGrads[s] = _gradients(model, ids, inputs, y, rows.subspan(first, last - first), shardCosts[s]);
+				});
+
+			_tree_reduce(shardGrads);
+			totalCost = std::accumulate(shardCosts.begin(), shardCosts.end(), 0.0);
+			return std::move(shardGrads[0]);
+		}
+
+		template <class Inputs>
+		std::vector<matrix_t> _gradients(const differentiable& model, const std::vector<size_t>& ids, const Inputs& inputs, const matrix_t& y, double& totalCost) const
+		{
+			parameter yhat = model(inputs);
+			parameter cost = _costFn(y, yhat);
+			totalCost = cost.value().sum();
+
+			return cost.gradients(ids);
+		}
+
+		template <class Inputs>
+		std::vector<matrix_t> _gradients(const differentiable& model, const std::vector<size_t>& ids, const Inputs& inputs, const matrix_t& y, std::span<const size_t> rows, double& totalCost) const
+		{
+			return _gradients(model, ids, _take(inputs, rows), y.take(rows), totalCost);
+		}
+
+		static std::vector<parameter> _take(const std::vector<parameter>& inputs, std::span<const size_t> rows)
+		{
+			std::vector<parameter> batchInputs;
+			batchInputs.reserve(inputs.size());
+			for (auto& input : inputs)
+			{
+				batchInputs.emplace_back(input.value().take(rows));
+			}
+			return batchInputs;
+		}
+
+		static sparse_t _take(const sparse_t& X, std::span<const size_t> rows) { return X.take(rows); }
+
+		void _tree_reduce(std::vector<std::vector<matrix_t>>& shardGrads)
+		{
+			for (size_t stride = 1; stride < shardGrads.size(); stride *= 2)
+			{
+				size_t nPairs = (shardGrads.size() + 2 * stride - 1) / (2 * stride);
+				_pool->run(nPairs, [&](size_t p)
+					{
+						size_t dest = p * 2 * stride;
+						size_t src = dest + stride;
+						if (src >= shardGrads.size()) { return; }
+
+						for (size_t k = 0; k < shardGrads[dest].size(); ++k)
+						{
+							shardGrads[dest][k] += shardGrads[src][k];
+						}
+					});
+			}
+		}
+
+		static std::vector<size_t> _trainable_param_ids(const differentiable& model) { return model._trainable_param_ids(); }
+
+		static matrix_t& _parameter_value(differentiable& model, size_t id) { return model._parameter_value(id); }
+
+		static matrix_t& _state_for(std::unordered_map<size_t, matrix_t>& states, size_t id, const matrix_t& w)
+		{
+			auto it = states.find(id);
+			if (it == states.end())
+			{
+				it = states.emplace(id, matrix_t(w.shape())).first;
+			}
+
+			return it->second;
+		}
+
+		static void _export_states(const std::unordered_map<size_t, matrix_t>& states, const std::vector<size_t>& ids, const std::string& prefix, state_map& state)
+		{
+			for (size_t k = 0; k < ids.size(); ++k)
+			{
+				auto it = states.find(ids[k]);
+				if (it != states.end()) { state[prefix + "." + std::to_string(k)] = it->second; }
+			}
+		}
+
+		static void _import_states(std::unordered_map<size_t, matrix_t>& states, const std::vector<size_t>& ids, const std::string& prefix, const state_map& state)
+		{
+			states.clear();
+			for (size_t k = 0; k < ids.size(); ++k)
+			{
+				auto it = state.find(prefix + "." + std::to_string(k));
+				if (it != state.end()) { states[ids[k]] = it->second; }
+			}
+		}
+	};
+
+
+
+	class SGD : public optimizer
+	{
+	public:
+
+		SGD(cost_function costFn, double learningRate = 0.05, size_t maxIterations = 100, size_t batchSize = 0, bool shuffle = true)
+			: optimizer(costFn, learningRate, maxIterations, batchSize, shuffle)
+		{
+		}
+
+	protected:
+
+		void _update(size_t id, matrix_t& w, const matrix_t& grad)
+		{
+			double* pw = w.data();
+			const double* pg = grad.data();
+			for (size_t i = 0; i < w.N(); ++i)
+			{
+				pw[i] -= _lr * pg[i];
+			}
+		}
+	};
+
+
+
+	class Momentum : public optimizer
+	{
+	public:
+
+		Momentum(cost_function costFn, double learningRate = 0.01, size_t maxIterations = 100, size_t batchSize = 0, double momentum = 0.9, bool nesterov = true)
+			: optimizer(costFn, learningRate, maxIterations, batchSize, true),
+			_mu(momentum),
+			_nesterov(nesterov),
+			_velocity()
+		{
+		}
+
+		void reset() { _velocity.clear(); }
+
+		state_map export_state(const differentiable& model) const
+		{
+			state_map state;
+			_export_states(_velocity, _trainable_param_ids(model), "momentum.velocity", state);
+			return state;
+		}
+
+		void import_state(const differentiable& model, const state_map& state)
+		{
+			_import_states(_velocity, _trainable_param_ids(model), "momentum.velocity", state);
+		}
+
+	protected:
+		double _mu;
+		bool _nesterov;
+		std::unordered_map<size_t, matrix_t> _velocity;
+
+		void _update(size_t id, matrix_t& w, const matrix_t& grad)
+		{
+			double* pw = w.data();
+			double* pv = _state_for(_velocity, id, w).data();
+			const double* pg = grad.data();
+
+			for (size_t i = 0; i < w.N(); ++i)
+			{
+				double v = _mu * pv[i] + pg[i];
+				pv[i] = v;
+				pw[i] -= _lr * (_nesterov ? pg[i] + _mu * v : v);
+			}
+		}
+	};
+
+
+
+	class RMSProp : public optimizer
+	{
+	public:
+
+		RMSProp(cost_function costFn, double learningRate = 0.001, size_t maxIterations = 100, size_t batchSize = 0, double rho = 0.9, double epsilon = 1e-8)
+			: optimizer(costFn, learningRate, maxIterations, batchSize, true),
+			_rho(rho),
+			_eps(epsilon),
+			_meanSquare()
+		{
+		}
+
+		void reset() { _meanSquare.clear(); }
+
+		state_map export_state(const differentiable& model) const
+		{
+			state_map state;
+			_export_states(_meanSquare, _trainable_param_ids(model), "rmsprop.mean_square", state);
+			return state;
+		}
+
+		void import_state(const differentiable& model, const state_map& state)
+		{
+			_import_states(_meanSquare, _trainable_param_ids(model), "rmsprop.mean_square", state);
+		}
+
+	protected:
+		double _rho;
+		double _eps;
+		std::unordered_map<size_t, matrix_t> _meanSquare;
+
+		void _update(size_t id, matrix_t& w, const matrix_t& grad)
+		{
+			double* pw = w.data();
+			double* ps = _state_for(_meanSquare, id, w).data();
+			const double* pg = grad.data();
+
+			for (size_t i = 0; i < w.N(); ++i)
+			{
+				double s = _rho * ps[i] + (1.0 - _rho) * pg[i] * pg[i];
+				ps[i] = s;
+				pw[i] -= _lr * pg[i] / (std::sqrt(s) + _eps);
+			}
+		}
+	};
+
+
+
+	class Adam : public optimizer
+	{
+	public:
+
+		Adam(cost_function costFn, double learningRate = 0.001, size_t maxIterations = 100, size_t batchSize = 0, double beta1 = 0.9, double beta2 = 0.999, double epsilon = 1e-8)
+			: optimizer(costFn, learningRate, maxIterations, batchSize, true),
+			_beta1(beta1),
+			_beta2(beta2),
+			_eps(epsilon),
+			_weightDecay(0.0),
+			_moments()
 		{
 		}
 
+		void reset() { _moments.clear(); }
+
+		state_map export_state(const differentiable& model) const
+		{
+			state_map state;
+			std::vector<size_t> ids = _trainable_param_ids(model);
+			for (size_t k = 0; k < ids.size(); ++k)
+			{
+				auto it = _moments.find(ids[k]);
+				if (it == _moments.end()) { continue; }
+
+				std::string suffix = "." + std::to_string(k);
+				state["adam.m" + suffix] = it->second.m;
+				state["adam.v" + suffix] = it->second.v;
+				state["adam.t" + suffix] = matrix_t(static_cast<double>(it->second.t));
+			}
+			return state;
+		}
+
+		void import_state(const differentiable& model, const state_map& state)
+		{
+			_moments.clear();
+			std::vector<size_t> ids = _trainable_param_ids(model);
+			for (size_t k = 0; k < ids.size(); ++k)
+			{
+				std::string suffix = "." + std::to_string(k);
+				auto m = state.find("adam.m" + suffix);
+				auto v = state.find("adam.v" + suffix);
+				auto t = state.find("adam.t" + suffix);
+				if (m == state.end() || v == state.end() || t == state.end()) { continue; }
+
+				_moments[ids[k]] = moments{ m->second, v->second, static_cast<size_t>(t->second.data()[0]) };
+			}
+		}
+
+	protected:
+
+		struct moments
+		{
+			matrix_t m;
+			matrix_t v;
+			size_t t;
+		};
+
+		double _beta1;
+		double _beta2;
+		double _eps;
+		double _weightDecay;
+		std::unordered_map<size_t, moments> _moments;
+
+		void _update(size_t id, matrix_t& w, const matrix_t& grad)
+		{
+			auto it = _moments.find(id);
+			if (it == _moments.end())
+			{
+				it = _moments.emplace(id, moments{ matrix_t(w.shape()), matrix_t(w.shape()), 0 }).first;
+			}
+
+			auto& state = it->second;
+			state.t++;
+
+			// Bias corrections are folded into the step size and epsilon so the loop needs no extra divides
+			double c1 = 1.0 - std::pow(_beta1, static_cast<double>(state.t));
+			double c2 = std::sqrt(1.0 - std::pow(_beta2, static_cast<double>(state.t)));
+			double stepSize = _lr * c2 / c1;
+			double eps = _eps * c2;
+			double decay = 1.0 - _lr * _weightDecay;
+
+			double* pw = w.data();
+			double* pm = state.m.data();
+			double* pv = state.v.data();
+			const double* pg = grad.data();
+
+			for (size_t i = 0; i < w.N(); ++i)
+			{
+				double g = pg[i];
+				double m = _beta1 * pm[i] + (1.0 - _beta1) * g;
+				double v = _beta2 * pv[i] + (1.0 - _beta2) * g * g;
+				pm[i] = m;
+				pv[i] = v;
+				pw[i] = decay * pw[i] - stepSize * m / (std::sqrt(v) + eps);
+			}
+		}
+	};
+
+
+
+	class AdamW : public Adam
+	{
+	public:
+
+		AdamW(cost_function costFn, double learningRate = 0.001, size_t maxIterations = 100, size_t batchSize = 0, double weightDecay = 0.01, double beta1 = 0.9, double beta2 = 0.999, double epsilon = 1e-8)
+			: Adam(costFn, learningRate, maxIterations, batchSize, beta1, beta2, epsilon)
+		{
+			_weightDecay = weightDecay;
+		}
+	};
+
+
+
+	/*
+	* Limited-memory BFGS for smooth full-batch problems. Each iteration builds a search direction
+	* from the last `historySize` curvature pairs and picks a step satisfying the strong Wolfe
+	* conditions. Optimization stops early once the gradient or the change in cost is below tolerance.
+	*/
+	class LBFGS : public optimizer
+	{
+	public:
+
+		LBFGS(cost_function costFn, size_t maxIterations = 100, size_t historySize = 10, double gradTolerance = 1e-6, double costTolerance = 1e-10, size_t maxLineSearch = 20)
+			: optimizer(costFn, 1.0, maxIterations, 0, false),
+			_historySize(historySize),
+			_gradTol(gradTolerance),
+			_costTol(costTolerance),
+			_maxLineSearch(maxLineSearch),
+			_converged(false)
+		{
+		}
+
+		inline bool converged() const { return _converged; }
+
 		void optimize(differentiable& model, const std::vector<parameter>& inputs, const matrix_t& y)
 		{
-			for (size_t i = 0; i < _maxIter; ++i)
+			_minimize(model, inputs, y);
+		}
+
+		void optimize(differentiable& model, const sparse_t& X, const matrix_t& y)
+		{
+			_minimize(model, X.to_format(nd::sparse_format::csr), y);
+		}
+
+	protected:
+		size_t _historySize;
+		double _gradTol;
+		double _costTol;
+		size_t _maxLineSearch;
+		bool _converged;
+
+		// Steps are taken by the line search in _minimize()
+		void _update(size_t id, matrix_t& w, const matrix_t& grad) {}
+
+		template <class Inputs>
+		void _minimize(differentiable& model, const Inputs& inputs, const matrix_t& y)
+		{
+			std::vector<size_t> ids = _trainable_param_ids(model);
+			std::vector<size_t> rows(y.shape()[0]);
+			std::iota(rows.begin(), rows.end(), (size_t)0);
+
+			std::vector<double> x = _gather(model, ids);
+			size_t n = x.size();
+
+			auto evaluate = [&](const std::vector<double>& point, std::vector<double>& grad)
+				{
+					_scatter(model, ids, point);
+					double cost = 0.0;
+					auto grads = _batch_gradients(model, ids, inputs, y, rows, cost);
+
+					size_t offset = 0;
+					for (auto& g : grads)
+					{
+						std::copy(g.data(), g.data() + g.N(), grad.begin() + offset);
+						offset += g.N();
+					}
+					return cost;
+				};
+
+			std::vector<double> g(n), d(n), xNext(n), gNext(n);
+			std::deque<std::vector<double>> sHist, yHist;
+			std::deque<double> rhoHist;
+
+			double f = evaluate(x, g);
+			_converged = _norm_inf(g) <= _gradTol;
+			_history.clear();
+
+			for (size_t iter = 0; iter < _maxIter && !_converged; ++iter)
 			{
-				parameter yhat = model(inputs);
-				parameter cost = _costFn(y, yhat);
+				auto start = std::chrono::steady_clock::now();
+
+				_direction(g, sHist, yHist, rhoHist, d);
+				double dg = _dot(d, g);
+				if (dg >= 0.0)
+				{
+					// Curvature information went stale, fall back to steepest descent
+					sHist.clear();
+					yHist.clear();
+					rhoHist.clear();
+					for (size_t i = 0; i < n; ++i) { d[i] = -g[i]; }
+					dg = _dot(d, g);
+				}
+
+				double initialStep = (sHist.empty()) ? std::min(1.0, 1.0 / _norm_inf(g)) : 1.0;
+				double fNext = f;
+				if (!_line_search(evaluate, x, f, dg, d, initialStep, xNext, fNext, gNext))
+				{
+					_scatter(model, ids, x);
+					break;
+				}
+
+				std::vector<double> s(n), yk(n);
+				for (size_t i = 0; i < n; ++i)
+				{
+					s[i] = xNext[i] - x[i];
+					yk[i] = gNext[i] - g[i];
+				}
 
-				for (auto& id : model._trainable_param_ids())
+				double sy = _dot(s, yk);
+				if (sy > 1e-12 * _dot(yk, yk))
 				{
-					matrix_t grad = cost.partial_wrt(id);
-					model._update_parameter(id, grad * _lr);
+					sHist.push_back(std::move(s));
+					yHist.push_back(std::move(yk));
+					rhoHist.push_back(1.0 / sy);
+					if (sHist.size() > _historySize)
+					{
+						sHist.pop_front();
+						yHist.pop_front();
+						rhoHist.pop_front();
+					}
 				}
+
+				double fPrev = f;
+				std::swap(x, xNext);
+				std::swap(g, gNext);
+				f = fNext;
+
+				std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+				_history.push_back({ iter, rows.size(), elapsed.count(), rows.size() / elapsed.count(), f });
+				if (_onEpoch) { _onEpoch(_history.back()); }
+
+				_converged = _norm_inf(g) <= _gradTol || std::abs(fPrev - f) <= _costTol * std::max(1.0, std::abs(f));
+			}
+
+			_scatter(model, ids, x);
+		}
+
+		static double _dot(const std::vector<double>& a, const std::vector<double>& b)
+		{
+			return std::inner_product(a.begin(), a.end(), b.begin(), 0.0);
+		}
+
+		static double _norm_inf(const std::vector<double>& a)
+		{
+			double result = 0.0;
+			for (auto v : a)
+			{
+				result = std::max(result, std::abs(v));
+			}
+			return result;
+		}
+
+		static std::vector<double> _gather(differentiable& model, const std::vector<size_t>& ids)
+		{
+			std::vector<double> x;
+			for (auto id : ids)
+			{
+				auto& w = _parameter_value(model, id);
+				x.insert(x.end(), w.data(), w.data() + w.N());
+			}
+			return x;
+		}
+
+		static void _scatter(differentiable& model, const std::vector<size_t>& ids, const std::vector<double>& x)
+		{
+			size_t offset = 0;
+			for (auto id : ids)
+			{
+				auto& w = _parameter_value(model, id);
+				std::copy(x.begin() + offset, x.begin() + offset + w.N(), w.data());
+				offset += w.N();
+			}
+		}
+
+		static void _direction(const std::vector<double>& g, const std::deque<std::vector<double>>& sHist, const std::deque<std::vector<double>>& yHist, const std::deque<double>& rhoHist, std::vector<double>& d)
+		{
+			size_t m = sHist.size();
+			std::vector<double> alpha(m);
+			for (size_t i = 0; i < g.size(); ++i) { d[i] = -g[i]; }
+
+			for (size_t k = m; k-- > 0;)
+			{
+				alpha[k] = rhoHist[k] * _dot(sHist[k], d);
+				for (size_t i = 0; i < d.size(); ++i) { d[i] -= alpha[k] * yHist[k][i]; }
+			}
+
+			if (m > 0)
+			{
+				double gamma = _dot(sHist.back(), yHist.back()) / _dot(yHist.back(), yHist.back());
+				for (auto& v : d) { v *= gamma; }
+			}
+
+			for (size_t k = 0; k < m; ++k)
+			{
+				double beta = rhoHist[k] * _dot(yHist[k], d);
+				for (size_t i = 0; i < d.size(); ++i) { d[i] += (alpha[k] - beta) * sHist[k][i]; }
+			}
+		}
+
+		/*
+		* Strong Wolfe line search with bracketing and zoom (Nocedal & Wright, algorithms 3.5 and 3.6).
+		* On success xOut, fOut and gOut hold the accepted point.
+		*/
+		template <class Eval>
+		bool _line_search(Eval& evaluate, const std::vector<double>& x, double f0, double dg0, const std::vector<double>& d, double step,
+			std::vector<double>& xOut, double& fOut, std::vector<double>& gOut) const
+		{
+			const double c1 = 1e-4;
+			const double c2 = 0.9;
+
+			auto phi = [&](double a, double& dphi)
+				{
+					for (size_t i = 0; i < x.size(); ++i) { xOut[i] = x[i] + a * d[i]; }
+					fOut = evaluate(xOut, gOut);
+					dphi = _dot(gOut, d);
+					return fOut;
+				};
+
+			auto zoom = [&](double lo, double fLo, double dLo, double hi, double fHi)
+				{
+					for (size_t k = 0; k < _maxLineSearch; ++k)
+					{
+						// Quadratic interpolation, kept away from the ends of the bracket
+						double width = hi - lo;
+						double a = lo - dLo * width * width / (2.0 * (fHi - fLo - dLo * width));
+						double lower = std::min(lo, hi) + 0.1 * std::abs(width);
+						double upper = std::max(lo, hi) - 0.1 * std::abs(width);
+						if (!std::isfinite(a) || a < lower || a > upper) { a = lo + 0.5 * width; }
+
+						double dA;
+						double fA = phi(a, dA);
+						if (fA > f0 + c1 * a * dg0 || fA >= fLo)
+						{
+							hi = a;
+							fHi = fA;
+						}
+						else
+						{
+							if (std::abs(dA) <= -c2 * dg0) { return true; }
+							if (dA * (hi - lo) >= 0.0)
+							{
+								hi = lo;
+								fHi = fLo;
+							}
+							lo = a;
+							fLo = fA;
+							dLo = dA;
+						}
+					}
+					return false;
+				};
+
+			double prevStep = 0.0;
+			double fPrev = f0;
+			double dPrev = dg0;
+			for (size_t k = 0; k < _maxLineSearch; ++k)
+			{
+				double dA;
+				double fA = phi(step, dA);
+
+				if (fA > f0 + c1 * step * dg0 || (k > 0 && fA >= fPrev)) { return zoom(prevStep, fPrev, dPrev, step, fA); }
+				if (std::abs(dA) <= -c2 * dg0) { return true; }
+				if (dA >= 0.0) { return zoom(step, fA, dA, prevStep, fPrev); }
+
+				prevStep = step;
+				fPrev = fA;
+				dPrev = dA;
+				step *= 2.0;
+			}
+
+			return false;
+		}
+	};
+
+
+
+	/*
+	* Lock-free asynchronous SGD (Niu et al., 2011) for logistic regression on sparse inputs.
+	* Threads update the shared weights without synchronization and each step only reads and
+	* writes the coordinates where the sample is non-zero.
+	*/
+	class Hogwild
+	{
+	public:
+
+		Hogwild(double learningRate = 0.01, size_t maxIterations = 10, size_t nThreads = std::thread::hardware_concurrency())
+			: _lr(learningRate),
+			_maxIter(maxIterations),
+			_nThreads(std::max<size_t>(nThreads, 1)),
+			_rng(std::random_device{}()),
+			_history()
+		{
+		}
+
+		void seed(uint64_t value) { _rng.seed(value); }
+
+		const std::vector<epoch_stats>& history() const { return _history; }
+
+		void optimize(ml::regression::logistic& model, const matrix_t& X, const matrix_t& y)
+		{
+			optimize(model, sparse_t::from_dense(X), y);
+		}
+
+		void optimize(ml::regression::logistic& model, const sparse_t& X, const matrix_t& y)
+		{
+			differentiable& base = model;
+			matrix_t& w = base._parameter_value(base._trainable_param_ids().front());
+			if (X.shape()[1] != w.N()) { throw std::invalid_argument("Number of features does not match the model"); }
+
+			sparse_t rows = X.to_format(nd::sparse_format::csr);
+			size_t nSamples = rows.shape()[0];
+			const auto& rowStart = rows.pointers();
+			const auto& cols = rows.indices();
+			const auto& values = rows.values();
+
+			std::vector<size_t> order(nSamples);
+			std::iota(order.begin(), order.end(), (size_t)0);
+
+			nd::thread_pool pool(_nThreads);
+			double* pw = w.data();
+			const double* py = y.data();
+
+			_history.clear();
+			for (size_t epoch = 0; epoch < _maxIter; ++epoch)
+			{
+				auto start = std::chrono::steady_clock::now();
+				std::shuffle(order.begin(), order.end(), _rng);
+
+				pool.run(_nThreads, [&](size_t t)
+					{
+						size_t first = t * nSamples / _nThreads;
+						size_t last = (t + 1) * nSamples / _nThreads;
+						for (size_t k = first; k < last; ++k)
+						{
+							size_t i = order[k];
+							double g = _lr * (_sigmoid(_dot(rows, i, pw)) - py[i]);
+
+							for (auto n = rowStart[i]; n < rowStart[i + 1]; ++n)
+							{
+								std::atomic_ref<double> wj(pw[cols[n]]);
+								wj.store(wj.load(std::memory_order_relaxed) - g * values[n], std::memory_order_relaxed);
+							}
+						}
+					});
+
+				std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+				_history.push_back({ epoch, nSamples, elapsed.count(), nSamples / elapsed.count(), _log_loss(rows, pw, py) });
 			}
-			
-			
 		}
 
 	private:
 		double _lr;
 		size_t _maxIter;
-		cost_function _costFn;
+		size_t _nThreads;
+		std::mt19937_64 _rng;
+		std::vector<epoch_stats> _history;
+
+		static double _dot(const sparse_t& rows, size_t i, double* w)
+		{
+			const auto& rowStart = rows.pointers();
+			const auto& cols = rows.indices();
+			const auto& values = rows.values();
+
+			double z = 0.0;
+			for (auto n = rowStart[i]; n < rowStart[i + 1]; ++n)
+			{
+				z += values[n] * std::atomic_ref<double>(w[cols[n]]).load(std::memory_order_relaxed);
+			}
+			return z;
+		}
+
+		static double _sigmoid(double z) { return 1.0 / (1.0 + std::exp(-z)); }
+
+		static double _log_loss(const sparse_t& rows, double* w, const double* y)
+		{
+			const double eps = 1e-12;
+			double loss = 0.0;
+			for (size_t i = 0; i < rows.shape()[0]; ++i)
+			{
+				double p = _sigmoid(_dot(rows, i, w));
+				loss -= y[i] * std::log(p + eps) + (1.0 - y[i]) * std::log(1.0 - p + eps);
+			}
+			return loss;
+		}
 	};
-}
\ No newline at end of file
+}
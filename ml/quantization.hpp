@@ -0,0 +1,305 @@
+#pragma once
+
+#include "nets.hpp"
+#include "kernels.hpp"
+#include "ndimensions/parallel.hpp"
+
+#include <mkl/mkl_cblas.h>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#endif
+
+#include <cstdint>
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace ml::quantization
+{
+	/*
+	* Activations are quantized symmetrically to [-127, 127] and stored as unsigned bytes with a +128
+	* shift, which is the operand layout of cblas_gemm_s8u8s32 (A unsigned, B signed). Passing an A
+	* offset of -128 to the GEMM removes the shift again, so no zero-point correction is needed.
+	*/
+	constexpr int activation_shift = 128;
+
+	// Whether the CPU and OS support AVX512-VNNI or AVX-VNNI, which multiply u8 by s8 without intermediate saturation
+	inline bool cpu_has_vnni()
+	{
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+		int regs[4];
+		__cpuid(regs, 0);
+		if (regs[0] < 7) { return false; }
+		__cpuid(regs, 1);
+		if (!(regs[2] & (1 << 27))) { return false; }
+		unsigned long long xcr0 = _xgetbv(0);
+		__cpuidex(regs, 7, 0);
+		bool avx512Vnni = (regs[2] & (1 << 11)) && (xcr0 & 0xE6) == 0xE6;
+		__cpuidex(regs, 7, 1);
+		bool avxVnni = (regs[0] & (1 << 4)) && (xcr0 & 0x6) == 0x6;
+		return avx512Vnni || avxVnni;
+#elif defined(__x86_64__) || defined(__i386__)
+		unsigned int a, b, c, d;
+		if (__get_cpuid_max(0, nullptr) < 7) { return false; }
+		__cpuid(1, a, b, c, d);
+		if (!(c & (1u << 27))) { return false; }
+		unsigned int xcr0, xcr0High;
+		__asm__("xgetbv" : "=a"(xcr0), "=d"(xcr0High) : "c"(0));
+		__cpuid_count(7, 0, a, b, c, d);
+		bool avx512Vnni = (c & (1u << 11)) && (xcr0 & 0xE6) == 0xE6;
+		__cpuid_count(7, 1, a, b, c, d);
+		bool avxVnni = (a & (1u << 4)) && (xcr0 & 0x6) == 0x6;
+		return avx512Vnni || avxVnni;
+#else
+		return false;
+#endif
+	}
+
+	/*
+	* Largest magnitude of a quantized weight. Without VNNI, MKL's integer GEMM multiplies with
+	* vpmaddubsw, which adds two u8 * s8 products into an int16 and saturates when both are large:
+	* 2 * 255 * 127 overflows while 2 * 255 * 63 does not. Weights are then limited to 7 bits, at the
+	* cost of one bit of weight precision. The portable loop accumulates in int32 and uses the full range.
+	*/
+	inline int weight_levels()
+	{
+#ifdef ML_PORTABLE_INT8
+		return 127;
+#else
+		static const int levels = cpu_has_vnni() ? 127 : 63;
+		return levels;
+#endif
+	}
+
+	inline int8_t quantize_s8(double x, double scale, int levels = 127)
+	{
+		double q = std::round(x / scale);
+		return static_cast<int8_t>(std::clamp(q, -static_cast<double>(levels), static_cast<double>(levels)));
+	}
+
+	inline uint8_t quantize_u8(double x, double scale)
+	{
+		return static_cast<uint8_t>(quantize_s8(x, scale) + activation_shift);
+	}
+
+	// The portable loop behind gemm_u8s8s32 when ML_PORTABLE_INT8 is defined, exact for any s8 weights
+	inline void gemm_u8s8s32_reference(size_t rows, size_t cols, size_t depth, const uint8_t* A, size_t lda, const int8_t* B, size_t ldb, int32_t* C, size_t ldc)
+	{
+		nd::parallel_for(0, cols, [&](size_t first, size_t last)
+			{
+				for (size_t j = first; j < last; ++j)
+				{
+					int32_t* c = C + j * ldc;
+					std::fill(c, c + rows, 0);
+					for (size_t p = 0; p < depth; ++p)
+					{
+						const int32_t w = B[j * ldb + p];
+						const uint8_t* a = A + p * lda;
+						for (size_t i = 0; i < rows; ++i) { c[i] += (static_cast<int32_t>(a[i]) - activation_shift) * w; }
+					}
+				}
+			});
+	}
+
+	/*
+	* C (rows x cols, int32) = (A - 128) * B for shifted activations A (rows x depth, u8) and weights
+	* B (depth x cols, s8), all column-major. Uses MKL's integer GEMM, which runs on VNNI where the CPU
+	* has it, unless ML_PORTABLE_INT8 is defined, in which case a plain C++ loop is used instead. The
+	* result is exact as long as the weights are within +-weight_levels().
+	*/
+	inline void gemm_u8s8s32(size_t rows, size_t cols, size_t depth, const uint8_t* A, size_t lda, const int8_t* B, size_t ldb, int32_t* C, size_t ldc)
+	{
+#ifndef ML_PORTABLE_INT8
+		const MKL_INT32 offsetC = 0;
+		cblas_gemm_s8u8s32(CblasColMajor, CblasNoTrans, CblasNoTrans, CblasFixOffset,
+			static_cast<MKL_INT>(rows), static_cast<MKL_INT>(cols), static_cast<MKL_INT>(depth),
+			1.0f, A, static_cast<MKL_INT>(lda), static_cast<MKL_INT8>(-activation_shift), B, static_cast<MKL_INT>(ldb), 0,
+			0.0f, C, static_cast<MKL_INT>(ldc), &offsetC);
+#else
+		gemm_u8s8s32_reference(rows, cols, depth, A, lda, B, ldb, C, ldc);
+#endif
+	}
+
+	/*
+	* Post-training int8 version of a trained nets::mlp. Weights are quantized per output channel, the
+	* input scale of every layer is calibrated from the largest activation seen on a sample batch, and
+	* each layer runs as one integer GEMM followed by a fused pass that dequantizes the int32 results,
+	* adds the bias, applies the activation and requantizes them as the next layer's input. Only the
+	* last layer's output is written back as double.
+	*/
+	class int8_mlp
+	{
+	public:
+
+		int8_mlp(const nets::mlp& net, const matrix_t& calibration, size_t maxBatch = 256)
+			: _layers(),
+			_maxBatch(std::max<size_t>(maxBatch, 1)),
+			_activations(),
+			_accumulator()
+		{
+			if (!calibration.matrix() || calibration.shape()[1] != net.inputs()) { throw std::invalid_argument("Calibration batch does not match the number of inputs of the network"); }
+
+			size_t widest = net.inputs();
+			matrix_t h = calibration;
+			for (auto& layer : net.layers())
+			{
+				_layers.push_back(_quantize(layer, _input_scale(h)));
+				widest = std::max(widest, layer.size());
+				h = layer(h);
+			}
+
+			for (auto& buffer : _activations)
+			{
+				buffer.resize(_maxBatch * widest);
+			}
+			_accumulator.resize(_maxBatch * widest);
+		}
+
+		inline size_t inputs() const { return _layers.front().nIn; }
+
+		inline size_t outputs() const { return _layers.back().nOut; }
+
+		// Bytes taken by the quantized weights, biases and scales
+		size_t weight_bytes() const
+		{
+			size_t bytes = 0;
+			for (auto& layer : _layers)
+			{
+				bytes += layer.W.size() * sizeof(int8_t) + (layer.weightScales.size() + layer.b.size()) * sizeof(double);
+			}
+			return bytes;
+		}
+
+		matrix_t predict(const matrix_t& X)
+		{
+			if (!X.matrix() || X.shape()[1] != inputs()) { throw std::invalid_argument("Input does not match the number of inputs of the network"); }
+
+			size_t N = X.shape()[0];
+			matrix_t result({ N, outputs() });
+
+			for (size_t first = 0; first < N; first += _maxBatch)
+			{
+				size_t rows = std::min(_maxBatch, N - first);
+
+				const double* px = X.data() + first;
+				uint8_t* in = _activations[0].data();
+				double inScale = _layers.front().inputScale;
+				for (size_t k = 0; k < inputs(); ++k)
+				{
+					for (size_t i = 0; i < rows; ++i) { in[k * rows + i] = quantize_u8(px[k * N + i], inScale); }
+				}
+
+				for (size_t l = 0; l < _layers.size(); ++l)
+				{
+					auto& layer = _layers[l];
+					bool last = l + 1 == _layers.size();
+
+					gemm_u8s8s32(rows, layer.nOut, layer.nIn, _activations[l % 2].data(), rows, layer.W.data(), layer.nIn, _accumulator.data(), rows);
+
+					if (last) { _epilogue(layer, rows, result.data() + first, N, nullptr, 1.0); }
+					else { _epilogue(layer, rows, nullptr, 0, _activations[(l + 1) % 2].data(), _layers[l + 1].inputScale); }
+				}
+			}
+
+			return result;
+		}
+
+		inline matrix_t operator()(const matrix_t& X) { return predict(X); }
+
+	private:
+
+		struct _layer
+		{
+			size_t nIn;
+			size_t nOut;
+			std::vector<int8_t> W;
+			std::vector<double> weightScales;
+			std::vector<double> b;
+			double inputScale;
+			kernels::activation f;
+		};
+
+		std::vector<_layer> _layers;
+		size_t _maxBatch;
+		std::vector<uint8_t> _activations[2];
+		std::vector<int32_t> _accumulator;
+
+		static double _input_scale(const matrix_t& X)
+		{
+			double maxAbs = 0.0;
+			for (size_t i = 0; i < X.N(); ++i)
+			{
+				maxAbs = std::max(maxAbs, std::abs(X.data()[i]));
+			}
+			return (maxAbs > 0.0) ? maxAbs / 127.0 : 1.0;
+		}
+
+		static _layer _quantize(const layers::dense& layer, double inputScale)
+		{
+			size_t nIn = layer.inputs();
+			size_t nOut = layer.size();
+			const double* w = layer.weights().data();
+
+			_layer q{ nIn, nOut, std::vector<int8_t>(nIn * nOut), std::vector<double>(nOut),
+				std::vector<double>(layer.biases().data(), layer.biases().data() + nOut), inputScale, layer.activation_type() };
+
+			// One scale per output unit keeps small-magnitude channels from being flushed to zero
+			const int levels = weight_levels();
+			for (size_t j = 0; j < nOut; ++j)
+			{
+				double maxAbs = 0.0;
+				for (size_t k = 0; k < nIn; ++k) { maxAbs = std::max(maxAbs, std::abs(w[j * nIn + k])); }
+				q.weightScales[j] = (maxAbs > 0.0) ? maxAbs / levels : 1.0;
+
+				for (size_t k = 0; k < nIn; ++k) { q.W[j * nIn + k] = quantize_s8(w[j * nIn + k], q.weightScales[j], levels); }
+			}
+
+			return q;
+		}
+
+		/*
+		* Dequantizes the accumulator tile by tile, applies bias and activation while the tile is in cache,
+		* then writes it either as doubles to `out` or requantized with `nextScale` to `next`.
+		*/
+		void _epilogue(const _layer& layer, size_t rows, double* out, size_t ldout, uint8_t* next, double nextScale)
+		{
+			const size_t tileRows = kernels::tile_rows;
+			size_t nTiles = (rows + tileRows - 1) / tileRows;
+			const int32_t* acc = _accumulator.data();
+
+			nd::parallel_for(0, nTiles, [&](size_t firstTile, size_t lastTile)
+				{
+					std::vector<double> tile(tileRows * layer.nOut);
+					for (size_t t = firstTile; t < lastTile; ++t)
+					{
+						size_t r0 = t * tileRows;
+						size_t nRows = std::min(tileRows, rows - r0);
+
+						for (size_t j = 0; j < layer.nOut; ++j)
+						{
+							double scale = layer.inputScale * layer.weightScales[j];
+							for (size_t i = 0; i < nRows; ++i) { tile[j * tileRows + i] = acc[j * rows + r0 + i] * scale; }
+						}
+
+						kernels::bias_activation_tile(tile.data(), tileRows, nRows, layer.nOut, layer.b.data(), layer.f);
+
+						for (size_t j = 0; j < layer.nOut; ++j)
+						{
+							const double* col = tile.data() + j * tileRows;
+							if (next)
+							{
+								for (size_t i = 0; i < nRows; ++i) { next[j * rows + r0 + i] = quantize_u8(col[i], nextScale); }
+							}
+							else
+							{
+								std::copy(col, col + nRows, out + j * ldout + r0);
+							}
+						}
+					}
+				});
+		}
+	};
+}
@@ -2,11 +2,21 @@
 
 #include "math.hpp"
 #include "autograd.hpp"
+#include "ndimensions/parallel.hpp"
+
+#include <mutex>
 
 namespace ml::regression
 {
 	using namespace ml::autograd;
 
+	enum class solver
+	{
+		cholesky,
+		qr,
+		svd
+	};
+
 	class linear : public differentiable
 	{
 	public:
@@ -14,14 +24,20 @@ namespace ml::regression
 		linear()
 			: _y(),
 			_X(),
-			_b()
+			_b(),
+			_gram(),
+			_moment(),
+			_nSeen(0)
 		{
 		}
 
 		linear(const matrix_t& y, const matrix_t& X)
 			: _y(y),
 			_X(X),
-			_b(nd::array<>::random({ X.shape()[1], 1 }))
+			_b(nd::array<>::random({ X.shape()[1], 1 })),
+			_gram(),
+			_moment(),
+			_nSeen(0)
 		{
 		}
 
@@ -31,11 +47,148 @@ namespace ml::regression
 			return X * _b;
 		}
 
+		parameter operator()(const sparse_t& X) const
+		{
+			return X * _b;
+		}
+
+		inline const matrix_t& coefficients() const { return _b.value(); }
+
+		/*
+		* Fits the coefficients directly instead of iteratively. Cholesky solves the normal equations
+		* and is the fastest for well-conditioned data, QR works on X itself and SVD also handles
+		* rank-deficient X by returning the minimum-norm solution.
+		*/
+		void fit(solver method = solver::cholesky)
+		{
+			fit(_y.value(), _X.value(), method);
+		}
+
+		void fit(const matrix_t& y, const matrix_t& X, solver method = solver::cholesky)
+		{
+			if (X.shape()[0] != y.shape()[0]) { throw std::invalid_argument("X and y must have the same number of rows"); }
+
+			switch (method)
+			{
+			case solver::cholesky:
+			{
+				matrix_t moment;
+				matrix_t::gemm_into(moment, X, y, 1.0, 0.0, true);
+				_b.set_value(X.gram().cholesky_solve(moment));
+				break;
+			}
+			case solver::qr:
+				_b.set_value(X.qr_solve(y));
+				break;
+			case solver::svd:
+				_b.set_value(X.lstsq(y));
+				break;
+			}
+		}
+
+		/*
+		* Incremental least squares for data that does not fit in memory. Each call to update() adds
+		* a block of rows to the running X'X and X'y, so memory stays O(features^2) however many rows
+		* are streamed. finalize() solves for the coefficients and may be called again after more
+		* updates to refit on all data seen so far.
+		*/
+		void update(const matrix_t& y, const matrix_t& X)
+		{
+			size_t n = X.shape()[0];
+			size_t d = X.shape()[1];
+			size_t k = y.vector() ? 1 : y.shape()[1];
+			if (y.shape()[0] != n) { throw std::invalid_argument("X and y must have the same number of rows"); }
+
+			if (_gram.empty())
+			{
+				_gram = matrix_t({ d, d });
+				_moment = matrix_t({ d, k });
+			}
+			else if (_gram.shape()[0] != d || _moment.shape()[1] != k)
+			{
+				throw std::invalid_argument("Block does not match the shape of previous updates");
+			}
+
+			const size_t blockRows = 4096;
+			size_t nBlocks = (n + blockRows - 1) / blockRows;
+			std::mutex accumulate;
+
+			nd::parallel_for(0, nBlocks, [&](size_t firstBlock, size_t lastBlock)
+				{
+					matrix_t gram({ d, d });
+					matrix_t moment({ d, k });
+
+					for (size_t b = firstBlock; b < lastBlock; ++b)
+					{
+						size_t first = b * blockRows;
+						int rows = static_cast<int>(std::min(blockRows, n - first));
+						const double* Xb = X.data() + first;
+						const double* yb = y.data() + first;
+
+						cblas_dsyrk(CblasColMajor, CblasLower, CblasTrans, static_cast<int>(d), rows, 1.0, Xb, static_cast<int>(n), 1.0, gram.data(), static_cast<int>(d));
+						if (k == 1)
+						{
+							cblas_dgemv(CblasColMajor, CblasTrans, rows, static_cast<int>(d), 1.0, Xb, static_cast<int>(n), yb, 1, 1.0, moment.data(), 1);
+						}
+						else
+						{
+							cblas_dgemm(CblasColMajor, CblasTrans, CblasNoTrans, static_cast<int>(d), static_cast<int>(k), rows, 1.0, Xb, static_cast<int>(n), yb, static_cast<int>(n), 1.0, moment.data(), static_cast<int>(d));
+						}
+					}
+
+					std::lock_guard<std::mutex> lock(accumulate);
+					_gram += gram;
+					_moment += moment;
+				});
+
+			_nSeen += n;
+		}
+
+		void finalize(double ridge = 0.0)
+		{
+			if (_gram.empty()) { throw std::invalid_argument("No data has been added with update()"); }
+
+			// Only the lower triangle of the Gram matrix is accumulated, which is all the Cholesky solve reads
+			matrix_t gram(_gram);
+			for (size_t i = 0; i < gram.shape()[0]; ++i)
+			{
+				gram({ i, i }) += ridge;
+			}
+
+			_b.set_value(gram.cholesky_solve(_moment));
+		}
+
+		void reset()
+		{
+			_gram = matrix_t();
+			_moment = matrix_t();
+			_nSeen = 0;
+		}
+
+		inline size_t samples_seen() const { return _nSeen; }
 
 	private:
 		parameter _y;
 		parameter _X;
 		parameter _b;
+		matrix_t _gram;
+		matrix_t _moment;
+		size_t _nSeen;
+
+		std::vector<size_t> _trainable_param_ids() const
+		{
+			return { _b.id() };
+		}
+
+		void _update_parameter(size_t id, const matrix_t& delta)
+		{
+			_b.set_value(_b.value() - delta);
+		}
+
+		matrix_t& _parameter_value(size_t id)
+		{
+			return _b.value();
+		}
 	};
 
 
@@ -61,7 +214,12 @@ namespace ml::regression
 		parameter operator()(const std::vector<parameter>& params) const
 		{
 			auto& X = params[0];
-			return softmax(X * _w);
+			return sigmoid(X * _w);
+		}
+
+		parameter operator()(const sparse_t& X) const
+		{
+			return sigmoid(X * _w);
 		}
 
 	private:
@@ -78,5 +236,68 @@ namespace ml::regression
 		{
 			_w.set_value(_w.value() - delta);
 		}
+
+		matrix_t& _parameter_value(size_t id)
+		{
+			return _w.value();
+		}
+	};
+
+
+
+	/*
+	* Multinomial (softmax) logistic regression over K classes. The model outputs logits and is meant
+	* to be trained with metrics::categorical_cross_entropy against one-hot targets.
+	*/
+	class multinomial : public differentiable
+	{
+	public:
+
+		multinomial()
+			: _W()
+		{
+		}
+
+		multinomial(size_t nFeatures, size_t nClasses)
+			: _W(matrix_t({ nFeatures, nClasses }))
+		{
+		}
+
+		parameter operator()(const std::vector<parameter>& params) const
+		{
+			auto& X = params[0];
+			return X * _W;
+		}
+
+		parameter operator()(const sparse_t& X) const
+		{
+			return X * _W;
+		}
+
+		inline size_t classes() const { return _W.value().shape()[1]; }
+
+		inline const matrix_t& weights() const { return _W.value(); }
+
+		matrix_t predict_proba(const matrix_t& X) const { return row_softmax(X * _W.value()); }
+
+		matrix_t predict(const matrix_t& X) const { return (X * _W.value()).argmax(1); }
+
+	private:
+		parameter _W;
+
+		std::vector<size_t> _trainable_param_ids() const
+		{
+			return { _W.id() };
+		}
+
+		void _update_parameter(size_t id, const matrix_t& delta)
+		{
+			_W.set_value(_W.value() - delta);
+		}
+
+		matrix_t& _parameter_value(size_t id)
+		{
+			return _W.value();
+		}
 	};
 }
\ No newline at end of file
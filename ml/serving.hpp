@@ -0,0 +1,318 @@
+#pragma once
+
+#include "nets.hpp"
+
+#include <chrono>
+#include <deque>
+#include <future>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <functional>
+#include <algorithm>
+#include <vector>
+
+namespace ml::serving
+{
+	using namespace ml::autograd;
+
+	struct server_options
+	{
+		// Largest number of requests answered by one forward pass
+		size_t maxBatch = 64;
+
+		// How long the oldest queued request may wait for others to join its batch
+		std::chrono::microseconds latencyBudget = std::chrono::microseconds(1000);
+
+		// Threads forming and running batches, each runs its own forward pass
+		size_t nWorkers = 1;
+
+		// Number of most recent request latencies the percentiles are computed over
+		size_t latencyWindow = 8192;
+	};
+
+	struct server_stats
+	{
+		size_t requests;
+		size_t batches;
+		double meanBatchSize;
+		double p50LatencyMs;
+		double p99LatencyMs;
+		double requestsPerSec;
+	};
+
+	/*
+	* In-process inference runtime with dynamic batching. Threads submit single samples and get a future
+	* for the prediction; workers collect queued samples until either `maxBatch` are waiting or the oldest
+	* has waited `latencyBudget`, run one batched forward pass over them and fulfil the futures with the
+	* matching rows. Latency is measured from submit() until the result is set.
+	*/
+	class inference_server
+	{
+	public:
+
+		typedef std::function<matrix_t(const matrix_t&)> forward_fn;
+
+		/*
+		* Serves any batched forward function taking {N, nInputs} and returning N rows. With more than
+		* one worker it is called concurrently and must be thread-safe.
+		*/
+		inference_server(forward_fn forward, size_t nInputs, const server_options& options = server_options())
+			: _nInputs(nInputs),
+			_options(_validate(options)),
+			_forwards(_options.nWorkers, forward),
+			_mutex(),
+			_ready(),
+			_queue(),
+			_stopping(false),
+			_latencies(),
+			_nextLatency(0),
+			_nRequests(0),
+			_nBatches(0),
+			_started(clock::now()),
+			_workers()
+		{
+			_start();
+		}
+
+		// Every worker runs its own copy of the network, since mlp::predict reuses internal buffers
+		inference_server(const nets::mlp& net, const server_options& options = server_options())
+			: _nInputs(net.inputs()),
+			_options(_validate(options)),
+			_forwards(),
+			_mutex(),
+			_ready(),
+			_queue(),
+			_stopping(false),
+			_latencies(),
+			_nextLatency(0),
+			_nRequests(0),
+			_nBatches(0),
+			_started(clock::now()),
+			_workers()
+		{
+			for (size_t w = 0; w < _options.nWorkers; ++w)
+			{
+				auto copy = std::make_shared<nets::mlp>(net);
+				_forwards.push_back([copy](const matrix_t& X) { return copy->predict(X); });
+			}
+			_start();
+		}
+
+		// Serves the output of a differentiable model such as regression::logistic, which must outlive the server
+		inference_server(const differentiable& model, size_t nInputs, const server_options& options = server_options())
+			: inference_server([&model](const matrix_t& X) { return model({ parameter(X) }).value(); }, nInputs, options)
+		{
+		}
+
+		inference_server(const inference_server&) = delete;
+		inference_server& operator=(const inference_server&) = delete;
+
+		// Requests still queued are answered before the workers exit
+		~inference_server()
+		{
+			{
+				std::lock_guard<std::mutex> lock(_mutex);
+				_stopping = true;
+			}
+			_ready.notify_all();
+
+			for (auto& worker : _workers)
+			{
+				worker.join();
+			}
+		}
+
+		inline size_t inputs() const { return _nInputs; }
+
+		// Queues one sample with `inputs()` values and returns its prediction as a {1, outputs} row
+		std::future<matrix_t> submit(const matrix_t& x)
+		{
+			if (x.N() != _nInputs) { throw std::invalid_argument("Sample does not match the number of inputs of the model"); }
+
+			_request request{ x, std::promise<matrix_t>(), clock::now() };
+			std::future<matrix_t> result = request.result.get_future();
+			{
+				std::lock_guard<std::mutex> lock(_mutex);
+				if (_stopping) { throw std::invalid_argument("Server is shutting down"); }
+				_queue.push_back(std::move(request));
+			}
+			_ready.notify_one();
+
+			return result;
+		}
+
+		inline matrix_t predict(const matrix_t& x) { return submit(x).get(); }
+
+		server_stats stats() const
+		{
+			std::vector<double> latencies;
+			server_stats result{};
+			{
+				std::lock_guard<std::mutex> lock(_mutex);
+				latencies = _latencies;
+				result.requests = _nRequests;
+				result.batches = _nBatches;
+
+				double seconds = std::chrono::duration<double>(clock::now() - _started).count();
+				result.requestsPerSec = (seconds > 0.0) ? _nRequests / seconds : 0.0;
+			}
+
+			result.meanBatchSize = (result.batches > 0) ? static_cast<double>(result.requests) / result.batches : 0.0;
+			result.p50LatencyMs = _percentile(latencies, 0.50);
+			result.p99LatencyMs = _percentile(latencies, 0.99);
+			return result;
+		}
+
+		// Clears the counters, e.g. after a warm-up phase
+		void reset_stats()
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			_latencies.clear();
+			_nextLatency = 0;
+			_nRequests = 0;
+			_nBatches = 0;
+			_started = clock::now();
+		}
+
+	private:
+
+		typedef std::chrono::steady_clock clock;
+
+		struct _request
+		{
+			matrix_t x;
+			std::promise<matrix_t> result;
+			clock::time_point submitted;
+		};
+
+		size_t _nInputs;
+		server_options _options;
+		std::vector<forward_fn> _forwards;
+		mutable std::mutex _mutex;
+		std::condition_variable _ready;
+		std::deque<_request> _queue;
+		bool _stopping;
+		std::vector<double> _latencies;
+		size_t _nextLatency;
+		size_t _nRequests;
+		size_t _nBatches;
+		clock::time_point _started;
+		std::vector<std::thread> _workers;
+
+		static server_options _validate(server_options options)
+		{
+			options.maxBatch = std::max<size_t>(options.maxBatch, 1);
+			options.nWorkers = std::max<size_t>(options.nWorkers, 1);
+			options.latencyWindow = std::max<size_t>(options.latencyWindow, 1);
+			return options;
+		}
+
+		static double _percentile(std::vector<double>& values, double q)
+		{
+			if (values.empty()) { return 0.0; }
+
+			auto nth = values.begin() + static_cast<size_t>(q * (values.size() - 1));
+			std::nth_element(values.begin(), nth, values.end());
+			return *nth;
+		}
+
+		void _start()
+		{
+			_workers.reserve(_options.nWorkers);
+			for (size_t w = 0; w < _options.nWorkers; ++w)
+			{
+				_workers.emplace_back([this, w]() { _work(_forwards[w]); });
+			}
+		}
+
+		void _work(const forward_fn& forward)
+		{
+			std::vector<_request> batch;
+			batch.reserve(_options.maxBatch);
+
+			while (true)
+			{
+				{
+					std::unique_lock<std::mutex> lock(_mutex);
+					_ready.wait(lock, [this]() { return _stopping || !_queue.empty(); });
+					if (_queue.empty()) { return; }
+
+					// Give other requests until the oldest one's budget runs out to fill the batch
+					auto deadline = _queue.front().submitted + _options.latencyBudget;
+					_ready.wait_until(lock, deadline, [this]() { return _stopping || _queue.size() >= _options.maxBatch; });
+					if (_queue.empty()) { continue; }
+
+					size_t n = std::min(_options.maxBatch, _queue.size());
+					for (size_t i = 0; i < n; ++i)
+					{
+						batch.push_back(std::move(_queue.front()));
+						_queue.pop_front();
+					}
+				}
+
+				// More requests may have queued up than fit into this batch
+				_ready.notify_one();
+
+				_run(forward, batch);
+				batch.clear();
+			}
+		}
+
+		void _run(const forward_fn& forward, std::vector<_request>& batch)
+		{
+			size_t N = batch.size();
+			matrix_t X({ N, _nInputs });
+			double* px = X.data();
+			for (size_t i = 0; i < N; ++i)
+			{
+				const double* x = batch[i].x.data();
+				for (size_t k = 0; k < _nInputs; ++k) { px[k * N + i] = x[k]; }
+			}
+
+			matrix_t Y;
+			try
+			{
+				Y = forward(X);
+				if (!Y.matrix() || Y.shape()[0] != N) { throw std::invalid_argument("Model returned a wrong number of rows"); }
+			}
+			catch (...)
+			{
+				_record(batch);
+				for (auto& request : batch) { request.result.set_exception(std::current_exception()); }
+				return;
+			}
+
+			size_t nOut = Y.shape()[1];
+			const double* py = Y.data();
+			std::vector<matrix_t> rows(N, matrix_t({ 1, nOut }));
+			for (size_t i = 0; i < N; ++i)
+			{
+				for (size_t k = 0; k < nOut; ++k) { rows[i].data()[k] = py[k * N + i]; }
+			}
+
+			// Counted before the futures become ready, so callers never see a result missing from stats()
+			_record(batch);
+			for (size_t i = 0; i < N; ++i)
+			{
+				batch[i].result.set_value(std::move(rows[i]));
+			}
+		}
+
+		void _record(const std::vector<_request>& batch)
+		{
+			auto now = clock::now();
+
+			std::lock_guard<std::mutex> lock(_mutex);
+			for (auto& request : batch)
+			{
+				double ms = std::chrono::duration<double, std::milli>(now - request.submitted).count();
+				if (_latencies.size() < _options.latencyWindow) { _latencies.push_back(ms); }
+				else { _latencies[_nextLatency] = ms; }
+				_nextLatency = (_nextLatency + 1) % _options.latencyWindow;
+			}
+			_nRequests += batch.size();
+			_nBatches++;
+		}
+	};
+}
@@ -2,6 +2,10 @@
 
 #include "utils.hpp"
 #include "array_iter.hpp"
+#include "reduce.hpp"
+#include "parallel.hpp"
+#include "random.hpp"
+#include "profiler.hpp"
 
 #include "mklutils.hpp"
 #include <mkl/mkl_cblas.h>
@@ -13,6 +17,9 @@
 #include <stdexcept>
 #include <memory>
 #include <functional>
+#include <span>
+#include <cstring>
+#include <utility>
 
 namespace nd
 {
@@ -44,6 +51,8 @@ namespace nd
 			swap(_shape, other._shape);
 			swap(_shapeHash, other._shapeHash);
 			swap(_strides, other._strides);
+			swap(_owner, other._owner);
+			swap(_capacity, other._capacity);
 		}
 
 		array()
@@ -51,7 +60,9 @@ namespace nd
 			_nItems(0),
 			_shape(),
 			_shapeHash(0),
-			_strides()
+			_strides(),
+			_owner(true),
+			_capacity(0)
 		{
 		}
 
@@ -60,7 +71,9 @@ namespace nd
 			_nItems(0),
 			_shape(shape),
 			_shapeHash(std::hash<shape_t>()(shape)),
-			_strides(shape.size())
+			_strides(shape.size()),
+			_owner(true),
+			_capacity(0)
 		{
 			_alloc();
 		}
@@ -82,6 +95,24 @@ namespace nd
 			memcpy(_values, other._values, sizeof(Ty) * other._nItems);
 		}
 
+		/*
+		* Wraps memory owned by someone else, e.g. a memory-mapped checkpoint, without copying it.
+		* The memory must outlive the view and every array it is moved into. Copies of a view own
+		* their data as usual.
+		*/
+		static ndarray_t view(Ty* data, const shape_t& shape)
+		{
+			ndarray_t result;
+			result._shape = shape;
+			result._shapeHash = std::hash<shape_t>()(shape);
+			result._strides = calculate_strides(shape);
+			result._nItems = std::reduce(shape.begin(), shape.end(), (size_t)1, std::multiplies<size_t>{});
+			result._values = (result._nItems == 0) ? nullptr : data;
+			result._owner = false;
+			result._capacity = result._nItems;
+			return result;
+		}
+
 		array(ndarray_t&& other) noexcept
 			: ndarray_t()
 		{
@@ -113,6 +144,8 @@ namespace nd
 
 		inline bool empty() const { return _values == nullptr || _nItems == 0; }
 
+		inline bool owns_data() const { return _owner; }
+
 		inline bool scalar() const { return _shape.size() == 1 && _shape[0] == 1; }
 
 		inline bool vector() const { return _shape.size() == 1; }
@@ -123,6 +156,10 @@ namespace nd
 
 		inline index_t zero_index() const { return index_t(_shape.size(), 0); }
 
+		inline Ty* data() { return _values; }
+
+		inline const Ty* data() const { return _values; }
+
 
 
 		/*
@@ -131,50 +168,35 @@ namespace nd
 
 		ndarray_t operator+(const ndarray_t& other) const
 		{
-			if (!_same_shape_as(other)) { throw std::invalid_argument("Cannot add arrays with different shapes"); }
-
-			ndarray_t result(_shape);
-			for (size_t i = 0; i < _nItems; ++i)
-			{
-				result._values[i] = _values[i] + other._values[i];
-			}
+			ndarray_t result;
+			add_into(result, *this, other);
 			return result;
 		}
 
 		ndarray_t& operator+=(const ndarray_t& other)
 		{
-			if (!_same_shape_as(other)) { throw std::invalid_argument("Cannot add arrays with different shapes"); }
-
-			for (size_t i = 0; i < _nItems; ++i)
-			{
-				_values[i] += other._values[i];
-			}
+			add_into(*this, *this, other);
 			return *this;
 		}
 
 		ndarray_t operator-(const ndarray_t& other) const
 		{
-			if (!_same_shape_as(other)) { throw std::invalid_argument("Cannot subtract arrays with different shapes"); }
-
-			ndarray_t result(_shape);
-			for (size_t i = 0; i < _nItems; ++i)
-			{
-				result._values[i] = _values[i] - other._values[i];
-			}
+			ndarray_t result;
+			subtract_into(result, *this, other);
 			return result;
 		}
 
 		ndarray_t& operator-=(const ndarray_t& other)
 		{
-			if (!_same_shape_as(other)) { throw std::invalid_argument("Cannot subtract arrays with different shapes"); }
-
-			for (size_t i = 0; i < _nItems; ++i)
-			{
-				_values[i] -= other._values[i];
-			}
+			subtract_into(*this, *this, other);
 			return *this;
 		}
 
+		/*
+		* Matrix product, routed by shape: vector . vector is a ddot, products with a single row or column
+		* a dgemv, a column times a row a dger and everything else a dgemm. One-dimensional arrays are
+		* treated as columns, so a matrix times a vector of length k gives a vector.
+		*/
 		ndarray_t operator*(const ndarray_t& other) const
 		{
 			if (scalar() && other.scalar())
@@ -197,84 +219,140 @@ namespace nd
 				return dot(other);
 			}
 
-			if (!matrix() || !other.matrix()) { throw std::invalid_argument("Cannot multiply arrays with more than 2 dimensions"); }
-			if (_shape[1] != other._shape[0]) { throw std::invalid_argument("A * B requries the shape of A to be [a, b] and the shape of B to be [b, c]"); }
-
-			ndarray_t result({ _shape[0], other._shape[1] });
-			double alpha = 1.0;
-			double beta = 0.0;
-
-			mkl_props_t propsA(*this);
-			mkl_props_t propsB(other);
-			mkl_props_t propsC(result);
-
-			Ty* p = result._values;
-
-			cblas_dgemm(
-				CblasColMajor,
-				CblasNoTrans,
-				CblasNoTrans,
-				propsA.m,
-				propsC.n,
-				propsA.n,
-				alpha,
-				propsA.data,
-				propsA.ld,
-				propsB.data,
-				propsB.ld,
-				beta,
-				propsC.data,
-				propsC.ld
-			);
+			if (_shape.size() > 2 || other._shape.size() > 2) { throw std::invalid_argument("Cannot multiply arrays with more than 2 dimensions"); }
+			if (static_cast<size_t>(_columns_of(*this)) != other._shape[0]) { throw std::invalid_argument("A * B requries the shape of A to be [a, b] and the shape of B to be [b, c]"); }
 
+			ndarray_t result = other.vector() ? ndarray_t(shape_t{ _shape[0] }) : ndarray_t({ _shape[0], other._shape[1] });
+			gemm_into(result, *this, other);
 			return result;
 		}
 
 		Ty dot(const ndarray_t& other) const
 		{
+			ND_PROFILE_SCOPE("nd", "dot");
+			ND_PROFILE_FLOPS(2 * _nItems);
 			if (_nItems != other._nItems) { throw std::invalid_argument("Cannot take dot product of arrays of different length"); }
 
-			Ty sum{};
-			for (size_t i = 0; i < _nItems; ++i)
-			{
-				sum += _values[i] * other._values[i];
-			}
-			return sum;
+			return cblas_ddot(static_cast<int>(_nItems), _values, 1, other._values, 1);
 		}
 
 		ndarray_t hadamard(const ndarray_t& other) const
 		{
-			if (!_same_shape_as(other)) { throw std::invalid_argument("Cannot multiply arrays with different shapes"); }
+			ndarray_t result;
+			hadamard_into(result, *this, other);
+			return result;
+		}
+
+		ndarray_t T() const
+		{
+			ndarray_t transpose;
+			transpose_into(transpose, *this);
+			return transpose;
+		}
 
-			ndarray_t result(_shape);
-			for (size_t i = 0; i < _nItems; ++i)
+		/*
+		* C = alpha * op(A) * op(B) + beta * C, where op transposes when asked to. C is written in place
+		* when it already has the shape of the product; otherwise it is allocated, which is only allowed
+		* for beta = 0. Single rows and columns go to dgemv, a column times a row to dger and the rest to
+		* dgemm, so accumulating gradients or moments into a preallocated C never allocates. C must not
+		* share memory with A or B.
+		*/
+		static void gemm_into(ndarray_t& C, const ndarray_t& A, const ndarray_t& B, Ty alpha = 1, Ty beta = 0, bool transA = false, bool transB = false)
+		{
+			ND_PROFILE_SCOPE("nd", "gemm");
+			auto [m, k] = _op_shape_of(A, transA);
+			auto [kB, n] = _op_shape_of(B, transB);
+			ND_PROFILE_FLOPS(2.0 * m * n * k);
+			if (k != kB) { throw std::invalid_argument("A * B requries the shape of A to be [a, b] and the shape of B to be [b, c]"); }
+			if (C._aliases(A) || C._aliases(B)) { throw std::invalid_argument("Output of a product must not share memory with its operands"); }
+
+			if (C._shape.size() > 2 || _op_shape_of(C, false) != std::pair<size_t, size_t>(m, n))
 			{
-				result._values[i] = _values[i] * other._values[i];
+				if (beta != 0) { throw std::invalid_argument("Cannot accumulate into an array of a different shape"); }
+				_prepare_out(C, { m, n });
+			}
+			if (m == 0 || n == 0) { return; }
+
+			int M = static_cast<int>(m), N = static_cast<int>(n), K = static_cast<int>(k);
+			int ldA = static_cast<int>(A._shape[0]), ldB = static_cast<int>(B._shape[0]);
+
+			if (k == 0)
+			{
+				C._scale(beta);
+			}
+			else if (m == 1 && n == 1)
+			{
+				Ty product = alpha * cblas_ddot(K, A._values, 1, B._values, 1);
+				C._values[0] = (beta == 0) ? product : product + beta * C._values[0];
+			}
+			else if (n == 1)
+			{
+				// op(B) is a single column whatever its layout, so it is contiguous
+				cblas_dgemv(CblasColMajor, transA ? CblasTrans : CblasNoTrans, static_cast<int>(A._shape[0]), static_cast<int>(_columns_of(A)),
+					alpha, A._values, ldA, B._values, 1, beta, C._values, 1);
+			}
+			else if (m == 1)
+			{
+				// The row op(A) * op(B) is op(B)' * op(A)'
+				cblas_dgemv(CblasColMajor, transB ? CblasNoTrans : CblasTrans, static_cast<int>(B._shape[0]), static_cast<int>(_columns_of(B)),
+					alpha, B._values, ldB, A._values, 1, beta, C._values, 1);
+			}
+			else if (k == 1)
+			{
+				C._scale(beta);
+				cblas_dger(CblasColMajor, M, N, alpha, A._values, 1, B._values, 1, C._values, M);
+			}
+			else
+			{
+				cblas_dgemm(CblasColMajor, transA ? CblasTrans : CblasNoTrans, transB ? CblasTrans : CblasNoTrans,
+					M, N, K, alpha, A._values, ldA, B._values, ldB, beta, C._values, M);
 			}
-			return result;
 		}
 
-		ndarray_t T() const
+		/*
+		* C = alpha * A'A + beta * C (or A A' when transA is false) with dsyrk, which computes one
+		* triangle at roughly half the cost of the general product; the other is mirrored so C is a
+		* regular symmetric matrix. Allocation follows gemm_into.
+		*/
+		static void syrk_into(ndarray_t& C, const ndarray_t& A, Ty alpha = 1, Ty beta = 0, bool transA = true)
 		{
-			if (!matrix()) { throw std::invalid_argument("Array is not a matrix"); }
+			ND_PROFILE_SCOPE("nd", "syrk");
+			auto [n, k] = _op_shape_of(A, transA);
+			ND_PROFILE_FLOPS(1.0 * n * n * k);
+			if (C._aliases(A)) { throw std::invalid_argument("Output of a product must not share memory with its operands"); }
 
-			ndarray_t transpose({ _shape[1], _shape[0] });
+			if (C._shape.size() != 2 || C._shape[0] != n || C._shape[1] != n)
+			{
+				if (beta != 0) { throw std::invalid_argument("Cannot accumulate into an array of a different shape"); }
+				_prepare_out(C, { n, n });
+			}
+			if (n == 0) { return; }
+
+			cblas_dsyrk(CblasColMajor, CblasLower, transA ? CblasTrans : CblasNoTrans, static_cast<int>(n), static_cast<int>(k),
+				alpha, A._values, static_cast<int>(A._shape[0]), beta, C._values, static_cast<int>(n));
 
-			for (size_t i = 0; i < _shape[0]; ++i)
+			for (size_t j = 1; j < n; ++j)
 			{
-				for (size_t j = 0; j < _shape[1]; ++j)
+				for (size_t i = 0; i < j; ++i)
 				{
-					size_t srcOffset = offset_of({ i, j }, _strides);
-					size_t destOffset = offset_of({ j, i }, transpose._strides);
-					transpose._values[destOffset] = _values[srcOffset];
+					C._values[j * n + i] = C._values[i * n + j];
 				}
 			}
+		}
 
-			return transpose;
+		// X'X without forming the transpose
+		ndarray_t gram() const
+		{
+			if (!matrix()) { throw std::invalid_argument("Array is not a matrix"); }
+
+			ndarray_t result;
+			syrk_into(result, *this);
+			return result;
 		}
 
 		ndarray_t inv()
 		{
+			ND_PROFILE_SCOPE("nd", "inv");
 			if (!square()) { throw std::invalid_argument("Cannot inverse a non-square matrix"); }
 
 			ndarray_t inverse(*this);
@@ -286,32 +364,129 @@ namespace nd
 			return inverse;
 		}
 
-		ndarray_t map(unary_fn transform) const
+		ndarray_t solve(const ndarray_t& B) const
 		{
-			ndarray_t result(_shape);
-			for (size_t i = 0; i < _nItems; ++i)
+			ND_PROFILE_SCOPE("nd", "solve");
+			if (!square()) { throw std::invalid_argument("Cannot solve a system with a non-square matrix"); }
+			_throw_if_not_rhs(B, _shape[0]);
+
+			ndarray_t lu(*this);
+			ndarray_t X(B);
+			std::vector<int> ipiv(_shape[0]);
+
+			mkl_props_t props(lu);
+			int info = LAPACKE_dgesv(LAPACK_COL_MAJOR, props.m, _columns_of(X), props.data, props.ld, ipiv.data(), X._values, props.m);
+			if (info > 0) { throw std::invalid_argument("Matrix is singular"); }
+			return X;
+		}
+
+		ndarray_t cholesky() const
+		{
+			ND_PROFILE_SCOPE("nd", "cholesky");
+			if (!square()) { throw std::invalid_argument("Cannot factor a non-square matrix"); }
+
+			ndarray_t L(*this);
+			mkl_props_t props(L);
+			int info = LAPACKE_dpotrf(LAPACK_COL_MAJOR, 'L', props.m, props.data, props.ld);
+			if (info > 0) { throw std::invalid_argument("Matrix is not positive definite"); }
+
+			for (size_t j = 1; j < _shape[1]; ++j)
 			{
-				result._values[i] = transform(_values[i]);
+				std::fill(L._values + j * _shape[0], L._values + j * _shape[0] + j, static_cast<Ty>(0));
 			}
-			return result;
+			return L;
 		}
 
-		ndarray_t operator+(Ty scalar) const
+		ndarray_t cholesky_solve(const ndarray_t& B) const
 		{
-			ndarray_t result(*this);
-			for (size_t i = 0; i < _nItems; ++i)
+			ND_PROFILE_SCOPE("nd", "cholesky_solve");
+			if (!square()) { throw std::invalid_argument("Cannot solve a system with a non-square matrix"); }
+			_throw_if_not_rhs(B, _shape[0]);
+
+			ndarray_t factor(*this);
+			ndarray_t X(B);
+
+			mkl_props_t props(factor);
+			int info = LAPACKE_dposv(LAPACK_COL_MAJOR, 'L', props.m, _columns_of(X), props.data, props.ld, X._values, props.m);
+			if (info > 0) { throw std::invalid_argument("Matrix is not positive definite"); }
+			return X;
+		}
+
+		std::pair<ndarray_t, ndarray_t> qr() const
+		{
+			if (!matrix()) { throw std::invalid_argument("Array is not a matrix"); }
+
+			size_t m = _shape[0];
+			size_t n = _shape[1];
+			size_t k = std::min(m, n);
+
+			ndarray_t factors(*this);
+			std::vector<Ty> tau(k);
+			mkl_props_t props(factors);
+			LAPACKE_dgeqrf(LAPACK_COL_MAJOR, props.m, props.n, props.data, props.ld, tau.data());
+
+			ndarray_t R({ k, n });
+			for (size_t j = 0; j < n; ++j)
 			{
-				result._values[i] += scalar;
+				std::copy(factors._values + j * m, factors._values + j * m + std::min(j + 1, k), R._values + j * k);
 			}
+
+			ndarray_t Q({ m, k });
+			std::copy(factors._values, factors._values + m * k, Q._values);
+			LAPACKE_dorgqr(LAPACK_COL_MAJOR, props.m, static_cast<int>(k), static_cast<int>(k), Q._values, props.ld, tau.data());
+
+			return { Q, R };
+		}
+
+		ndarray_t qr_solve(const ndarray_t& B) const
+		{
+			ND_PROFILE_SCOPE("nd", "qr_solve");
+			if (!matrix()) { throw std::invalid_argument("Array is not a matrix"); }
+			_throw_if_not_rhs(B, _shape[0]);
+
+			ndarray_t factors(*this);
+			ndarray_t X = _lstsq_workspace(B);
+
+			mkl_props_t props(factors);
+			int info = LAPACKE_dgels(LAPACK_COL_MAJOR, 'N', props.m, props.n, _columns_of(B), props.data, props.ld, X._values, X._shape[0]);
+			if (info > 0) { throw std::invalid_argument("Matrix does not have full rank"); }
+			return _lstsq_result(X, B);
+		}
+
+		ndarray_t lstsq(const ndarray_t& B, double rcond = -1.0) const
+		{
+			ND_PROFILE_SCOPE("nd", "lstsq");
+			if (!matrix()) { throw std::invalid_argument("Array is not a matrix"); }
+			_throw_if_not_rhs(B, _shape[0]);
+
+			ndarray_t factors(*this);
+			ndarray_t X = _lstsq_workspace(B);
+			std::vector<Ty> singularValues(std::min(_shape[0], _shape[1]));
+			int rank = 0;
+
+			mkl_props_t props(factors);
+			int info = LAPACKE_dgelsd(LAPACK_COL_MAJOR, props.m, props.n, _columns_of(B), props.data, props.ld, X._values, X._shape[0], singularValues.data(), rcond, &rank);
+			if (info > 0) { throw std::invalid_argument("SVD failed to converge"); }
+			return _lstsq_result(X, B);
+		}
+
+		ndarray_t map(unary_fn transform) const
+		{
+			ndarray_t result;
+			map_into(result, *this, transform);
+			return result;
+		}
+
+		ndarray_t operator+(Ty scalar) const
+		{
+			ndarray_t result;
+			add_into(result, *this, scalar);
 			return result;
 		}
 
 		ndarray_t& operator+=(Ty scalar)
 		{
-			for (size_t i = 0; i < _nItems; ++i)
-			{
-				_values[i] += scalar;
-			}
+			add_into(*this, *this, scalar);
 			return *this;
 		}
 
@@ -319,49 +494,34 @@ namespace nd
 
 		ndarray_t operator-(Ty scalar) const
 		{
-			ndarray_t result(*this);
-			for (size_t i = 0; i < _nItems; ++i)
-			{
-				result._values[i] -= scalar;
-			}
+			ndarray_t result;
+			subtract_into(result, *this, scalar);
 			return result;
 		}
 
 		ndarray_t& operator-=(Ty scalar)
 		{
-			for (size_t i = 0; i < _nItems; ++i)
-			{
-				_values[i] -= scalar;
-			}
+			subtract_into(*this, *this, scalar);
 			return *this;
 		}
 
 		friend ndarray_t operator-(Ty scalar, const ndarray_t& X)
 		{
-			ndarray_t result(X);
-			for (size_t i = 0; i < result._nItems; ++i)
-			{
-				result._values[i] = scalar - X._values[i];
-			}
+			ndarray_t result;
+			subtract_into(result, scalar, X);
 			return result;
 		}
 
 		ndarray_t operator*(Ty scalar) const
 		{
-			ndarray_t result(*this);
-			for (size_t i = 0; i < _nItems; ++i)
-			{
-				result._values[i] *= scalar;
-			}
+			ndarray_t result;
+			multiply_into(result, *this, scalar);
 			return result;
 		}
 
 		ndarray_t& operator*=(Ty scalar)
 		{
-			for (size_t i = 0; i < _nItems; ++i)
-			{
-				_values[i] *= scalar;
-			}
+			multiply_into(*this, *this, scalar);
 			return *this;
 		}
 
@@ -369,31 +529,145 @@ namespace nd
 
 		ndarray_t operator/(Ty scalar) const
 		{
-			ndarray_t result(*this);
-			for (size_t i = 0; i < _nItems; ++i)
-			{
-				result._values[i] /= scalar;
-			}
+			ndarray_t result;
+			divide_into(result, *this, scalar);
 			return result;
 		}
 
 		ndarray_t& operator/=(Ty scalar)
 		{
+			divide_into(*this, *this, scalar);
+			return *this;
+		}
+
+		friend ndarray_t operator/(Ty scalar, const ndarray_t& X)
+		{
+			ndarray_t result;
+			divide_into(result, scalar, X);
+			return result;
+		}
+
+
+
+		/*
+		* OUTPUT AND IN-PLACE VARIANTS
+		*/
+
+		/*
+		* Every _into function writes its result to `out`, keeping the buffer when `out` already has the
+		* result's shape and allocating otherwise, so calling them repeatedly with the same output never
+		* allocates. Elementwise functions may be given one of their operands as `out` to work in place,
+		* but no output may partially overlap an operand.
+		*/
+		static void add_into(ndarray_t& out, const ndarray_t& A, const ndarray_t& B)
+		{
+			ND_PROFILE_SCOPE("nd", "add");
+			ND_PROFILE_FLOPS(A._nItems);
+			if (!A._same_shape_as(B)) { throw std::invalid_argument("Cannot add arrays with different shapes"); }
+			_elementwise_into(out, A, B, [](Ty a, Ty b) { return a + b; });
+		}
+
+		static void subtract_into(ndarray_t& out, const ndarray_t& A, const ndarray_t& B)
+		{
+			ND_PROFILE_SCOPE("nd", "subtract");
+			ND_PROFILE_FLOPS(A._nItems);
+			if (!A._same_shape_as(B)) { throw std::invalid_argument("Cannot subtract arrays with different shapes"); }
+			_elementwise_into(out, A, B, [](Ty a, Ty b) { return a - b; });
+		}
+
+		static void hadamard_into(ndarray_t& out, const ndarray_t& A, const ndarray_t& B)
+		{
+			ND_PROFILE_SCOPE("nd", "hadamard");
+			ND_PROFILE_FLOPS(A._nItems);
+			if (!A._same_shape_as(B)) { throw std::invalid_argument("Cannot multiply arrays with different shapes"); }
+			_elementwise_into(out, A, B, [](Ty a, Ty b) { return a * b; });
+		}
+
+		inline static void add_into(ndarray_t& out, const ndarray_t& X, Ty scalar) { map_into(out, X, [scalar](Ty x) { return x + scalar; }); }
+
+		inline static void subtract_into(ndarray_t& out, const ndarray_t& X, Ty scalar) { map_into(out, X, [scalar](Ty x) { return x - scalar; }); }
+
+		inline static void subtract_into(ndarray_t& out, Ty scalar, const ndarray_t& X) { map_into(out, X, [scalar](Ty x) { return scalar - x; }); }
+
+		inline static void multiply_into(ndarray_t& out, const ndarray_t& X, Ty scalar) { map_into(out, X, [scalar](Ty x) { return x * scalar; }); }
+
+		inline static void divide_into(ndarray_t& out, const ndarray_t& X, Ty scalar) { map_into(out, X, [scalar](Ty x) { return x / scalar; }); }
+
+		inline static void divide_into(ndarray_t& out, Ty scalar, const ndarray_t& X) { map_into(out, X, [scalar](Ty x) { return scalar / x; }); }
+
+		// Takes any callable, so unlike map() a lambda is inlined into the loop
+		template <class Fn>
+		static void map_into(ndarray_t& out, const ndarray_t& X, Fn transform)
+		{
+			ND_PROFILE_SCOPE("nd", "map");
+			ND_PROFILE_FLOPS(X._nItems);
+			_throw_if_partial_alias(out, X);
+			_prepare_out(out, X._shape);
+			for (size_t i = 0; i < X._nItems; ++i)
+			{
+				out._values[i] = transform(X._values[i]);
+			}
+		}
+
+		template <class Fn>
+		ndarray_t& apply(Fn transform)
+		{
+			map_into(*this, *this, transform);
+			return *this;
+		}
+
+		// this += alpha * X
+		ndarray_t& add_scaled(const ndarray_t& X, Ty alpha)
+		{
+			ND_PROFILE_SCOPE("nd", "add_scaled");
+			ND_PROFILE_FLOPS(2 * _nItems);
+			if (!_same_shape_as(X)) { throw std::invalid_argument("Cannot add arrays with different shapes"); }
+			_throw_if_partial_alias(*this, X);
+			cblas_daxpy(static_cast<int>(_nItems), alpha, X._values, 1, _values, 1);
+			return *this;
+		}
+
+		// this += A * B elementwise
+		ndarray_t& add_hadamard(const ndarray_t& A, const ndarray_t& B)
+		{
+			ND_PROFILE_SCOPE("nd", "add_hadamard");
+			ND_PROFILE_FLOPS(2 * _nItems);
+			if (!_same_shape_as(A) || !A._same_shape_as(B)) { throw std::invalid_argument("Cannot multiply arrays with different shapes"); }
+			_throw_if_partial_alias(*this, A);
+			_throw_if_partial_alias(*this, B);
 			for (size_t i = 0; i < _nItems; ++i)
 			{
-				_values[i] /= scalar;
+				_values[i] += A._values[i] * B._values[i];
 			}
 			return *this;
 		}
 
-		friend ndarray_t operator/(Ty scalar, const ndarray_t& X)
+		static void transpose_into(ndarray_t& out, const ndarray_t& X)
 		{
-			ndarray_t result(X);
-			for (size_t i = 0; i < result._nItems; ++i)
+			ND_PROFILE_SCOPE("nd", "transpose");
+			if (!X.matrix()) { throw std::invalid_argument("Array is not a matrix"); }
+			if (out._aliases(X)) { throw std::invalid_argument("Output of a transpose must not share memory with its input"); }
+
+			_prepare_out(out, { X._shape[1], X._shape[0] });
+			for (size_t i = 0; i < X._shape[0]; ++i)
 			{
-				result._values[i] = scalar / X._values[i];
+				for (size_t j = 0; j < X._shape[1]; ++j)
+				{
+					size_t srcOffset = offset_of(X._strides, i, j);
+					size_t destOffset = offset_of(out._strides, j, i);
+					out._values[destOffset] = X._values[srcOffset];
+				}
 			}
-			return result;
+		}
+
+		void reduce_into(ndarray_t& out, const std::vector<size_t>& dimensions, reduction op) const
+		{
+			ND_PROFILE_SCOPE("nd", "reduce");
+			ND_PROFILE_FLOPS(_nItems);
+			if (out._aliases(*this)) { throw std::invalid_argument("Output of a reduction must not share memory with its input"); }
+
+			_prepare_out(out, reduced_shape(_shape, dimensions));
+			nd::reduce(_values, _shape, dimensions, op, out._values);
 		}
 
 
@@ -412,47 +686,53 @@ namespace nd
 			return result;
 		}
 
-		ndarray_t sum(size_t dimension) const
-		{
-			if (dimension >= _shape.size()) { throw std::invalid_argument("Cannot take sum along dimension"); }
-
-			shape_t resultShape(_shape);
-			resultShape[dimension] = 1;
-			ndarray_t result(resultShape);
+		inline ndarray_t sum(size_t dimension) const { return reduce({ dimension }, reduction::sum); }
 
-			std::vector<range> ndRange = bounds_of(_shape);
+		inline ndarray_t sum(const std::vector<size_t>& dimensions) const { return reduce(dimensions, reduction::sum); }
 
-			for (size_t n = 0; n < _shape[dimension]; ++n)
+		Ty max() const
+		{
+			Ty result = _values[0];
+			for (size_t i = 1; i < _nItems; ++i)
 			{
-				ndRange[dimension] = range(n, n + 1);
-				result += (*this)(ndRange);
+				result = (_values[i] > result) ? _values[i] : result;
 			}
 
 			return result;
 		}
 
-		Ty max() const
+		inline ndarray_t max(size_t dimension) const { return reduce({ dimension }, reduction::max); }
+
+		inline ndarray_t max(const std::vector<size_t>& dimensions) const { return reduce(dimensions, reduction::max); }
+
+		Ty min() const
 		{
 			Ty result = _values[0];
 			for (size_t i = 1; i < _nItems; ++i)
 			{
-				result = (_values[i] > result) ? _values[i] : result;
+				result = (_values[i] < result) ? _values[i] : result;
 			}
 
 			return result;
 		}
 
+		inline ndarray_t min(size_t dimension) const { return reduce({ dimension }, reduction::min); }
+
+		inline ndarray_t min(const std::vector<size_t>& dimensions) const { return reduce(dimensions, reduction::min); }
+
+		// Index along `dimension` of the largest item, e.g. the predicted class of every row for dimension 1
+		inline ndarray_t argmax(size_t dimension) const { return reduce({ dimension }, reduction::argmax); }
+
+		inline ndarray_t argmin(size_t dimension) const { return reduce({ dimension }, reduction::argmin); }
+
 		Ty mean() const
 		{
 			return sum() / static_cast<Ty>(_nItems);
 		}
 
-		ndarray_t mean(size_t dimension) const
-		{
-			if (dimension >= _shape.size()) { throw std::invalid_argument("Cannot take mean along dimension"); }
+		inline ndarray_t mean(size_t dimension) const { return reduce({ dimension }, reduction::mean); }
 
-			return sum(dimension) / static_cast<Ty>(_shape[dimension]);
-		}
+		inline ndarray_t mean(const std::vector<size_t>& dimensions) const { return reduce(dimensions, reduction::mean); }
 
 		Ty variance() const
 		{
@@ -466,28 +746,27 @@ namespace nd
 			return sum / static_cast<Ty>(_nItems);
 		}
 
-		ndarray_t variance(size_t dimension) const
-		{
-			if (dimension >= _shape.size()) { throw std::invalid_argument("Cannot take variance along dimension"); }
+		inline ndarray_t variance(size_t dimension) const { return reduce({ dimension }, reduction::variance); }
 
-			ndarray_t u = mean(dimension);
-			ndarray_t sum(u.shape);
-			std::vector<range> ndRange = bounds_of(_shape);
-			for (size_t i = 0; i < _shape[dimension]; ++i)
-			{
-				ndRange[dimension] = i;
+		inline ndarray_t variance(const std::vector<size_t>& dimensions) const { return reduce(dimensions, reduction::variance); }
 
-				ndarray_t slice = (*this)(ndRange);
-				ndarray_t diff = slice - u;
-				sum += diff.hadamard(diff);
-			}
+		inline Ty stddev() const { return std::sqrt(variance()); }
 
-			return sum / static_cast<Ty>(_shape[dimension]);
-		}
+		inline ndarray_t stddev(size_t dimension) const { return stddev(std::vector<size_t>{ dimension }); }
 
-		inline Ty stddev() const { return std::sqrt(variance()); }
+		ndarray_t stddev(const std::vector<size_t>& dimensions) const
+		{
+			ndarray_t result = variance(dimensions);
+			return result.apply([](Ty x) { return std::sqrt(x); });
+		}
 
-		inline Ty stddev(size_t dimension) const { return variance(dimension).map(std::sqrt); }
+		// Reduces along every dimension in `dimensions` in one pass, which keep size 1 in the result (see nd::reduce)
+		ndarray_t reduce(const std::vector<size_t>& dimensions, reduction op) const
+		{
+			ndarray_t result;
+			reduce_into(result, dimensions, op);
+			return result;
+		}
 
 
 
@@ -510,14 +789,25 @@ namespace nd
 			return I;
 		}
 
-		static ndarray_t random(const shape_t& shape)
+		// Uniform on [0, 1), filled in parallel from `generator` (see nd::random_generator)
+		static ndarray_t random(const shape_t& shape, random_generator& generator = default_generator())
 		{
 			ndarray_t mat(shape);
-			for (size_t i = 0; i < mat._nItems; ++i)
-			{
-				mat._values[i] = random_uniform();
-			}
+			generator.uniform(mat._values, mat._nItems);
+			return mat;
+		}
+
+		static ndarray_t random_normal(const shape_t& shape, Ty mean = 0, Ty stddev = 1, random_generator& generator = default_generator())
+		{
+			ndarray_t mat(shape);
+			generator.normal(mat._values, mat._nItems, mean, stddev);
+			return mat;
+		}
 
+		static ndarray_t bernoulli(const shape_t& shape, double p, random_generator& generator = default_generator())
+		{
+			ndarray_t mat(shape);
+			generator.bernoulli(mat._values, mat._nItems, p);
 			return mat;
 		}
 		
@@ -543,6 +833,10 @@ namespace nd
 
 		inline Ty operator()(const index_t& ndIndex) const { return _values[offset_of(ndIndex, _strides)]; }
 
+		// Element at (i, j, ...) with one integer per dimension, e.g. A(i, j) instead of A({ i, j })
+		template <std::integral... Idx>
+		inline Ty operator()(Idx... ndIndex) const { return _values[offset_of(_strides, ndIndex...)]; }
+
 		Ty at(const index_t& ndIndex) const
 		{
 			_throw_if_invalid(ndIndex);
@@ -594,6 +888,9 @@ namespace nd
 
 		Ty& operator()(const index_t& ndIndex) { return _values[offset_of(ndIndex, _strides)]; }
 
+		template <std::integral... Idx>
+		inline Ty& operator()(Idx... ndIndex) { return _values[offset_of(_strides, ndIndex...)]; }
+
 		Ty& at(const index_t& ndIndex)
 		{
 			_throw_if_invalid(ndIndex);
@@ -612,38 +909,220 @@ namespace nd
 			if (_nItems != newSize) { throw std::invalid_argument("New shape may not alter the number of items in array"); }
 
 			_shape = newShape;
+			_shapeHash = std::hash<shape_t>()(_shape);
 			_strides = calculate_strides(newShape);
 			return *this;
 		}
 
-		ndarray_t concat(const ndarray_t& other, size_t dimension = 0) const 
+		/*
+		* Reorders the dimensions so that dimension n of the result is dimension `axes[n]` of this array,
+		* e.g. { 1, 0 } is the transpose of a matrix. The result is written in memory order, reading the
+		* source with its stride along axes[0] in the innermost loop.
+		*/
+		ndarray_t permute(const std::vector<size_t>& axes) const
 		{
-			if (dims() != other.dims()) { throw std::invalid_argument("Array being added must have same number dimensions"); }
+			if (axes.size() != dims()) { throw std::invalid_argument("Permutation must list every dimension once"); }
 
-			shape_t newShape(_shape);
-			newShape[dimension] += other._shape[dimension];
+			std::vector<bool> seen(dims(), false);
+			shape_t newShape(dims());
+			stride_t srcStrides(dims());
+			for (size_t n = 0; n < axes.size(); ++n)
+			{
+				if (axes[n] >= dims() || seen[axes[n]]) { throw std::invalid_argument("Permutation must list every dimension once"); }
+				seen[axes[n]] = true;
+				newShape[n] = _shape[axes[n]];
+				srcStrides[n] = _strides[axes[n]];
+			}
 
 			ndarray_t result(newShape);
-			index_t destIndex = result.zero_index();
-			size_t srcOffsetA = 0;
-			size_t srcOffsetB = 0;
-			size_t nValsCopied = 0;
+			if (result.empty()) { return result; }
+
+			size_t inner = newShape[0];
+			size_t nOuter = result._nItems / inner;
+			parallel_for(0, nOuter, [&](size_t first, size_t last)
+				{
+					// Source offset of the first outer index, then stepped like increment_index
+					index_t index(newShape.size(), 0);
+					size_t remaining = first;
+					size_t srcOffset = 0;
+					for (size_t n = 1; n < newShape.size(); ++n)
+					{
+						index[n] = remaining % newShape[n];
+						remaining /= newShape[n];
+						srcOffset += index[n] * srcStrides[n];
+					}
+
+					for (size_t o = first; o < last; ++o)
+					{
+						Ty* dest = result._values + o * inner;
+						const Ty* src = _values + srcOffset;
+						for (size_t i = 0; i < inner; ++i) { dest[i] = src[i * srcStrides[0]]; }
+
+						for (size_t n = 1; n < newShape.size(); ++n)
+						{
+							srcOffset += srcStrides[n];
+							if (++index[n] < newShape[n]) { break; }
+							srcOffset -= index[n] * srcStrides[n];
+							index[n] = 0;
+						}
+					}
+				}, std::max<size_t>(1, 16384 / inner));
+
+			return result;
+		}
+
+		inline ndarray_t concat(const ndarray_t& other, size_t dimension = 0) const { return concatenate({ *this, other }, dimension); }
+
+		/*
+		* Joins arrays along an existing dimension. The result is allocated once and, since everything
+		* before `dimension` is contiguous in column-major order, filled with one memcpy per array and
+		* outer index, spread over the thread pool for large inputs.
+		*/
+		static ndarray_t concatenate(const std::vector<std::reference_wrapper<const ndarray_t>>& arrays, size_t dimension = 0)
+		{
+			ND_PROFILE_SCOPE("nd", "concatenate");
+			if (arrays.empty()) { throw std::invalid_argument("Nothing to concatenate"); }
 
-			while (nValsCopied < result.N())
+			const ndarray_t& first = arrays.front();
+			if (dimension >= first.dims()) { throw std::invalid_argument("Cannot concatenate along dimension " + std::to_string(dimension)); }
+
+			shape_t newShape(first._shape);
+			newShape[dimension] = 0;
+			for (const ndarray_t& a : arrays)
 			{
-				if (destIndex[dimension] < _shape[dimension])
+				if (a.dims() != first.dims()) { throw std::invalid_argument("Array being added must have same number dimensions"); }
+				for (size_t n = 0; n < a.dims(); ++n)
 				{
-					result(destIndex) = _values[srcOffsetA];
-					srcOffsetA++;
+					if (n != dimension && a._shape[n] != first._shape[n]) { throw std::invalid_argument("Arrays being joined must match outside the joined dimension"); }
 				}
-				else
+				newShape[dimension] += a._shape[dimension];
+			}
+
+			size_t inner = std::reduce(first._shape.begin(), first._shape.begin() + dimension, (size_t)1, std::multiplies<size_t>{});
+			size_t outer = std::reduce(first._shape.begin() + dimension + 1, first._shape.end(), (size_t)1, std::multiplies<size_t>{});
+
+			ndarray_t result(newShape);
+			_join(arrays, [&](const ndarray_t& a) { return inner * a._shape[dimension]; }, outer, result._values);
+			return result;
+		}
+
+		static inline ndarray_t concatenate(std::span<const ndarray_t> arrays, size_t dimension = 0)
+		{
+			return concatenate(std::vector<std::reference_wrapper<const ndarray_t>>(arrays.begin(), arrays.end()), dimension);
+		}
+
+		// Joins arrays of identical shape along a new dimension inserted at `dimension`
+		static ndarray_t stack(const std::vector<std::reference_wrapper<const ndarray_t>>& arrays, size_t dimension = 0)
+		{
+			ND_PROFILE_SCOPE("nd", "stack");
+			if (arrays.empty()) { throw std::invalid_argument("Nothing to stack"); }
+
+			const ndarray_t& first = arrays.front();
+			if (dimension > first.dims()) { throw std::invalid_argument("Cannot stack along dimension " + std::to_string(dimension)); }
+
+			for (const ndarray_t& a : arrays)
+			{
+				if (a._shape != first._shape) { throw std::invalid_argument("Arrays being stacked must have the same shape"); }
+			}
+
+			shape_t newShape;
+			for (size_t n = 0; n <= first.dims(); ++n)
+			{
+				if (n == dimension) { newShape.push_back(arrays.size()); }
+				if (n < first.dims()) { newShape.push_back(first._shape[n]); }
+			}
+
+			size_t inner = std::reduce(first._shape.begin(), first._shape.begin() + dimension, (size_t)1, std::multiplies<size_t>{});
+			size_t outer = first._nItems / std::max<size_t>(inner, 1);
+
+			ndarray_t result(newShape);
+			_join(arrays, [&](const ndarray_t& a) { return inner; }, outer, result._values);
+			return result;
+		}
+
+		static inline ndarray_t stack(std::span<const ndarray_t> arrays, size_t dimension = 0)
+		{
+			return stack(std::vector<std::reference_wrapper<const ndarray_t>>(arrays.begin(), arrays.end()), dimension);
+		}
+
+		/*
+		* Appends `other` along the last dimension, which is the outermost in memory, so existing values
+		* stay where they are. Storage grows geometrically like std::vector, making a sequence of appends
+		* amortized linear. `other` either has the same shape apart from the last dimension or is a single
+		* slice with the last dimension left out; appending to an empty array copies `other`. To build a
+		* matrix sample by sample, append the samples as columns and transpose once at the end.
+		*/
+		ndarray_t& append(const ndarray_t& other)
+		{
+			if (&other == this) { return append(ndarray_t(other)); }
+			if (dims() == 0)
+			{
+				*this = other;
+				return *this;
+			}
+
+			size_t last = dims() - 1;
+			bool isSlice = other.dims() == last;
+			if (!isSlice && other.dims() != dims()) { throw std::invalid_argument("Array being appended has an incorrect number of dimensions"); }
+			for (size_t n = 0; n < last; ++n)
+			{
+				if (other._shape[n] != _shape[n]) { throw std::invalid_argument("Array being appended must match outside the last dimension"); }
+			}
+
+			size_t newItems = _nItems + other._nItems;
+			if (newItems > _capacity || !_owner)
+			{
+				reserve(std::max(newItems, 2 * _capacity));
+			}
+
+			memcpy(_values + _nItems, other._values, sizeof(Ty) * other._nItems);
+			_nItems = newItems;
+			_shape[last] += isSlice ? 1 : other._shape[last];
+			_shapeHash = std::hash<shape_t>()(_shape);
+			_strides = calculate_strides(_shape);
+			return *this;
+		}
+
+		// Makes room for `nItems` values so that appending up to that size does not reallocate
+		void reserve(size_t nItems)
+		{
+			if (nItems <= _capacity && _owner) { return; }
+
+			Ty* values = new Ty[std::max(nItems, _nItems)];
+			ND_PROFILE_ALLOC(sizeof(Ty) * std::max(nItems, _nItems));
+			if (_nItems > 0) { memcpy(values, _values, sizeof(Ty) * _nItems); }
+
+			size_t nKept = _nItems;
+			_free();
+			_values = values;
+			_nItems = nKept;
+			_capacity = std::max(nItems, nKept);
+			_owner = true;
+		}
+
+		inline size_t capacity() const { return _capacity; }
+
+		ndarray_t take(std::span<const size_t> indices, size_t dimension = 0) const
+		{
+			if (empty() || dimension >= _shape.size()) { throw std::invalid_argument("Cannot take along dimension"); }
+
+			shape_t newShape(_shape);
+			newShape[dimension] = indices.size();
+			ndarray_t result(newShape);
+			if (result.empty()) { return result; }
+
+			size_t innerSize = _strides[dimension];
+			size_t outerCount = _nItems / (innerSize * _shape[dimension]);
+			for (size_t o = 0; o < outerCount; ++o)
+			{
+				const Ty* src = _values + o * innerSize * _shape[dimension];
+				Ty* dest = result._values + o * innerSize * indices.size();
+				for (size_t k = 0; k < indices.size(); ++k)
 				{
-					result(destIndex) = other._values[srcOffsetB];
-					srcOffsetB++;
-				}
+					if (indices[k] >= _shape[dimension]) { throw std::invalid_argument("Index to take is out of bounds"); }
 
-				increment_index(destIndex, newShape);
-				nValsCopied++;
+					std::copy(src + indices[k] * innerSize, src + (indices[k] + 1) * innerSize, dest + k * innerSize);
+				}
 			}
 
 			return result;
@@ -662,6 +1141,7 @@ namespace nd
 
 			_strides = calculate_strides(newShape);
 			_shape = newShape;
+			_shapeHash = std::hash<shape_t>()(_shape);
 			return *this;
 		}
 
@@ -673,7 +1153,7 @@ namespace nd
 			ndarray_t diagonal({ N });
 			for (size_t i = 0; i < N; ++i)
 			{
-				diagonal._values[i] = _values[offset_of({ i, i }, _strides)];
+				diagonal._values[i] = _values[offset_of(_strides, i, i)];
 			}
 
 			return diagonal;
@@ -737,6 +1217,8 @@ namespace nd
 		shape_t _shape;
 		size_t _shapeHash;
 		stride_t _strides;
+		bool _owner;
+		size_t _capacity;
 
 
 
@@ -755,6 +1237,8 @@ namespace nd
 			}
 
 			_values = new Ty[_nItems];
+			_capacity = _nItems;
+			ND_PROFILE_ALLOC(sizeof(Ty) * _nItems);
 			memset(_values, 0, sizeof(Ty) * _nItems);
 			_strides = calculate_strides(_shape);
 		}
@@ -763,14 +1247,131 @@ namespace nd
 		{
 			if (_values != nullptr)
 			{
-				delete[] _values;
+				if (_owner) { delete[] _values; }
 				_values = nullptr;
 				_nItems = 0;
+				_capacity = 0;
 			}
 		}
 
 		inline bool _same_shape_as(const ndarray_t& other) const { return _shapeHash == other._shapeHash; }
 
+		// Keeps the buffer of `out` when it already has `shape`, views cannot be reallocated
+		static void _prepare_out(ndarray_t& out, const shape_t& shape)
+		{
+			if (out._shape == shape) { return; }
+			if (!out._owner) { throw std::invalid_argument("View does not have the shape of the result"); }
+			out = ndarray_t(shape);
+		}
+
+		// Working in place is fine for elementwise operations, any other overlap is not
+		static void _throw_if_partial_alias(const ndarray_t& out, const ndarray_t& X)
+		{
+			if (out._aliases(X) && (out._values != X._values || out._nItems != X._nItems))
+			{
+				throw std::invalid_argument("Output partially overlaps an operand");
+			}
+		}
+
+		template <class Fn>
+		static void _elementwise_into(ndarray_t& out, const ndarray_t& A, const ndarray_t& B, Fn fn)
+		{
+			_throw_if_partial_alias(out, A);
+			_throw_if_partial_alias(out, B);
+			_prepare_out(out, A._shape);
+			for (size_t i = 0; i < A._nItems; ++i)
+			{
+				out._values[i] = fn(A._values[i], B._values[i]);
+			}
+		}
+
+		// Whether the values of both arrays overlap in memory
+		inline bool _aliases(const ndarray_t& other) const
+		{
+			if (_nItems == 0 || other._nItems == 0) { return false; }
+			return _values < other._values + other._nItems && other._values < _values + _nItems;
+		}
+
+		// Rows and columns of op(X) for a matrix or a vector taken as a column
+		static std::pair<size_t, size_t> _op_shape_of(const ndarray_t& X, bool transposed)
+		{
+			if (X._shape.size() > 2) { throw std::invalid_argument("Cannot multiply arrays with more than 2 dimensions"); }
+
+			size_t rows = X._shape.empty() ? 0 : X._shape[0];
+			size_t columns = X._shape.empty() ? 0 : static_cast<size_t>(_columns_of(X));
+			return transposed ? std::pair<size_t, size_t>(columns, rows) : std::pair<size_t, size_t>(rows, columns);
+		}
+
+		void _scale(Ty factor)
+		{
+			if (factor == 0) { std::fill(_values, _values + _nItems, static_cast<Ty>(0)); }
+			else if (factor != 1) { cblas_dscal(static_cast<int>(_nItems), factor, _values, 1); }
+		}
+
+		/*
+		* Writes `outer` rounds of one contiguous chunk per array (chunkOf(a) values, taken from the
+		* matching round of a) to dest. Each (round, array) pair is an independent memcpy.
+		*/
+		template <class ChunkFn>
+		static void _join(const std::vector<std::reference_wrapper<const ndarray_t>>& arrays, ChunkFn chunkOf, size_t outer, Ty* dest)
+		{
+			size_t nArrays = arrays.size();
+			std::vector<size_t> chunks(nArrays), destOffsets(nArrays);
+			size_t roundSize = 0;
+			for (size_t k = 0; k < nArrays; ++k)
+			{
+				chunks[k] = chunkOf(arrays[k].get());
+				destOffsets[k] = roundSize;
+				roundSize += chunks[k];
+			}
+			if (roundSize == 0) { return; }
+
+			size_t grain = std::max<size_t>(1, (size_t(1) << 16) / std::max<size_t>(roundSize / nArrays, 1));
+			parallel_for(0, outer * nArrays, [&](size_t first, size_t last)
+				{
+					for (size_t t = first; t < last; ++t)
+					{
+						size_t o = t / nArrays, k = t % nArrays;
+						if (chunks[k] == 0) { continue; }
+						memcpy(dest + o * roundSize + destOffsets[k], arrays[k].get()._values + o * chunks[k], sizeof(Ty) * chunks[k]);
+					}
+				}, grain);
+		}
+
+		static int _columns_of(const ndarray_t& B) { return static_cast<int>(B.vector() ? 1 : B._shape[1]); }
+
+		static void _throw_if_not_rhs(const ndarray_t& B, size_t nRows)
+		{
+			if ((!B.vector() && !B.matrix()) || B._shape[0] != nRows) { throw std::invalid_argument("Right-hand side must have the same number of rows as the matrix"); }
+		}
+
+		// LAPACK least-squares drivers need a right-hand side with max(m, n) rows to hold the solution
+		ndarray_t _lstsq_workspace(const ndarray_t& B) const
+		{
+			size_t ldb = std::max(_shape[0], _shape[1]);
+			size_t nrhs = _columns_of(B);
+
+			ndarray_t X({ ldb, nrhs });
+			for (size_t j = 0; j < nrhs; ++j)
+			{
+				std::copy(B._values + j * _shape[0], B._values + (j + 1) * _shape[0], X._values + j * ldb);
+			}
+			return X;
+		}
+
+		ndarray_t _lstsq_result(const ndarray_t& X, const ndarray_t& B) const
+		{
+			size_t n = _shape[1];
+			size_t nrhs = _columns_of(B);
+
+			ndarray_t result = B.vector() ? ndarray_t(shape_t{ n }) : ndarray_t({ n, nrhs });
+			for (size_t j = 0; j < nrhs; ++j)
+			{
+				std::copy(X._values + j * X._shape[0], X._values + j * X._shape[0] + n, result._values + j * n);
+			}
+			return result;
+		}
+
 		void _throw_if_invalid(const index_t& ndIndex) const
 		{
 			if (ndIndex.size() != _shape.size()) { throw std::invalid_argument("Index does not have the correct number of dimensions"); }
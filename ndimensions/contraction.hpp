@@ -0,0 +1,384 @@
+#pragma once
+
+#include "array.hpp"
+
+#include <mkl/mkl_cblas.h>
+
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <numeric>
+#include <stdexcept>
+
+namespace nd
+{
+	/*
+	* C_b = op(A_b) * op(B_b) for every b < batch with column-major m x k, k x n and m x n operands,
+	* where consecutive A, B and C matrices are strideA, strideB and strideC items apart. A stride of 0
+	* reuses the same operand for the whole batch.
+	*/
+	inline void gemm_batch(bool transA, bool transB, size_t m, size_t n, size_t k,
+		const double* A, size_t lda, size_t strideA, const double* B, size_t ldb, size_t strideB,
+		double* C, size_t ldc, size_t strideC, size_t batch)
+	{
+		ND_PROFILE_SCOPE("nd", "gemm_batch");
+		ND_PROFILE_FLOPS(2.0 * m * n * k * batch);
+		if (batch == 0 || m == 0 || n == 0) { return; }
+		if (k == 0)
+		{
+			for (size_t b = 0; b < batch; ++b)
+			{
+				for (size_t j = 0; j < n; ++j) { std::fill(C + b * strideC + j * ldc, C + b * strideC + j * ldc + m, 0.0); }
+			}
+			return;
+		}
+
+		cblas_dgemm_batch_strided(CblasColMajor, transA ? CblasTrans : CblasNoTrans, transB ? CblasTrans : CblasNoTrans,
+			static_cast<MKL_INT>(m), static_cast<MKL_INT>(n), static_cast<MKL_INT>(k), 1.0,
+			A, static_cast<MKL_INT>(std::max<size_t>(lda, 1)), static_cast<MKL_INT>(strideA),
+			B, static_cast<MKL_INT>(std::max<size_t>(ldb, 1)), static_cast<MKL_INT>(strideB), 0.0,
+			C, static_cast<MKL_INT>(std::max<size_t>(ldc, 1)), static_cast<MKL_INT>(strideC), static_cast<MKL_INT>(batch));
+	}
+
+	/*
+	* Batched matrix product. Matrices are the two leading (contiguous) dimensions and any further
+	* dimensions index the batch, so A {m, k, batch...} times B {k, n, batch...} is C {m, n, batch...}.
+	* Either operand may be a single matrix shared by the whole batch. Two plain matrices are multiplied
+	* with operator*.
+	*/
+	inline array<double> matmul(const array<double>& A, const array<double>& B)
+	{
+		if (A.dims() <= 2 && B.dims() <= 2) { return A * B; }
+		if (A.dims() < 2 || B.dims() < 2) { throw std::invalid_argument("Batched products need at least two dimensions per operand"); }
+
+		size_t m = A.shape()[0], k = A.shape()[1], n = B.shape()[1];
+		if (B.shape()[0] != k) { throw std::invalid_argument("A * B requries the shape of A to be [a, b, ...] and the shape of B to be [b, c, ...]"); }
+
+		const array<double>& batched = (A.dims() > 2) ? A : B;
+		if (A.dims() > 2 && B.dims() > 2 && !std::equal(A.shape().begin() + 2, A.shape().end(), B.shape().begin() + 2, B.shape().end()))
+		{
+			throw std::invalid_argument("Batch dimensions of both operands must match");
+		}
+
+		shape_t resultShape = batched.shape();
+		resultShape[0] = m;
+		resultShape[1] = n;
+		array<double> result(resultShape);
+		size_t batch = batched.N() / (batched.shape()[0] * batched.shape()[1]);
+
+		if (A.dims() == 2)
+		{
+			// B_1..B_batch side by side are one k x (n * batch) matrix, so this is a single GEMM
+			gemm_batch(false, false, m, n * batch, k, A.data(), m, 0, B.data(), k, 0, result.data(), m, 0, 1);
+		}
+		else
+		{
+			gemm_batch(false, false, m, n, k, A.data(), m, m * k, B.data(), k, (B.dims() > 2) ? k * n : 0, result.data(), m, m * n, batch);
+		}
+
+		return result;
+	}
+
+
+
+	/*
+	* CONTRACTIONS
+	*/
+
+	inline bool _is_identity(const std::vector<size_t>& order)
+	{
+		for (size_t n = 0; n < order.size(); ++n)
+		{
+			if (order[n] != n) { return false; }
+		}
+		return true;
+	}
+
+	inline std::vector<size_t> _joined(std::vector<size_t> a, const std::vector<size_t>& b, const std::vector<size_t>& c = {})
+	{
+		a.insert(a.end(), b.begin(), b.end());
+		a.insert(a.end(), c.begin(), c.end());
+		return a;
+	}
+
+	inline size_t _product_of(const shape_t& shape, const std::vector<size_t>& axes)
+	{
+		size_t result = 1;
+		for (auto axis : axes) { result *= shape[axis]; }
+		return result;
+	}
+
+	/*
+	* Operand of a GEMM whose dimensions have to be in `order` (rows first) or, transposed, in
+	* `transposedOrder`. If the array already is in either layout it is used in place, otherwise it
+	* is permuted once.
+	*/
+	struct _gemm_operand
+	{
+		array<double> permuted;
+		const double* data;
+		bool transposed;
+
+		_gemm_operand(const array<double>& X, const std::vector<size_t>& order, const std::vector<size_t>& transposedOrder)
+			: permuted(),
+			data(X.data()),
+			transposed(false)
+		{
+			if (_is_identity(order)) { return; }
+			if (_is_identity(transposedOrder))
+			{
+				transposed = true;
+				return;
+			}
+
+			permuted = X.permute(order);
+			data = permuted.data();
+		}
+	};
+
+	/*
+	* Batched contraction of A and B: for every batch index (the same `batchA` / `batchB` dimensions
+	* of both operands), sums over the paired `contractA` / `contractB` dimensions. The result holds
+	* the free dimensions of A, then those of B, then the batch dimensions.
+	*/
+	inline array<double> _contract(const array<double>& A, const array<double>& B,
+		const std::vector<size_t>& contractA, const std::vector<size_t>& contractB,
+		const std::vector<size_t>& batchA, const std::vector<size_t>& batchB)
+	{
+		auto freeOf = [](size_t rank, const std::vector<size_t>& contracted, const std::vector<size_t>& batch)
+			{
+				std::vector<size_t> free;
+				for (size_t n = 0; n < rank; ++n)
+				{
+					if (std::find(contracted.begin(), contracted.end(), n) == contracted.end() && std::find(batch.begin(), batch.end(), n) == batch.end())
+					{
+						free.push_back(n);
+					}
+				}
+				return free;
+			};
+
+		std::vector<size_t> freeA = freeOf(A.dims(), contractA, batchA);
+		std::vector<size_t> freeB = freeOf(B.dims(), contractB, batchB);
+
+		for (size_t p = 0; p < contractA.size(); ++p)
+		{
+			if (A.shape()[contractA[p]] != B.shape()[contractB[p]]) { throw std::invalid_argument("Contracted dimensions must have the same size"); }
+		}
+		for (size_t p = 0; p < batchA.size(); ++p)
+		{
+			if (A.shape()[batchA[p]] != B.shape()[batchB[p]]) { throw std::invalid_argument("Batch dimensions must have the same size"); }
+		}
+
+		size_t m = _product_of(A.shape(), freeA);
+		size_t n = _product_of(B.shape(), freeB);
+		size_t k = _product_of(A.shape(), contractA);
+		size_t batch = _product_of(A.shape(), batchA);
+
+		_gemm_operand opA(A, _joined(freeA, contractA, batchA), _joined(contractA, freeA, batchA));
+		_gemm_operand opB(B, _joined(contractB, freeB, batchB), _joined(freeB, contractB, batchB));
+
+		shape_t resultShape;
+		for (auto axis : freeA) { resultShape.push_back(A.shape()[axis]); }
+		for (auto axis : freeB) { resultShape.push_back(B.shape()[axis]); }
+		for (auto axis : batchA) { resultShape.push_back(A.shape()[axis]); }
+		if (resultShape.empty()) { resultShape.push_back(1); }
+
+		array<double> result(resultShape);
+		gemm_batch(opA.transposed, opB.transposed, m, n, k,
+			opA.data, opA.transposed ? k : m, m * k,
+			opB.data, opB.transposed ? n : k, k * n,
+			result.data(), m, m * n, batch);
+
+		return result;
+	}
+
+	/*
+	* Sums the products of A and B over the dimensions axesA of A paired with axesB of B. The result has
+	* the remaining dimensions of A followed by those of B. When the contracted dimensions already are
+	* the leading or trailing dimensions of an operand it is passed to GEMM as is (transposed if leading),
+	* otherwise it is permuted once.
+	*/
+	inline array<double> tensordot(const array<double>& A, const array<double>& B, const std::vector<size_t>& axesA, const std::vector<size_t>& axesB)
+	{
+		if (axesA.size() != axesB.size()) { throw std::invalid_argument("Both operands need the same number of contracted dimensions"); }
+
+		auto validate = [](const array<double>& X, const std::vector<size_t>& axes)
+			{
+				std::vector<bool> seen(X.dims(), false);
+				for (auto axis : axes)
+				{
+					if (axis >= X.dims() || seen[axis]) { throw std::invalid_argument("Contracted dimensions must be distinct dimensions of the operand"); }
+					seen[axis] = true;
+				}
+			};
+		validate(A, axesA);
+		validate(B, axesB);
+
+		// Pairing order is free, ascending in A keeps A in place whenever its contracted dimensions are a block
+		std::vector<size_t> pairs(axesA.size());
+		std::iota(pairs.begin(), pairs.end(), 0);
+		std::sort(pairs.begin(), pairs.end(), [&](size_t a, size_t b) { return axesA[a] < axesA[b]; });
+
+		std::vector<size_t> contractA, contractB;
+		for (auto p : pairs)
+		{
+			contractA.push_back(axesA[p]);
+			contractB.push_back(axesB[p]);
+		}
+
+		return _contract(A, B, contractA, contractB, {}, {});
+	}
+
+	inline array<double> tensordot(const array<double>& A, const array<double>& B, size_t nAxes = 1)
+	{
+		if (nAxes > A.dims() || nAxes > B.dims()) { throw std::invalid_argument("Cannot contract more dimensions than an operand has"); }
+
+		// The last nAxes dimensions of A with the first nAxes of B, like numpy.tensordot
+		std::vector<size_t> axesA(nAxes), axesB(nAxes);
+		for (size_t p = 0; p < nAxes; ++p)
+		{
+			axesA[p] = A.dims() - nAxes + p;
+			axesB[p] = p;
+		}
+		return tensordot(A, B, axesA, axesB);
+	}
+
+	struct _einsum_spec
+	{
+		std::vector<std::string> inputs;
+		std::string output;
+	};
+
+	inline _einsum_spec _parse_einsum(const std::string& spec, size_t nOperands)
+	{
+		size_t arrow = spec.find("->");
+		if (arrow == std::string::npos) { throw std::invalid_argument("einsum needs an explicit output, e.g. \"ij,jk->ik\""); }
+
+		_einsum_spec result;
+		std::string inputs = spec.substr(0, arrow);
+		result.output = spec.substr(arrow + 2);
+
+		size_t start = 0;
+		while (true)
+		{
+			size_t comma = inputs.find(',', start);
+			result.inputs.push_back(inputs.substr(start, comma - start));
+			if (comma == std::string::npos) { break; }
+			start = comma + 1;
+		}
+		if (result.inputs.size() != nOperands) { throw std::invalid_argument("einsum expression does not match the number of operands"); }
+
+		auto checkUnique = [](const std::string& labels)
+			{
+				for (size_t i = 0; i < labels.size(); ++i)
+				{
+					if (labels.find(labels[i], i + 1) != std::string::npos) { throw std::invalid_argument("Repeated indices within an operand are not supported"); }
+				}
+			};
+		for (auto& labels : result.inputs) { checkUnique(labels); }
+		checkUnique(result.output);
+
+		for (char label : result.output)
+		{
+			bool found = false;
+			for (auto& labels : result.inputs) { found = found || labels.find(label) != std::string::npos; }
+			if (!found) { throw std::invalid_argument(std::string("Output index ") + label + " does not appear in any operand"); }
+		}
+
+		return result;
+	}
+
+	/*
+	* Sums X over the dimensions whose labels are not in `keep` into `result` and drops them from the
+	* labels. Returns false, leaving `result` alone, if there is nothing to sum.
+	*/
+	inline bool _sum_out(const array<double>& X, std::string& labels, const std::string& keep, array<double>& result)
+	{
+		if (labels.size() != X.dims()) { throw std::invalid_argument("einsum operand " + labels + " does not match the dimensions of its array"); }
+
+		std::vector<size_t> axes;
+		std::string kept;
+		shape_t keptShape;
+		for (size_t n = 0; n < labels.size(); ++n)
+		{
+			if (keep.find(labels[n]) == std::string::npos) { axes.push_back(n); }
+			else
+			{
+				kept.push_back(labels[n]);
+				keptShape.push_back(X.shape()[n]);
+			}
+		}
+		if (axes.empty()) { return false; }
+
+		result = X.sum(axes);
+		labels = kept;
+		if (keptShape.empty()) { keptShape.push_back(1); }
+		result.reshape(keptShape);
+		return true;
+	}
+
+	inline array<double> _to_output(const array<double>& result, const std::string& labels, const std::string& output)
+	{
+		if (output.empty()) { return result; }
+
+		std::vector<size_t> order;
+		for (char label : output) { order.push_back(labels.find(label)); }
+		return _is_identity(order) ? result : result.permute(order);
+	}
+
+	/*
+	* Einstein summation over one operand with an explicit output, e.g. "ij->ji" or "ijk->k". Labels
+	* missing from the output are summed over.
+	*/
+	inline array<double> einsum(const std::string& spec, const array<double>& A)
+	{
+		_einsum_spec parsed = _parse_einsum(spec, 1);
+		std::string labels = parsed.inputs[0];
+
+		array<double> reduced;
+		const array<double>& X = _sum_out(A, labels, parsed.output, reduced) ? reduced : A;
+		return _to_output(X, labels, parsed.output);
+	}
+
+	/*
+	* Einstein summation over two operands with an explicit output, e.g. "ij,jk->ik", "bij,bjk->bik"
+	* or "i,j->ij". Indices in both operands and the output are batch dimensions, indices in both
+	* operands only are contracted, and indices in a single operand that are not in the output are
+	* summed over first. Everything runs as one batched GEMM, with each operand permuted at most once.
+	*/
+	inline array<double> einsum(const std::string& spec, const array<double>& A, const array<double>& B)
+	{
+		_einsum_spec parsed = _parse_einsum(spec, 2);
+		std::string labelsA = parsed.inputs[0], labelsB = parsed.inputs[1];
+
+		array<double> reducedA, reducedB;
+		const array<double>& X = _sum_out(A, labelsA, parsed.output + labelsB, reducedA) ? reducedA : A;
+		const array<double>& Y = _sum_out(B, labelsB, parsed.output + labelsA, reducedB) ? reducedB : B;
+
+		std::vector<size_t> contractA, contractB, batchA, batchB;
+		std::string freeLabels, batchLabels;
+		for (size_t n = 0; n < labelsA.size(); ++n)
+		{
+			size_t inB = labelsB.find(labelsA[n]);
+			if (inB == std::string::npos) { freeLabels.push_back(labelsA[n]); }
+			else if (parsed.output.find(labelsA[n]) == std::string::npos)
+			{
+				contractA.push_back(n);
+				contractB.push_back(inB);
+			}
+			else
+			{
+				batchA.push_back(n);
+				batchB.push_back(inB);
+				batchLabels.push_back(labelsA[n]);
+			}
+		}
+		for (char label : labelsB)
+		{
+			if (labelsA.find(label) == std::string::npos) { freeLabels.push_back(label); }
+		}
+
+		return _to_output(_contract(X, Y, contractA, contractB, batchA, batchB), freeLabels + batchLabels, parsed.output);
+	}
+}
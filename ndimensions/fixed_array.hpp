@@ -0,0 +1,204 @@
+#pragma once
+
+#include "array.hpp"
+
+#include <array>
+#include <utility>
+#include <concepts>
+
+namespace nd
+{
+	/*
+	* Array whose rank is known at compile time. Values live in a regular nd::array, so converting to
+	* and from the dynamic type is a move (or a copy), while shape and strides are std::arrays: element
+	* access unrolls into a dot product with the strides and slicing runs as nested loops with a
+	* contiguous innermost copy instead of stepping a runtime index.
+	*/
+	template <typename Ty, size_t Rank>
+	class fixed_array
+	{
+		static_assert(Rank >= 1, "Rank must be at least 1");
+
+	public:
+
+		typedef std::array<size_t, Rank> shape_type;
+		typedef std::array<range, Rank> range_type;
+
+		fixed_array()
+			: _array(),
+			_shape(),
+			_strides()
+		{
+		}
+
+		explicit fixed_array(const shape_type& shape)
+			: fixed_array(array<Ty>(shape_t(shape.begin(), shape.end())))
+		{
+		}
+
+		fixed_array(const shape_type& shape, const Ty& fillValue)
+			: fixed_array(array<Ty>(shape_t(shape.begin(), shape.end()), fillValue))
+		{
+		}
+
+		explicit fixed_array(const array<Ty>& other)
+			: fixed_array(array<Ty>(other))
+		{
+		}
+
+		explicit fixed_array(array<Ty>&& other)
+			: _array(std::move(other)),
+			_shape(),
+			_strides()
+		{
+			if (_array.dims() != Rank) { throw std::invalid_argument("Array does not have " + std::to_string(Rank) + " dimensions"); }
+
+			size_t strideProduct = 1;
+			for (size_t n = 0; n < Rank; ++n)
+			{
+				_shape[n] = _array.shape()[n];
+				_strides[n] = strideProduct;
+				strideProduct *= _shape[n];
+			}
+		}
+
+		inline static constexpr size_t dims() { return Rank; }
+
+		inline size_t N() const { return _array.N(); }
+
+		inline bool empty() const { return _array.empty(); }
+
+		inline const shape_type& shape() const { return _shape; }
+
+		inline size_t size(size_t dimension) const { return _shape[dimension]; }
+
+		inline Ty* data() { return _array.data(); }
+
+		inline const Ty* data() const { return _array.data(); }
+
+		inline Ty* begin() { return data(); }
+		inline Ty* end() { return data() + N(); }
+		inline const Ty* begin() const { return data(); }
+		inline const Ty* end() const { return data() + N(); }
+
+		// The values as a dynamic array, valid as long as this array is
+		inline const array<Ty>& dynamic() const { return _array; }
+
+		inline operator const array<Ty>&() const { return _array; }
+
+		// Hands the values over to a dynamic array, leaving this one empty
+		array<Ty> release()
+		{
+			_shape = {};
+			_strides = {};
+			return std::move(_array);
+		}
+
+
+
+		/*
+		* ELEMENT ACCESS
+		*/
+
+		template <std::integral... Idx> requires (sizeof...(Idx) == Rank)
+		inline Ty& operator()(Idx... ndIndex) { return data()[_offset_of(ndIndex...)]; }
+
+		template <std::integral... Idx> requires (sizeof...(Idx) == Rank)
+		inline Ty operator()(Idx... ndIndex) const { return data()[_offset_of(ndIndex...)]; }
+
+		inline Ty& operator()(const shape_type& ndIndex) { return data()[_offset_of_index(ndIndex, std::make_index_sequence<Rank>())]; }
+
+		inline Ty operator()(const shape_type& ndIndex) const { return data()[_offset_of_index(ndIndex, std::make_index_sequence<Rank>())]; }
+
+		template <std::integral... Idx> requires (sizeof...(Idx) == Rank)
+		Ty& at(Idx... ndIndex)
+		{
+			_throw_if_invalid({ static_cast<size_t>(ndIndex)... });
+			return (*this)(ndIndex...);
+		}
+
+		template <std::integral... Idx> requires (sizeof...(Idx) == Rank)
+		Ty at(Idx... ndIndex) const
+		{
+			_throw_if_invalid({ static_cast<size_t>(ndIndex)... });
+			return (*this)(ndIndex...);
+		}
+
+
+
+		/*
+		* SLICING
+		*/
+
+		fixed_array slice(const range_type& ndRange) const
+		{
+			shape_type sliceShape;
+			for (size_t n = 0; n < Rank; ++n)
+			{
+				if (ndRange[n].end > _shape[n]) { throw std::invalid_argument("Range is out of bounds at dimension " + std::to_string(n)); }
+				sliceShape[n] = ndRange[n].size();
+			}
+
+			fixed_array result(sliceShape);
+			Ty* dest = result.data();
+			_copy_slice<Rank - 1>(ndRange, data(), dest);
+			return result;
+		}
+
+	private:
+		array<Ty> _array;
+		shape_type _shape;
+		shape_type _strides;
+
+		template <std::integral... Idx>
+		inline size_t _offset_of(Idx... ndIndex) const
+		{
+			return _offset_of_index(shape_type{ static_cast<size_t>(ndIndex)... }, std::make_index_sequence<Rank>());
+		}
+
+		template <size_t... K>
+		inline size_t _offset_of_index(const shape_type& ndIndex, std::index_sequence<K...>) const
+		{
+			return ((ndIndex[K] * _strides[K]) + ...);
+		}
+
+		// Innermost dimension is contiguous, so unit-step ranges there are a plain copy
+		template <size_t Dim>
+		void _copy_slice(const range_type& ndRange, const Ty* src, Ty*& dest) const
+		{
+			const range& r = ndRange[Dim];
+			if constexpr (Dim == 0)
+			{
+				if (r.steps == 1)
+				{
+					dest = std::copy(src + r.start, src + r.end, dest);
+				}
+				else
+				{
+					for (size_t i = r.start; i < r.end; i += r.steps) { *dest++ = src[i]; }
+				}
+			}
+			else
+			{
+				for (size_t i = r.start; i < r.end; i += r.steps)
+				{
+					_copy_slice<Dim - 1>(ndRange, src + i * _strides[Dim], dest);
+				}
+			}
+		}
+
+		void _throw_if_invalid(const shape_type& ndIndex) const
+		{
+			for (size_t n = 0; n < Rank; ++n)
+			{
+				if (ndIndex[n] >= _shape[n]) { throw std::invalid_argument("Index exceeds bounds at dimension " + std::to_string(n)); }
+			}
+		}
+	};
+
+	template <typename Ty = double>
+	using fixed_vector = fixed_array<Ty, 1>;
+
+	template <typename Ty = double>
+	using fixed_matrix = fixed_array<Ty, 2>;
+}
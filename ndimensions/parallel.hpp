@@ -0,0 +1,191 @@
+#pragma once
+
+#include <mkl/mkl_service.h>
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <exception>
+#include <algorithm>
+
+namespace nd
+{
+	class thread_pool
+	{
+	public:
+
+		explicit thread_pool(size_t nThreads = std::thread::hardware_concurrency())
+			: _workers(),
+			_mutex(),
+			_jobReady(),
+			_jobDone(),
+			_job(nullptr),
+			_nTasks(0),
+			_nextTask(0),
+			_nBusy(0),
+			_generation(0),
+			_stopping(false),
+			_error()
+		{
+			nThreads = std::max<size_t>(nThreads, 1);
+			_workers.reserve(nThreads);
+			for (size_t i = 0; i < nThreads; ++i)
+			{
+				_workers.emplace_back([this]() { _work(); });
+			}
+		}
+
+		thread_pool(const thread_pool&) = delete;
+		thread_pool& operator=(const thread_pool&) = delete;
+
+		~thread_pool()
+		{
+			{
+				std::lock_guard<std::mutex> lock(_mutex);
+				_stopping = true;
+			}
+			_jobReady.notify_all();
+
+			for (auto& worker : _workers)
+			{
+				worker.join();
+			}
+		}
+
+		inline size_t size() const { return _workers.size(); }
+
+		/*
+		* Runs task(i) for every i in [0, nTasks) on the pool and blocks until all of them finish.
+		* Calls made from inside a pool task run inline so nested parallel loops cannot deadlock.
+		*/
+		void run(size_t nTasks, const std::function<void(size_t)>& task)
+		{
+			if (nTasks == 0) { return; }
+
+			if (nTasks == 1 || _inside_pool())
+			{
+				for (size_t i = 0; i < nTasks; ++i)
+				{
+					task(i);
+				}
+				return;
+			}
+
+			std::unique_lock<std::mutex> lock(_mutex);
+			_jobDone.wait(lock, [this]() { return _job == nullptr; });
+
+			_job = &task;
+			_nTasks = nTasks;
+			_nextTask = 0;
+			_nBusy = _workers.size();
+			_error = nullptr;
+			_generation++;
+			_jobReady.notify_all();
+
+			_jobDone.wait(lock, [this]() { return _nBusy == 0; });
+			_job = nullptr;
+			auto error = _error;
+			lock.unlock();
+			_jobDone.notify_all();
+
+			if (error) { std::rethrow_exception(error); }
+		}
+
+		static thread_pool& global()
+		{
+			static thread_pool pool;
+			return pool;
+		}
+
+	private:
+		std::vector<std::thread> _workers;
+		std::mutex _mutex;
+		std::condition_variable _jobReady;
+		std::condition_variable _jobDone;
+		const std::function<void(size_t)>* _job;
+		size_t _nTasks;
+		std::atomic<size_t> _nextTask;
+		size_t _nBusy;
+		size_t _generation;
+		bool _stopping;
+		std::exception_ptr _error;
+
+		static bool& _inside_pool()
+		{
+			thread_local bool inside = false;
+			return inside;
+		}
+
+		void _work()
+		{
+			// Workers already provide the parallelism, so BLAS calls made from them stay single-threaded
+			mkl_set_num_threads_local(1);
+			_inside_pool() = true;
+
+			size_t seenGeneration = 0;
+			while (true)
+			{
+				const std::function<void(size_t)>* job;
+				size_t nTasks;
+				{
+					std::unique_lock<std::mutex> lock(_mutex);
+					_jobReady.wait(lock, [&]() { return _stopping || _generation != seenGeneration; });
+					if (_stopping) { return; }
+
+					seenGeneration = _generation;
+					job = _job;
+					nTasks = _nTasks;
+				}
+
+				for (size_t i = _nextTask++; i < nTasks; i = _nextTask++)
+				{
+					try
+					{
+						(*job)(i);
+					}
+					catch (...)
+					{
+						std::lock_guard<std::mutex> lock(_mutex);
+						if (!_error) { _error = std::current_exception(); }
+					}
+				}
+
+				{
+					std::lock_guard<std::mutex> lock(_mutex);
+					_nBusy--;
+				}
+				_jobDone.notify_all();
+			}
+		}
+	};
+
+	/*
+	* Splits [begin, end) into contiguous chunks of at least `grain` items and calls fn(first, last)
+	* for each chunk on the shared pool. Small ranges run inline on the calling thread.
+	*/
+	template <class Fn>
+	void parallel_for(size_t begin, size_t end, Fn fn, size_t grain = 1)
+	{
+		if (end <= begin) { return; }
+
+		thread_pool& pool = thread_pool::global();
+		size_t n = end - begin;
+		size_t nChunks = std::min(pool.size(), (n + grain - 1) / std::max<size_t>(grain, 1));
+
+		if (nChunks <= 1)
+		{
+			fn(begin, end);
+			return;
+		}
+
+		pool.run(nChunks, [&](size_t c)
+			{
+				size_t first = begin + c * n / nChunks;
+				size_t last = begin + (c + 1) * n / nChunks;
+				fn(first, last);
+			});
+	}
+}
@@ -0,0 +1,311 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+#include <string>
+#include <map>
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <fstream>
+#include <ostream>
+#include <algorithm>
+#include <stdexcept>
+
+/*
+* Instrumentation of the array kernels and autograd ops. The ND_PROFILE_* macros placed in hot paths
+* expand to nothing unless ML_ENABLE_PROFILING is defined, so regular builds carry no overhead. In
+* profiling builds a scope costs one relaxed atomic load while the profiler is stopped, and two clock
+* reads plus an append to a per-thread buffer while it runs.
+*/
+#ifdef ML_ENABLE_PROFILING
+#define ND_PROFILE_CONCAT_IMPL(a, b) a##b
+#define ND_PROFILE_CONCAT(a, b) ND_PROFILE_CONCAT_IMPL(a, b)
+#define ND_PROFILE_SCOPE(category, name) ::nd::profiling::scope ND_PROFILE_CONCAT(_ndProfileScope, __LINE__)(category, name)
+#define ND_PROFILE_FLOPS(n) ::nd::profiling::add_flops(static_cast<double>(n))
+#define ND_PROFILE_ALLOC(bytes) ::nd::profiling::add_allocation(bytes)
+#else
+#define ND_PROFILE_SCOPE(category, name) ((void)0)
+#define ND_PROFILE_FLOPS(n) ((void)0)
+#define ND_PROFILE_ALLOC(bytes) ((void)0)
+#endif
+
+namespace nd::profiling
+{
+	// One timed scope, the counters include everything that ran inside it
+	struct event
+	{
+		const char* category;
+		const char* name;
+		int64_t startNs;
+		int64_t durationNs;
+		double flops;
+		size_t bytesAllocated;
+		size_t allocations;
+		uint32_t thread;
+	};
+
+	struct op_summary
+	{
+		std::string category;
+		std::string name;
+		size_t calls;
+		double totalMs;
+		double flops;
+		size_t bytesAllocated;
+		size_t allocations;
+	};
+
+	// Running totals of the calling thread, scopes report the difference between entry and exit
+	struct thread_counters
+	{
+		double flops = 0.0;
+		size_t bytesAllocated = 0;
+		size_t allocations = 0;
+	};
+
+	inline thread_counters& counters()
+	{
+		thread_local thread_counters local;
+		return local;
+	}
+
+	inline void add_flops(double n) { counters().flops += n; }
+
+	inline void add_allocation(size_t bytes)
+	{
+		thread_counters& local = counters();
+		local.bytesAllocated += bytes;
+		local.allocations++;
+	}
+
+	/*
+	* Collects events from every thread. Recording only happens between start() and stop(); the
+	* results can be read at any time and are kept until clear().
+	*/
+	class profiler
+	{
+	public:
+
+		static profiler& global()
+		{
+			static profiler instance;
+			return instance;
+		}
+
+		inline void start() { _active.store(true, std::memory_order_relaxed); }
+
+		inline void stop() { _active.store(false, std::memory_order_relaxed); }
+
+		inline bool active() const { return _active.load(std::memory_order_relaxed); }
+
+		void clear()
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			for (auto& buffer : _buffers)
+			{
+				std::lock_guard<std::mutex> bufferLock(buffer->mutex);
+				buffer->events.clear();
+			}
+		}
+
+		inline int64_t now_ns() const
+		{
+			return std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - _epoch).count();
+		}
+
+		void record(const event& e)
+		{
+			_thread_buffer& buffer = _local();
+			std::lock_guard<std::mutex> lock(buffer.mutex);
+			buffer.events.push_back(e);
+			buffer.events.back().thread = buffer.thread;
+		}
+
+		// Events of all threads ordered by start time
+		std::vector<event> events() const
+		{
+			std::vector<event> result;
+			{
+				std::lock_guard<std::mutex> lock(_mutex);
+				for (auto& buffer : _buffers)
+				{
+					std::lock_guard<std::mutex> bufferLock(buffer->mutex);
+					result.insert(result.end(), buffer->events.begin(), buffer->events.end());
+				}
+			}
+
+			std::sort(result.begin(), result.end(), [](const event& a, const event& b) { return a.startNs < b.startNs; });
+			return result;
+		}
+
+		// Totals per category and op, most expensive first
+		std::vector<op_summary> summary() const
+		{
+			std::map<std::pair<std::string, std::string>, op_summary> byOp;
+			for (const event& e : events())
+			{
+				auto [it, inserted] = byOp.try_emplace({ e.category, e.name }, op_summary{ e.category, e.name, 0, 0.0, 0.0, 0, 0 });
+				op_summary& op = it->second;
+				op.calls++;
+				op.totalMs += e.durationNs * 1e-6;
+				op.flops += e.flops;
+				op.bytesAllocated += e.bytesAllocated;
+				op.allocations += e.allocations;
+			}
+
+			std::vector<op_summary> result;
+			result.reserve(byOp.size());
+			for (auto& [key, op] : byOp)
+			{
+				result.push_back(op);
+			}
+			std::sort(result.begin(), result.end(), [](const op_summary& a, const op_summary& b) { return a.totalMs > b.totalMs; });
+			return result;
+		}
+
+		// Chrome trace-event JSON, viewable in chrome://tracing or Perfetto
+		void write_chrome_trace(std::ostream& out) const
+		{
+			out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+			bool first = true;
+			char number[64];
+			for (const event& e : events())
+			{
+				out << (first ? "\n" : ",\n");
+				first = false;
+
+				out << "{\"name\":\"";
+				_write_escaped(out, e.name);
+				out << "\",\"cat\":\"";
+				_write_escaped(out, e.category);
+				std::snprintf(number, sizeof(number), "%.3f", e.startNs * 1e-3);
+				out << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << e.thread << ",\"ts\":" << number;
+				std::snprintf(number, sizeof(number), "%.3f", e.durationNs * 1e-3);
+				out << ",\"dur\":" << number;
+				std::snprintf(number, sizeof(number), "%.17g", e.flops);
+				out << ",\"args\":{\"flops\":" << number << ",\"bytes\":" << e.bytesAllocated << ",\"allocations\":" << e.allocations << "}}";
+			}
+			out << "\n]}\n";
+		}
+
+		void write_chrome_trace(const std::string& filepath) const
+		{
+			std::ofstream file(filepath);
+			if (!file) { throw std::invalid_argument("Cannot open " + filepath + " for writing"); }
+			write_chrome_trace(file);
+		}
+
+		// Fixed-width table of summary(), times and counters are inclusive of nested ops
+		void write_summary(std::ostream& out) const
+		{
+			char line[256];
+			std::snprintf(line, sizeof(line), "%-10s %-24s %10s %12s %12s %10s %10s %12s %10s\n",
+				"category", "op", "calls", "total ms", "mean us", "GFLOP", "GFLOP/s", "MB alloc", "allocs");
+			out << line;
+
+			for (const op_summary& op : summary())
+			{
+				double gflop = op.flops * 1e-9;
+				double seconds = op.totalMs * 1e-3;
+				std::snprintf(line, sizeof(line), "%-10.10s %-24.24s %10zu %12.3f %12.3f %10.3f %10.3f %12.3f %10zu\n",
+					op.category.c_str(), op.name.c_str(), op.calls, op.totalMs, op.totalMs * 1e3 / op.calls,
+					gflop, (seconds > 0.0) ? gflop / seconds : 0.0, op.bytesAllocated / (1024.0 * 1024.0), op.allocations);
+				out << line;
+			}
+		}
+
+	private:
+
+		typedef std::chrono::steady_clock clock;
+
+		struct _thread_buffer
+		{
+			std::mutex mutex;
+			std::vector<event> events;
+			uint32_t thread = 0;
+		};
+
+		profiler()
+			: _mutex(),
+			_buffers(),
+			_active(false),
+			_epoch(clock::now())
+		{
+		}
+
+		mutable std::mutex _mutex;
+		std::vector<std::shared_ptr<_thread_buffer>> _buffers;
+		std::atomic<bool> _active;
+		clock::time_point _epoch;
+
+		// Registered on a thread's first event and kept after the thread exits, so its events survive
+		_thread_buffer& _local()
+		{
+			thread_local std::shared_ptr<_thread_buffer> local;
+			if (!local)
+			{
+				local = std::make_shared<_thread_buffer>();
+				std::lock_guard<std::mutex> lock(_mutex);
+				local->thread = static_cast<uint32_t>(_buffers.size());
+				_buffers.push_back(local);
+			}
+			return *local;
+		}
+
+		static void _write_escaped(std::ostream& out, const char* text)
+		{
+			for (const char* c = text; *c != '\0'; ++c)
+			{
+				if (*c == '"' || *c == '\\') { out << '\\'; }
+				out << *c;
+			}
+		}
+	};
+
+	/*
+	* Times its own lifetime and records it with the global profiler, along with the FLOPs and
+	* allocations counted on this thread in the meantime. Does nothing while the profiler is stopped.
+	*/
+	class scope
+	{
+	public:
+
+		scope(const char* category, const char* name)
+			: _category(category),
+			_name(name),
+			_active(profiler::global().active()),
+			_start(0),
+			_entry()
+		{
+			if (_active)
+			{
+				_entry = counters();
+				_start = profiler::global().now_ns();
+			}
+		}
+
+		scope(const scope&) = delete;
+		scope& operator=(const scope&) = delete;
+
+		~scope()
+		{
+			if (!_active) { return; }
+
+			profiler& p = profiler::global();
+			int64_t end = p.now_ns();
+			const thread_counters& exit = counters();
+			p.record({ _category, _name, _start, end - _start, exit.flops - _entry.flops,
+				exit.bytesAllocated - _entry.bytesAllocated, exit.allocations - _entry.allocations, 0 });
+		}
+
+	private:
+		const char* _category;
+		const char* _name;
+		bool _active;
+		int64_t _start;
+		thread_counters _entry;
+	};
+}
@@ -0,0 +1,146 @@
+#pragma once
+
+#include "parallel.hpp"
+
+#include <cstdint>
+#include <cmath>
+#include <array>
+#include <atomic>
+#include <numbers>
+
+namespace nd
+{
+	/*
+	* Philox4x32-10 (Salmon et al., "Parallel random numbers: as easy as 1, 2, 3"). A counter-based
+	* generator: block(counter, key) is a pure function, so any element of a stream can be computed
+	* independently of the others.
+	*/
+	struct philox
+	{
+		typedef std::array<uint32_t, 4> block_t;
+
+		static block_t block(uint64_t counter, uint64_t key, uint64_t counterHigh = 0)
+		{
+			block_t c = {
+				static_cast<uint32_t>(counter), static_cast<uint32_t>(counter >> 32),
+				static_cast<uint32_t>(counterHigh), static_cast<uint32_t>(counterHigh >> 32)
+			};
+			uint32_t k0 = static_cast<uint32_t>(key);
+			uint32_t k1 = static_cast<uint32_t>(key >> 32);
+
+			for (int round = 0; round < 10; ++round)
+			{
+				uint64_t p0 = uint64_t(0xD2511F53) * c[0];
+				uint64_t p1 = uint64_t(0xCD9E8D57) * c[2];
+				c = {
+					static_cast<uint32_t>(p1 >> 32) ^ c[1] ^ k0, static_cast<uint32_t>(p1),
+					static_cast<uint32_t>(p0 >> 32) ^ c[3] ^ k1, static_cast<uint32_t>(p0)
+				};
+				k0 += 0x9E3779B9;
+				k1 += 0xBB67AE85;
+			}
+			return c;
+		}
+	};
+
+	/*
+	* Seeded source of random arrays. Every fill reserves a fresh range of Philox counters and element
+	* i of the fill is computed from counter (start + i / 2) alone, so the fill runs on the thread pool
+	* and gives the same values however many threads there are. Fills may run concurrently; seed()
+	* must not race with them.
+	*/
+	class random_generator
+	{
+	public:
+
+		explicit random_generator(uint64_t seed = 0)
+			: _key(seed),
+			_nextCounter(0)
+		{
+		}
+
+		// Restarts the generator, so the same sequence of fills repeats the same values
+		void seed(uint64_t seed)
+		{
+			_key = seed;
+			_nextCounter = 0;
+		}
+
+		inline uint64_t seed() const { return _key; }
+
+		// Uniform on [low, high)
+		template <typename Ty>
+		void uniform(Ty* out, size_t n, Ty low = 0, Ty high = 1)
+		{
+			double scale = static_cast<double>(high) - static_cast<double>(low);
+			_fill(out, n, [low, scale](const philox::block_t& b, Ty& x, Ty& y)
+				{
+					x = static_cast<Ty>(low + scale * _to_unit(b[0], b[1]));
+					y = static_cast<Ty>(low + scale * _to_unit(b[2], b[3]));
+				});
+		}
+
+		// Box-Muller, each counter gives a pair of independent normals
+		template <typename Ty>
+		void normal(Ty* out, size_t n, Ty mean = 0, Ty stddev = 1)
+		{
+			_fill(out, n, [mean, stddev](const philox::block_t& b, Ty& x, Ty& y)
+				{
+					double radius = std::sqrt(-2.0 * std::log(1.0 - _to_unit(b[0], b[1])));
+					double angle = 2.0 * std::numbers::pi * _to_unit(b[2], b[3]);
+					x = static_cast<Ty>(mean + stddev * radius * std::cos(angle));
+					y = static_cast<Ty>(mean + stddev * radius * std::sin(angle));
+				});
+		}
+
+		// 1 with probability p and 0 otherwise, e.g. dropout masks
+		template <typename Ty>
+		void bernoulli(Ty* out, size_t n, double p)
+		{
+			_fill(out, n, [p](const philox::block_t& b, Ty& x, Ty& y)
+				{
+					x = (_to_unit(b[0], b[1]) < p) ? Ty(1) : Ty(0);
+					y = (_to_unit(b[2], b[3]) < p) ? Ty(1) : Ty(0);
+				});
+		}
+
+	private:
+		uint64_t _key;
+		std::atomic<uint64_t> _nextCounter;
+
+		// 53 random bits to a double in [0, 1)
+		static inline double _to_unit(uint32_t high, uint32_t low)
+		{
+			return static_cast<double>(((uint64_t(high) << 32) | low) >> 11) * 0x1.0p-53;
+		}
+
+		// pairFn(block, x, y) turns one Philox block into two consecutive values
+		template <typename Ty, class PairFn>
+		void _fill(Ty* out, size_t n, PairFn pairFn)
+		{
+			size_t nPairs = (n + 1) / 2;
+			uint64_t first = _nextCounter.fetch_add(nPairs);
+			uint64_t key = _key;
+
+			parallel_for(0, nPairs, [&](size_t begin, size_t end)
+				{
+					for (size_t j = begin; j < end; ++j)
+					{
+						Ty x, y;
+						pairFn(philox::block(first + j, key), x, y);
+						out[2 * j] = x;
+						if (2 * j + 1 < n) { out[2 * j + 1] = y; }
+					}
+				}, 4096);
+		}
+	};
+
+	// Generator behind array::random and friends when none is passed
+	inline random_generator& default_generator()
+	{
+		static random_generator generator;
+		return generator;
+	}
+
+	inline void seed(uint64_t seed) { default_generator().seed(seed); }
+}
@@ -0,0 +1,267 @@
+#pragma once
+
+#include "utils.hpp"
+#include "parallel.hpp"
+
+#include <vector>
+#include <limits>
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+namespace nd
+{
+	enum class reduction
+	{
+		sum,
+		mean,
+		min,
+		max,
+		argmin,
+		argmax,
+		variance
+	};
+
+	// Shape of reducing `shape` along `axes`, reduced dimensions are kept with size 1
+	inline shape_t reduced_shape(const shape_t& shape, const std::vector<size_t>& axes)
+	{
+		shape_t result(shape);
+		for (auto axis : axes)
+		{
+			if (axis >= shape.size()) { throw std::invalid_argument("Cannot reduce along dimension " + std::to_string(axis)); }
+			result[axis] = 1;
+		}
+		return result;
+	}
+
+	/*
+	* Reduces the column-major `values` of `shape` along `axes` into `out`, which holds
+	* reduced_shape(shape, axes) items. Adjacent dimensions that are both reduced or both kept are
+	* merged, and the input is read once in memory order: the innermost run is either accumulated into
+	* one output (reduced) or elementwise into a contiguous row of outputs (kept), both of which are
+	* plain vectorizable loops. The outermost kept run is split across the thread pool, so every thread
+	* owns a disjoint part of the output. Variance uses Welford's update, combining whole runs with
+	* Chan's formula, and is the population variance like array::variance(). argmin and argmax give
+	* the position within the reduced dimensions, counted in column-major order.
+	*/
+	template <typename Ty>
+	void reduce(const Ty* values, const shape_t& shape, const std::vector<size_t>& axes, reduction op, Ty* out)
+	{
+		std::vector<bool> isReduced(shape.size(), false);
+		for (auto axis : axes)
+		{
+			if (axis >= shape.size()) { throw std::invalid_argument("Cannot reduce along dimension " + std::to_string(axis)); }
+			isReduced[axis] = true;
+		}
+
+		// Merge dimensions into runs {size, reduced}, dimensions of size 1 do not affect the traversal
+		struct run { size_t size; bool reduced; size_t inStride; size_t outStride; };
+		std::vector<run> runs;
+		size_t nItems = 1, nOut = 1, nReduced = 1;
+		for (size_t d = 0; d < shape.size(); ++d)
+		{
+			nItems *= shape[d];
+			(isReduced[d] ? nReduced : nOut) *= shape[d];
+			if (shape[d] == 1) { continue; }
+
+			if (!runs.empty() && runs.back().reduced == isReduced[d]) { runs.back().size *= shape[d]; }
+			else { runs.push_back({ shape[d], isReduced[d], 0, 0 }); }
+		}
+
+		if (nItems == 0)
+		{
+			bool needsItems = op == reduction::min || op == reduction::max || op == reduction::argmin || op == reduction::argmax;
+			if (needsItems && nOut > 0) { throw std::invalid_argument("Cannot reduce an empty dimension"); }
+
+			std::fill(out, out + nOut, (op == reduction::sum) ? Ty(0) : std::numeric_limits<Ty>::quiet_NaN());
+			return;
+		}
+		if (runs.empty()) { runs.push_back({ 1, false, 0, 0 }); }
+
+		size_t inStride = 1, outStride = 1;
+		for (auto& r : runs)
+		{
+			r.inStride = inStride;
+			r.outStride = r.reduced ? 0 : outStride;
+			inStride *= r.size;
+			if (!r.reduced) { outStride *= r.size; }
+		}
+
+		// Per-output state beyond the output itself
+		std::vector<size_t> counts;
+		std::vector<Ty> best;
+		std::vector<double> means, m2;
+		switch (op)
+		{
+		case reduction::sum:
+		case reduction::mean:
+			std::fill(out, out + nOut, Ty(0));
+			break;
+		case reduction::min:
+			std::fill(out, out + nOut, std::numeric_limits<Ty>::max());
+			break;
+		case reduction::max:
+			std::fill(out, out + nOut, std::numeric_limits<Ty>::lowest());
+			break;
+		case reduction::argmin:
+		case reduction::argmax:
+			std::fill(out, out + nOut, Ty(0));
+			best.assign(nOut, (op == reduction::argmin) ? std::numeric_limits<Ty>::max() : std::numeric_limits<Ty>::lowest());
+			counts.assign(nOut, 0);
+			break;
+		case reduction::variance:
+			means.assign(nOut, 0.0);
+			m2.assign(nOut, 0.0);
+			counts.assign(nOut, 0);
+			break;
+		}
+
+		// Innermost run starting at `in`, written to the output at `o` (stride 1 if kept, 0 if reduced)
+		auto inner = [&](const Ty* in, size_t n, size_t o, bool reduced)
+			{
+				switch (op)
+				{
+				case reduction::sum:
+				case reduction::mean:
+					if (reduced)
+					{
+						Ty s{};
+						for (size_t i = 0; i < n; ++i) { s += in[i]; }
+						out[o] += s;
+					}
+					else
+					{
+						Ty* dest = out + o;
+						for (size_t i = 0; i < n; ++i) { dest[i] += in[i]; }
+					}
+					break;
+				case reduction::min:
+					if (reduced) { out[o] = std::min(out[o], *std::min_element(in, in + n)); }
+					else
+					{
+						Ty* dest = out + o;
+						for (size_t i = 0; i < n; ++i) { dest[i] = (in[i] < dest[i]) ? in[i] : dest[i]; }
+					}
+					break;
+				case reduction::max:
+					if (reduced) { out[o] = std::max(out[o], *std::max_element(in, in + n)); }
+					else
+					{
+						Ty* dest = out + o;
+						for (size_t i = 0; i < n; ++i) { dest[i] = (in[i] > dest[i]) ? in[i] : dest[i]; }
+					}
+					break;
+				case reduction::argmin:
+				case reduction::argmax:
+				{
+					bool isMax = op == reduction::argmax;
+					auto better = [isMax](Ty a, Ty b) { return isMax ? a > b : a < b; };
+					if (reduced)
+					{
+						for (size_t i = 0; i < n; ++i)
+						{
+							if (better(in[i], best[o])) { best[o] = in[i]; out[o] = static_cast<Ty>(counts[o] + i); }
+						}
+						counts[o] += n;
+					}
+					else
+					{
+						for (size_t i = 0; i < n; ++i)
+						{
+							if (better(in[i], best[o + i])) { best[o + i] = in[i]; out[o + i] = static_cast<Ty>(counts[o + i]); }
+							counts[o + i]++;
+						}
+					}
+					break;
+				}
+				case reduction::variance:
+					if (reduced)
+					{
+						double runMean = 0.0, runM2 = 0.0;
+						for (size_t i = 0; i < n; ++i)
+						{
+							double delta = in[i] - runMean;
+							runMean += delta / (i + 1);
+							runM2 += delta * (in[i] - runMean);
+						}
+
+						double nA = static_cast<double>(counts[o]), nB = static_cast<double>(n), nAB = nA + nB;
+						double delta = runMean - means[o];
+						means[o] += delta * nB / nAB;
+						m2[o] += runM2 + delta * delta * nA * nB / nAB;
+						counts[o] += n;
+					}
+					else
+					{
+						// Every output in a kept run has seen the same number of items
+						double count = static_cast<double>(++counts[o]);
+						for (size_t i = 0; i < n; ++i)
+						{
+							double delta = in[i] - means[o + i];
+							means[o + i] += delta / count;
+							m2[o + i] += delta * (in[i] - means[o + i]);
+						}
+						for (size_t i = 1; i < n; ++i) { counts[o + i]++; }
+					}
+					break;
+				}
+			};
+
+		// Runs the whole traversal with run `p` restricted to [first, last)
+		auto traverse = [&](size_t p, size_t first, size_t last)
+			{
+				size_t nRuns = runs.size();
+				std::vector<size_t> lo(nRuns, 0), hi(nRuns), idx(nRuns, 0);
+				for (size_t r = 0; r < nRuns; ++r) { hi[r] = runs[r].size; }
+				lo[p] = first;
+				hi[p] = last;
+				idx = lo;
+
+				while (true)
+				{
+					size_t inOffset = 0, outOffset = 0;
+					for (size_t r = 1; r < nRuns; ++r)
+					{
+						inOffset += idx[r] * runs[r].inStride;
+						outOffset += idx[r] * runs[r].outStride;
+					}
+					inner(values + inOffset + lo[0], hi[0] - lo[0], outOffset + lo[0] * runs[0].outStride, runs[0].reduced);
+
+					size_t r = 1;
+					for (; r < nRuns; ++r)
+					{
+						if (++idx[r] < hi[r]) { break; }
+						idx[r] = lo[r];
+					}
+					if (r >= nRuns) { break; }
+				}
+			};
+
+		// Split the outermost kept run across threads, full reductions run on the calling thread
+		size_t p = runs.size();
+		for (size_t r = runs.size(); r-- > 0;)
+		{
+			if (!runs[r].reduced) { p = r; break; }
+		}
+
+		if (p == runs.size())
+		{
+			traverse(0, 0, runs[0].size);
+		}
+		else
+		{
+			size_t itemsPerIndex = nItems / runs[p].size;
+			size_t grain = std::max<size_t>(1, 32768 / std::max<size_t>(itemsPerIndex, 1));
+			parallel_for(0, runs[p].size, [&](size_t first, size_t last) { traverse(p, first, last); }, grain);
+		}
+
+		if (op == reduction::mean)
+		{
+			for (size_t i = 0; i < nOut; ++i) { out[i] /= static_cast<Ty>(nReduced); }
+		}
+		else if (op == reduction::variance)
+		{
+			for (size_t i = 0; i < nOut; ++i) { out[i] = static_cast<Ty>(m2[i] / static_cast<double>(nReduced)); }
+		}
+	}
+}
@@ -0,0 +1,190 @@
+#pragma once
+
+#include <cstddef>
+#include <algorithm>
+#include <initializer_list>
+#include <iterator>
+#include <memory>
+#include <utility>
+
+namespace nd
+{
+	/*
+	* Vector that stores up to `Capacity` items inline, used for shapes, strides and indices so that
+	* creating arrays and indexing into them does not touch the heap for the usual ranks. Growing past
+	* the inline capacity moves the items to a heap buffer. The interface is the subset of std::vector
+	* the library relies on.
+	*/
+	template <typename T, size_t Capacity>
+	class small_vector
+	{
+	public:
+
+		typedef T value_type;
+		typedef size_t size_type;
+		typedef T& reference;
+		typedef const T& const_reference;
+		typedef T* iterator;
+		typedef const T* const_iterator;
+
+		small_vector()
+			: _size(0),
+			_capacity(Capacity),
+			_heap(),
+			_items(_inline),
+			_inline()
+		{
+		}
+
+		explicit small_vector(size_t n, const T& value = T())
+			: small_vector()
+		{
+			resize(n, value);
+		}
+
+		small_vector(std::initializer_list<T> items)
+			: small_vector(items.begin(), items.end())
+		{
+		}
+
+		template <std::input_iterator It>
+		small_vector(It first, It last)
+			: small_vector()
+		{
+			for (; first != last; ++first)
+			{
+				push_back(*first);
+			}
+		}
+
+		small_vector(const small_vector& other)
+			: small_vector()
+		{
+			reserve(other._size);
+			std::copy(other.begin(), other.end(), _items);
+			_size = other._size;
+		}
+
+		small_vector(small_vector&& other) noexcept
+			: small_vector()
+		{
+			_take(std::move(other));
+		}
+
+		small_vector& operator=(const small_vector& other)
+		{
+			if (this != &other)
+			{
+				_size = 0;
+				reserve(other._size);
+				std::copy(other.begin(), other.end(), _items);
+				_size = other._size;
+			}
+			return *this;
+		}
+
+		small_vector& operator=(small_vector&& other) noexcept
+		{
+			if (this != &other)
+			{
+				_heap.reset();
+				_items = _inline;
+				_capacity = Capacity;
+				_take(std::move(other));
+			}
+			return *this;
+		}
+
+		inline size_t size() const { return _size; }
+
+		inline bool empty() const { return _size == 0; }
+
+		inline size_t capacity() const { return _capacity; }
+
+		// Whether the items live in the inline buffer
+		inline bool is_inline() const { return _items == _inline; }
+
+		inline T* data() { return _items; }
+		inline const T* data() const { return _items; }
+
+		inline iterator begin() { return _items; }
+		inline iterator end() { return _items + _size; }
+		inline const_iterator begin() const { return _items; }
+		inline const_iterator end() const { return _items + _size; }
+
+		inline T& operator[](size_t i) { return _items[i]; }
+		inline const T& operator[](size_t i) const { return _items[i]; }
+
+		inline T& front() { return _items[0]; }
+		inline const T& front() const { return _items[0]; }
+
+		inline T& back() { return _items[_size - 1]; }
+		inline const T& back() const { return _items[_size - 1]; }
+
+		void push_back(const T& value)
+		{
+			if (_size == _capacity)
+			{
+				// `value` may refer to an item of this vector, which reserve() moves
+				T copy = value;
+				reserve(2 * _capacity);
+				_items[_size++] = std::move(copy);
+				return;
+			}
+			_items[_size++] = value;
+		}
+
+		inline void pop_back() { _size--; }
+
+		void reserve(size_t n)
+		{
+			if (n <= _capacity) { return; }
+
+			std::unique_ptr<T[]> grown(new T[n]);
+			std::move(_items, _items + _size, grown.get());
+			_heap = std::move(grown);
+			_items = _heap.get();
+			_capacity = n;
+		}
+
+		void resize(size_t n, const T& value = T())
+		{
+			if (n > _capacity) { reserve(std::max(n, 2 * _capacity)); }
+			if (n > _size) { std::fill(_items + _size, _items + n, value); }
+			_size = n;
+		}
+
+		inline void clear() { _size = 0; }
+
+		friend bool operator==(const small_vector& a, const small_vector& b)
+		{
+			return std::equal(a.begin(), a.end(), b.begin(), b.end());
+		}
+
+	private:
+		size_t _size;
+		size_t _capacity;
+		std::unique_ptr<T[]> _heap;
+		T* _items;
+		T _inline[Capacity];
+
+		// Steals a heap buffer or copies inline items, expects this vector to be inline
+		void _take(small_vector&& other)
+		{
+			if (other.is_inline())
+			{
+				std::move(other.begin(), other.end(), _inline);
+			}
+			else
+			{
+				_heap = std::move(other._heap);
+				_items = _heap.get();
+				_capacity = other._capacity;
+				other._items = other._inline;
+				other._capacity = Capacity;
+			}
+			_size = other._size;
+			other._size = 0;
+		}
+	};
+}
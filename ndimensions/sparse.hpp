@@ -0,0 +1,331 @@
+#pragma once
+
+#include "array.hpp"
+
+#include <mkl/mkl_spblas.h>
+
+#include <vector>
+#include <memory>
+#include <numeric>
+#include <stdexcept>
+#include <span>
+#include <type_traits>
+
+namespace nd
+{
+	enum class sparse_format
+	{
+		csr,
+		csc
+	};
+
+	/*
+	* Immutable compressed sparse matrix in CSR (rows compressed) or CSC (columns compressed) format
+	* with zero-based indices. The index and value buffers are shared between copies, so passing a
+	* sparse_array by value or capturing it in an autograd node does not copy the non-zeros.
+	*/
+	template <typename Ty = double>
+	class sparse_array
+	{
+	public:
+
+		/*
+		* TYPDEFS
+		*/
+
+		using sparse_t = sparse_array<Ty>;
+		using ndarray_t = array<Ty>;
+		using index_type = MKL_INT;
+
+
+
+		/*
+		* CTORS
+		*/
+
+		sparse_array()
+			: _format(sparse_format::csr),
+			_shape({ 0, 0 }),
+			_data(std::make_shared<_storage>(_storage{ { 0 }, {}, {} }))
+		{
+		}
+
+		/*
+		* `pointers` holds major + 1 offsets into `indices` and `values`, where major is the number of rows
+		* for CSR and of columns for CSC. `indices` holds the minor index of every non-zero.
+		*/
+		sparse_array(const shape_t& shape, sparse_format format, std::vector<index_type> pointers, std::vector<index_type> indices, std::vector<Ty> values)
+			: _format(format),
+			_shape(shape),
+			_data()
+		{
+			if (shape.size() != 2) { throw std::invalid_argument("Sparse arrays must have 2 dimensions"); }
+			if (pointers.size() != _major() + 1 || pointers.front() != 0) { throw std::invalid_argument("Sparse pointers do not match the shape"); }
+			if (indices.size() != values.size() || static_cast<size_t>(pointers.back()) != values.size()) { throw std::invalid_argument("Sparse indices and values do not match the pointers"); }
+
+			for (size_t p = 0; p < _major(); ++p)
+			{
+				if (pointers[p + 1] < pointers[p]) { throw std::invalid_argument("Sparse pointers must be non-decreasing"); }
+			}
+			for (auto i : indices)
+			{
+				if (i < 0 || static_cast<size_t>(i) >= _minor()) { throw std::invalid_argument("Sparse index is out of bounds"); }
+			}
+
+			_data = std::make_shared<_storage>(_storage{ std::move(pointers), std::move(indices), std::move(values) });
+		}
+
+		static sparse_t from_dense(const ndarray_t& dense, sparse_format format = sparse_format::csr)
+		{
+			if (!dense.matrix()) { throw std::invalid_argument("Only matrices can be converted to sparse arrays"); }
+
+			size_t nRows = dense.shape()[0];
+			size_t nCols = dense.shape()[1];
+			const Ty* px = dense.data();
+
+			std::vector<index_type> pointers((format == sparse_format::csr ? nRows : nCols) + 1, 0);
+			std::vector<index_type> indices;
+			std::vector<Ty> values;
+
+			if (format == sparse_format::csc)
+			{
+				// Columns are contiguous in the dense array, so CSC is a single pass
+				for (size_t j = 0; j < nCols; ++j)
+				{
+					for (size_t i = 0; i < nRows; ++i)
+					{
+						if (px[j * nRows + i] != Ty(0))
+						{
+							indices.push_back(static_cast<index_type>(i));
+							values.push_back(px[j * nRows + i]);
+						}
+					}
+					pointers[j + 1] = static_cast<index_type>(values.size());
+				}
+			}
+			else
+			{
+				for (size_t j = 0; j < nCols; ++j)
+				{
+					for (size_t i = 0; i < nRows; ++i)
+					{
+						if (px[j * nRows + i] != Ty(0)) { pointers[i + 1]++; }
+					}
+				}
+				std::partial_sum(pointers.begin(), pointers.end(), pointers.begin());
+
+				indices.resize(pointers.back());
+				values.resize(pointers.back());
+				std::vector<index_type> next(pointers.begin(), pointers.end() - 1);
+				for (size_t j = 0; j < nCols; ++j)
+				{
+					for (size_t i = 0; i < nRows; ++i)
+					{
+						Ty x = px[j * nRows + i];
+						if (x != Ty(0))
+						{
+							indices[next[i]] = static_cast<index_type>(j);
+							values[next[i]] = x;
+							next[i]++;
+						}
+					}
+				}
+			}
+
+			return sparse_t({ nRows, nCols }, format, std::move(pointers), std::move(indices), std::move(values));
+		}
+
+		ndarray_t to_dense() const
+		{
+			size_t nRows = _shape[0];
+			ndarray_t dense(_shape, Ty(0));
+			Ty* px = dense.data();
+
+			for (size_t p = 0; p < _major(); ++p)
+			{
+				for (index_type n = _data->pointers[p]; n < _data->pointers[p + 1]; ++n)
+				{
+					size_t i = (_format == sparse_format::csr) ? p : _data->indices[n];
+					size_t j = (_format == sparse_format::csr) ? _data->indices[n] : p;
+					px[j * nRows + i] = _data->values[n];
+				}
+			}
+
+			return dense;
+		}
+
+
+
+		/*
+		* ARRAY PROPERTIES
+		*/
+
+		inline const shape_t& shape() const { return _shape; }
+
+		inline sparse_format format() const { return _format; }
+
+		inline size_t nnz() const { return _data->values.size(); }
+
+		inline double density() const
+		{
+			size_t n = _shape[0] * _shape[1];
+			return (n == 0) ? 0.0 : static_cast<double>(nnz()) / n;
+		}
+
+		inline bool empty() const { return _shape[0] == 0 || _shape[1] == 0; }
+
+		inline const std::vector<index_type>& pointers() const { return _data->pointers; }
+
+		inline const std::vector<index_type>& indices() const { return _data->indices; }
+
+		inline const std::vector<Ty>& values() const { return _data->values; }
+
+
+
+		/*
+		* TRANSFORMATIONS
+		*/
+
+		// The CSR buffers of A are the CSC buffers of A', so transposing only swaps the format and shape
+		sparse_t T() const
+		{
+			sparse_t result(*this);
+			result._format = (_format == sparse_format::csr) ? sparse_format::csc : sparse_format::csr;
+			result._shape = { _shape[1], _shape[0] };
+			return result;
+		}
+
+		sparse_t to_format(sparse_format format) const
+		{
+			if (format == _format) { return *this; }
+
+			// Converting between CSR and CSC is a transpose of the compressed structure
+			size_t newMajor = _minor();
+			std::vector<index_type> pointers(newMajor + 1, 0);
+			for (auto i : _data->indices) { pointers[i + 1]++; }
+			std::partial_sum(pointers.begin(), pointers.end(), pointers.begin());
+
+			std::vector<index_type> indices(nnz());
+			std::vector<Ty> values(nnz());
+			std::vector<index_type> next(pointers.begin(), pointers.end() - 1);
+			for (size_t p = 0; p < _major(); ++p)
+			{
+				for (index_type n = _data->pointers[p]; n < _data->pointers[p + 1]; ++n)
+				{
+					index_type dest = next[_data->indices[n]]++;
+					indices[dest] = static_cast<index_type>(p);
+					values[dest] = _data->values[n];
+				}
+			}
+
+			return sparse_t(_shape, format, std::move(pointers), std::move(indices), std::move(values));
+		}
+
+		// Gathers rows of a CSR array, e.g. a mini-batch of samples
+		sparse_t take(std::span<const size_t> rows) const
+		{
+			if (_format != sparse_format::csr) { return to_format(sparse_format::csr).take(rows); }
+
+			std::vector<index_type> pointers(rows.size() + 1, 0);
+			for (size_t k = 0; k < rows.size(); ++k)
+			{
+				if (rows[k] >= _shape[0]) { throw std::invalid_argument("Index to take is out of bounds"); }
+				pointers[k + 1] = pointers[k] + _data->pointers[rows[k] + 1] - _data->pointers[rows[k]];
+			}
+
+			std::vector<index_type> indices(pointers.back());
+			std::vector<Ty> values(pointers.back());
+			for (size_t k = 0; k < rows.size(); ++k)
+			{
+				auto first = _data->pointers[rows[k]];
+				auto last = _data->pointers[rows[k] + 1];
+				std::copy(_data->indices.begin() + first, _data->indices.begin() + last, indices.begin() + pointers[k]);
+				std::copy(_data->values.begin() + first, _data->values.begin() + last, values.begin() + pointers[k]);
+			}
+
+			return sparse_t({ rows.size(), _shape[1] }, sparse_format::csr, std::move(pointers), std::move(indices), std::move(values));
+		}
+
+
+
+		/*
+		* LINEAR ALGEBRA
+		*/
+
+		// A * B for a dense matrix or vector B
+		ndarray_t operator*(const ndarray_t& B) const
+		{
+			return _multiply(SPARSE_OPERATION_NON_TRANSPOSE, B);
+		}
+
+		// A' * B without materializing A', used for gradients of sparse products
+		ndarray_t transpose_multiply(const ndarray_t& B) const
+		{
+			return _multiply(SPARSE_OPERATION_TRANSPOSE, B);
+		}
+
+	private:
+
+		struct _storage
+		{
+			std::vector<index_type> pointers;
+			std::vector<index_type> indices;
+			std::vector<Ty> values;
+		};
+
+		sparse_format _format;
+		shape_t _shape;
+		std::shared_ptr<const _storage> _data;
+
+		inline size_t _major() const { return (_format == sparse_format::csr) ? _shape[0] : _shape[1]; }
+
+		inline size_t _minor() const { return (_format == sparse_format::csr) ? _shape[1] : _shape[0]; }
+
+		ndarray_t _multiply(sparse_operation_t operation, const ndarray_t& B) const
+		{
+			static_assert(std::is_same_v<Ty, double>, "Sparse products are only implemented for double");
+
+			bool transpose = operation != SPARSE_OPERATION_NON_TRANSPOSE;
+			size_t inner = transpose ? _shape[0] : _shape[1];
+			size_t outer = transpose ? _shape[1] : _shape[0];
+			size_t nCols = B.vector() ? 1 : B.shape()[1];
+
+			if (B.dims() > 2 || B.shape()[0] != inner) { throw std::invalid_argument("Shape of dense operand does not match the sparse array"); }
+
+			ndarray_t result(B.vector() ? shape_t{ outer } : shape_t{ outer, nCols }, Ty(0));
+			if (nnz() == 0 || result.empty()) { return result; }
+
+			// MKL does not take ownership of the buffers, so a handle is cheap to create for each product
+			auto& s = *_data;
+			index_type* pointers = const_cast<index_type*>(s.pointers.data());
+			index_type* indices = const_cast<index_type*>(s.indices.data());
+			Ty* values = const_cast<Ty*>(s.values.data());
+			index_type rows = static_cast<index_type>(_shape[0]);
+			index_type cols = static_cast<index_type>(_shape[1]);
+
+			sparse_matrix_t handle = nullptr;
+			sparse_status_t status = (_format == sparse_format::csr)
+				? mkl_sparse_d_create_csr(&handle, SPARSE_INDEX_BASE_ZERO, rows, cols, pointers, pointers + 1, indices, values)
+				: mkl_sparse_d_create_csc(&handle, SPARSE_INDEX_BASE_ZERO, rows, cols, pointers, pointers + 1, indices, values);
+			if (status != SPARSE_STATUS_SUCCESS) { throw std::invalid_argument("Could not create sparse matrix handle"); }
+
+			matrix_descr descr;
+			descr.type = SPARSE_MATRIX_TYPE_GENERAL;
+
+			if (nCols == 1)
+			{
+				status = mkl_sparse_d_mv(operation, 1.0, handle, descr, B.data(), 0.0, result.data());
+			}
+			else
+			{
+				status = mkl_sparse_d_mm(operation, 1.0, handle, descr, SPARSE_LAYOUT_COLUMN_MAJOR, B.data(),
+					static_cast<index_type>(nCols), static_cast<index_type>(inner), 0.0, result.data(), static_cast<index_type>(outer));
+			}
+
+			mkl_sparse_destroy(handle);
+			if (status != SPARSE_STATUS_SUCCESS) { throw std::invalid_argument("Sparse matrix product failed"); }
+
+			return result;
+		}
+	};
+}
@@ -1,14 +1,19 @@
 #pragma once
 
+#include "small_vector.hpp"
+
 #include <vector>
 #include <stdexcept>
-#include <random>
+#include <concepts>
 
 namespace nd
 {
-	typedef std::vector<size_t> shape_t;
-	typedef std::vector<size_t> stride_t;
-	typedef std::vector<size_t> index_t;
+	// Shapes, strides and indices are stored inline up to this rank, higher ranks keep them on the heap
+	constexpr size_t max_dims = 8;
+
+	typedef small_vector<size_t, max_dims> shape_t;
+	typedef small_vector<size_t, max_dims> stride_t;
+	typedef small_vector<size_t, max_dims> index_t;
 
 	struct range
 	{
@@ -52,6 +57,15 @@ namespace nd
 		return offset;
 	}
 
+	// Offset of an index given as separate integers, for call sites where the rank is known at compile time
+	template <std::integral... Idx>
+	inline size_t offset_of(const stride_t& strides, Idx... ndIndex)
+	{
+		size_t offset = 0, n = 0;
+		((offset += static_cast<size_t>(ndIndex) * strides[n++]), ...);
+		return offset;
+	}
+
 	inline std::vector<range> bounds_of(const shape_t& shape)
 	{
 		std::vector<range> bounds(shape.size());
@@ -99,13 +113,6 @@ namespace nd
 		}
 	}
 
-	inline double random_uniform()
-	{
-		static std::default_random_engine e;
-		static std::uniform_real_distribution<> dist(0, 1);
-		return dist(e);
-	}
-
 }
 
 template <>
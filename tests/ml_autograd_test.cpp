@@ -74,4 +74,203 @@ TEST(MLAutogradTest, TestVectorDerivative)
 class MatrixFunc : public differentiable
 {
 
-};
\ No newline at end of file
+};
+TEST(MLAutogradTest, TestSharedParameterDerivative)
+{
+	parameter x(scalar(3.0));
+
+	auto f = x.hadamard(x) + sin(x);
+
+	auto ddx = f.partial_wrt(x.id());
+
+	ASSERT_TRUE(ddx.approx_equal(scalar(2.0 * 3.0 + std::cos(3.0))));
+	ASSERT_ANY_THROW(f.partial_wrt(parameter(scalar(1.0)).id()));
+}
+
+TEST(MLAutogradTest, TestSoftmaxCrossEntropy)
+{
+	ml::matrix_t z({ 2, 3 });
+	z({ 0, 0 }) = 1.0; z({ 0, 1 }) = 2.0; z({ 0, 2 }) = 3.0;
+	z({ 1, 0 }) = 1000.0; z({ 1, 1 }) = -5.0; z({ 1, 2 }) = 999.0;
+
+	ml::matrix_t y({ 2, 3 });
+	y({ 0, 2 }) = 1.0;
+	y({ 1, 1 }) = 1.0;
+
+	parameter logits(z);
+	auto loss = softmax_cross_entropy(logits, parameter(y));
+	auto& l = loss.value();
+
+	// Large logits must not overflow
+	double lse0 = 3.0 + std::log(std::exp(-2.0) + std::exp(-1.0) + 1.0);
+	double lse1 = 1000.0 + std::log(1.0 + std::exp(-1005.0) + std::exp(-1.0));
+	ASSERT_NEAR(l({ 0, 0 }), lse0 - 3.0, 1e-10);
+	ASSERT_NEAR(l({ 1, 0 }), lse1 + 5.0, 1e-10);
+
+	auto grad = loss.partial_wrt(logits.id());
+	auto expected = ml::row_softmax(z) - y;
+	ASSERT_TRUE(grad.approx_equal(expected, 1e-10));
+}
+
+TEST(MLAutogradTest, TestSparseProduct)
+{
+	ml::matrix_t X({ 5, 3 });
+	X({ 0, 0 }) = 1.0; X({ 1, 2 }) = -2.0; X({ 3, 1 }) = 0.5; X({ 4, 0 }) = 3.0; X({ 4, 2 }) = 1.0;
+
+	ml::matrix_t w0({ 3, 1 });
+	w0({ 0, 0 }) = 0.1; w0({ 1, 0 }) = -0.3; w0({ 2, 0 }) = 0.2;
+
+	parameter w(w0);
+	auto sparseOut = sigmoid(ml::sparse_t::from_dense(X) * w);
+	auto denseOut = sigmoid(parameter(X) * w);
+
+	ASSERT_TRUE(sparseOut.value().approx_equal(denseOut.value(), 1e-12));
+	ASSERT_TRUE(sparseOut.partial_wrt(w.id()).approx_equal(denseOut.partial_wrt(w.id()), 1e-12));
+}
+
+TEST(MLAutogradTest, TestFusedDense)
+{
+	ml::matrix_t X0 = ml::random({ 300, 4 }) - 0.5;
+	ml::matrix_t W0 = ml::random({ 4, 70 }) - 0.5;
+	ml::matrix_t b0 = ml::random({ 1, 70 }) - 0.5;
+
+	parameter X(X0), W(W0), b(b0);
+	auto fused = fused_dense(X, W, b, ml::kernels::activation::sigmoid);
+	auto composed = sigmoid(X * W + parameter(ml::ones({ 300, 1 })) * b);
+
+	// d_sigmoid evaluates in single precision, hence the looser tolerance on the gradients
+
+	ASSERT_TRUE(fused.value().approx_equal(composed.value(), 1e-12));
+	ASSERT_TRUE(fused.partial_wrt(W.id()).approx_equal(composed.partial_wrt(W.id()), 1e-6));
+	ASSERT_TRUE(fused.partial_wrt(b.id()).approx_equal(composed.partial_wrt(b.id()), 1e-6));
+	ASSERT_TRUE(fused.partial_wrt(X.id()).approx_equal(composed.partial_wrt(X.id()), 1e-6));
+
+	// Softmax rows sum to one, so weight the outputs to get a non-trivial gradient
+	ml::matrix_t R = ml::random({ 300, 70 });
+	auto softmaxOut = fused_dense(X, W, b, ml::kernels::activation::softmax);
+	ASSERT_TRUE(softmaxOut.value().approx_equal(ml::row_softmax(X0 * W0 + ml::ones({ 300, 1 }) * b0), 1e-12));
+
+	auto weighted = softmaxOut.hadamard(parameter(R));
+	auto db = weighted.partial_wrt(b.id());
+
+	const double h = 1e-6;
+	for (size_t k : { 0, 33, 69 })
+	{
+		ml::matrix_t bPlus(b0), bMinus(b0);
+		bPlus({ 0, k }) += h;
+		bMinus({ 0, k }) -= h;
+
+		ml::matrix_t outPlus, outMinus;
+		ml::kernels::dense_forward(X0, W0, bPlus, ml::kernels::activation::softmax, outPlus);
+		ml::kernels::dense_forward(X0, W0, bMinus, ml::kernels::activation::softmax, outMinus);
+		double numeric = (outPlus.hadamard(R).sum() - outMinus.hadamard(R).sum()) / (2 * h);
+		ASSERT_NEAR(db({ 0, k }), numeric, 1e-6);
+	}
+}
+
+TEST(MLAutogradTest, TestFusedDenseSharedBackward)
+{
+	parameter X(ml::random({ 50, 6 }) - 0.5);
+	parameter W1(ml::random({ 6, 8 }) - 0.5), b1(ml::random({ 1, 8 }) - 0.5);
+	parameter W2(ml::random({ 8, 3 }) - 0.5), b2(ml::random({ 1, 3 }) - 0.5);
+	auto hidden = fused_dense(X, W1, b1, ml::kernels::activation::sigmoid);
+	auto out = fused_dense(hidden, W2, b2, ml::kernels::activation::sigmoid);
+	auto composed = sigmoid(sigmoid(X * W1 + parameter(ml::ones({ 50, 1 })) * b1) * W2 + parameter(ml::ones({ 50, 1 })) * b2);
+
+	auto& profiler = nd::profiling::profiler::global();
+#ifdef ML_ENABLE_PROFILING
+	auto count_activation_backward = [&profiler]()
+		{
+			size_t calls = 0;
+			for (auto& e : profiler.events()) { calls += (std::string(e.name) == "activation_backward") ? 1 : 0; }
+			return calls;
+		};
+#endif
+
+	// One activation backward per layer however many of its parents need a gradient, only observable in profiling builds
+	profiler.clear();
+	profiler.start();
+	auto grads = out.gradients({ X.id(), W1.id(), b1.id(), W2.id(), b2.id() });
+	profiler.stop();
+#ifdef ML_ENABLE_PROFILING
+	ASSERT_EQ(count_activation_backward(), 2);
+#endif
+
+	profiler.clear();
+	profiler.start();
+	auto again = out.gradients({ W2.id(), b2.id() });
+	profiler.stop();
+#ifdef ML_ENABLE_PROFILING
+	ASSERT_EQ(count_activation_backward(), 1);
+#endif
+	profiler.clear();
+
+	auto expected = composed.gradients({ X.id(), W1.id(), b1.id(), W2.id(), b2.id() });
+	for (size_t i = 0; i < grads.size(); ++i)
+	{
+		ASSERT_TRUE(grads[i].approx_equal(expected[i], 1e-6));
+	}
+	ASSERT_TRUE(again[0].approx_equal(expected[3], 1e-6));
+	ASSERT_TRUE(again[1].approx_equal(expected[4], 1e-6));
+}
+
+TEST(MLAutogradTest, TestGradientsOnePass)
+{
+	parameter x(scalar(0.7));
+	parameter y(scalar(-1.3));
+
+	// y feeds the graph through several paths and x sits below a shared node
+	auto shared = x.hadamard(y);
+	auto f = sin(shared) + shared.hadamard(y) + exp(y);
+
+	auto grads = f.gradients({ x.id(), y.id() });
+	ASSERT_TRUE(grads[0].approx_equal(f.partial_wrt(x.id()), 1e-12));
+	ASSERT_TRUE(grads[1].approx_equal(f.partial_wrt(y.id()), 1e-12));
+
+	double dfdx = std::cos(0.7 * -1.3) * -1.3 + -1.3 * -1.3;
+	double dfdy = std::cos(0.7 * -1.3) * 0.7 + 2.0 * 0.7 * -1.3 + std::exp(-1.3);
+	ASSERT_NEAR(grads[0]({ 0 }), dfdx, 1e-12);
+	ASSERT_NEAR(grads[1]({ 0 }), dfdy, 1e-12);
+	ASSERT_ANY_THROW(f.gradients({ x.id(), parameter(scalar(1.0)).id() }));
+}
+
+TEST(MLAutogradTest, TestSoftmaxJacobian)
+{
+	ml::matrix_t x = ml::random({ 6, 1 });
+	ml::matrix_t J = ml::d_softmax(x);
+	ASSERT_EQ(J.shape(), (nd::shape_t{ 6, 6 }));
+
+	double h = 1e-6;
+	for (size_t j = 0; j < 6; ++j)
+	{
+		ml::matrix_t xPlus(x), xMinus(x);
+		xPlus(j, 0) += h;
+		xMinus(j, 0) -= h;
+		ml::matrix_t column = (ml::softmax(xPlus) - ml::softmax(xMinus)) / (2 * h);
+		for (size_t i = 0; i < 6; ++i) { ASSERT_NEAR(J(i, j), column(i, 0), 1e-8); }
+	}
+}
+
+TEST(MLAutogradTest, TestMatrixProductGradients)
+{
+	ml::matrix_t A = ml::random({ 4, 3 });
+	ml::matrix_t B = ml::random({ 3, 5 });
+	ml::matrix_t C = ml::random({ 3, 5 });
+	parameter a(A), b(B), c(C);
+
+	// a receives gradients from both products, which accumulate into one buffer
+	auto f = a * b + a * c;
+	auto grads = f.gradients({ a.id(), b.id(), c.id() });
+
+	ml::matrix_t ones = ml::ones({ 4, 5 });
+	ASSERT_TRUE(grads[0].approx_equal(ones * (B + C).T(), 1e-12));
+	ASSERT_TRUE(grads[1].approx_equal(A.T() * ones, 1e-12));
+	ASSERT_TRUE(grads[2].approx_equal(A.T() * ones, 1e-12));
+
+	auto g = a.T() / 2.0;
+	ASSERT_TRUE(g.partial_wrt(a.id()).approx_equal(ml::matrix_t({ 4, 3 }, 0.5), 1e-12));
+
+	parameter u(vector(3) * 2.0), v(ml::random({ 3 }));
+	auto h = u.dot(v) * 3.0;
+	ASSERT_TRUE(h.partial_wrt(v.id()).approx_equal(vector(3) * 6.0, 1e-12));
+}
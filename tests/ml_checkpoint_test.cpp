@@ -0,0 +1,182 @@
+#include "pch.h"
+
+using namespace ml;
+
+namespace
+{
+	std::string checkpoint_path(const std::string& name)
+	{
+		return (std::filesystem::temp_directory_path() / name).string();
+	}
+}
+
+TEST(MLCheckpointTest, TestRoundTrip)
+{
+	std::string path = checkpoint_path("ml_checkpoint_round_trip.mlck");
+
+	nets::mlp net({ 6, 16, 8, 3 }, layers::activation::relu, layers::activation::identity);
+	matrix_t X = random({ 40, 6 });
+	auto expected = net.predict(X);
+	serialization::checkpoint::save(path, net);
+
+	serialization::checkpoint file(path);
+	ASSERT_EQ(file.version(), serialization::file_version);
+	ASSERT_EQ(file.names().size(), 6);
+	ASSERT_TRUE(file.contains("param.0"));
+	ASSERT_EQ(file.view("param.0").shape(), nd::shape_t({ 6, 16 }));
+
+	nets::mlp copied({ 6, 16, 8, 3 }, layers::activation::relu, layers::activation::identity);
+	file.load(copied);
+	ASSERT_TRUE(copied.layers()[0].weights().owns_data());
+	ASSERT_EQ(copied.predict(X), expected);
+
+	nets::mlp mapped({ 6, 16, 8, 3 }, layers::activation::relu, layers::activation::identity);
+	file.load(mapped, true);
+	ASSERT_FALSE(mapped.layers()[0].weights().owns_data());
+	ASSERT_EQ(mapped.predict(X), expected);
+
+	std::filesystem::remove(path);
+}
+
+TEST(MLCheckpointTest, TestOptimizerState)
+{
+	std::string path = checkpoint_path("ml_checkpoint_adam.mlck");
+
+	matrix_t X = random({ 64, 4 });
+	matrix_t Y = one_hot(matrix_t::random({ 64, 1 }) * 2.0, 2);
+	std::vector<autograd::parameter> inputs = { autograd::parameter(X) };
+
+	nets::mlp net({ 4, 8, 2 }, layers::activation::tanh, layers::activation::identity);
+	optimizers::Adam adam(metrics::categorical_cross_entropy, 0.01, 3);
+	adam.set_shuffle(false);
+	adam.optimize(net, inputs, Y);
+	serialization::checkpoint::save(path, net, adam);
+
+	nets::mlp resumed({ 4, 8, 2 }, layers::activation::tanh, layers::activation::identity);
+	optimizers::Adam resumedAdam(metrics::categorical_cross_entropy, 0.01, 3);
+	resumedAdam.set_shuffle(false);
+	{
+		serialization::checkpoint file(path);
+		file.load(resumed);
+		file.load(resumedAdam, resumed);
+	}
+
+	// Continuing from the checkpoint takes the same steps as continuing the original run
+	adam.optimize(net, inputs, Y);
+	resumedAdam.optimize(resumed, inputs, Y);
+	auto expected = net.predict(X);
+	auto actual = resumed.predict(X);
+	for (size_t i = 0; i < expected.N(); ++i)
+	{
+		ASSERT_NEAR(actual.data()[i], expected.data()[i], 1e-12);
+	}
+
+	std::filesystem::remove(path);
+}
+
+TEST(MLCheckpointTest, TestInvalidFiles)
+{
+	std::string path = checkpoint_path("ml_checkpoint_invalid.mlck");
+	{
+		std::ofstream out(path, std::ios::binary);
+		out << "not a checkpoint";
+	}
+	ASSERT_THROW(serialization::checkpoint{ path }, std::invalid_argument);
+
+	nets::mlp net({ 3, 4, 1 });
+	serialization::checkpoint::save(path, net);
+
+	serialization::checkpoint file(path);
+	ASSERT_THROW(file.view("param.9"), std::invalid_argument);
+
+	nets::mlp other({ 3, 5, 1 });
+	ASSERT_THROW(file.load(other), std::invalid_argument);
+
+	// A single {4, 4} tensor named "a": its dims start at byte 29 and its offset is at byte 45
+	auto patched = [&path](size_t position, uint64_t value)
+		{
+			serialization::write_tensors(path, { { "a", ml::ones({ 4, 4 }) } });
+			std::fstream file(path, std::ios::binary | std::ios::in | std::ios::out);
+			file.seekp(position);
+			file.write(reinterpret_cast<const char*>(&value), sizeof(value));
+		};
+
+	patched(45, 64);
+	ASSERT_EQ(serialization::checkpoint(path).view("a").sum(), 16.0);
+
+	// Inside the file and aligned for a double, but not to data_alignment
+	patched(45, 56);
+	ASSERT_THROW(serialization::checkpoint{ path }, std::invalid_argument);
+
+	// 4 * 2^62 items wrap around to zero
+	patched(37, uint64_t(1) << 62);
+	ASSERT_THROW(serialization::checkpoint{ path }, std::invalid_argument);
+
+	patched(45, 128);
+	ASSERT_THROW(serialization::checkpoint{ path }, std::invalid_argument);
+
+	std::filesystem::remove(path);
+}
+
+TEST(MLCheckpointTest, TestBlockReader)
+{
+	std::string path = checkpoint_path("ml_checkpoint_blocks.mlck");
+
+	matrix_t X = random({ 1000, 5 });
+	matrix_t b = random({ 5, 2 });
+	matrix_t y = X * b;
+	serialization::write_tensors(path, { { "X", X }, { "y", y } });
+
+	serialization::block_reader reader(path, 300);
+	ASSERT_EQ(reader.rows(), 1000);
+	ASSERT_EQ(reader.features(), 5);
+	ASSERT_EQ(reader.blocks(), 4);
+
+	regression::linear lin;
+	matrix_t yBlock, XBlock;
+	size_t seen = 0;
+	while (reader.next(yBlock, XBlock))
+	{
+		size_t count = XBlock.shape()[0];
+		ASSERT_TRUE(XBlock.approx_equal(X({ nd::range(seen, seen + count), nd::range(5) }), 0.0));
+		lin.update(yBlock, XBlock);
+		seen += count;
+	}
+	lin.finalize();
+
+	ASSERT_EQ(seen, 1000);
+	ASSERT_EQ(XBlock.shape()[0], 100);
+	ASSERT_EQ(lin.samples_seen(), 1000);
+	ASSERT_TRUE(lin.coefficients().approx_equal(b, 1e-8));
+
+	reader.rewind();
+	ASSERT_TRUE(reader.next(yBlock, XBlock));
+	ASSERT_EQ(XBlock.shape()[0], 300);
+
+	ASSERT_THROW(serialization::block_reader(path, 300, "y", "missing"), std::invalid_argument);
+	std::filesystem::remove(path);
+}
+
+TEST(MLCheckpointTest, TestBackgroundCheckpointer)
+{
+	std::string path = checkpoint_path("ml_checkpoint_background.mlck");
+
+	matrix_t X = random({ 32, 4 });
+	matrix_t Y = one_hot(matrix_t::random({ 32, 1 }) * 2.0, 2);
+
+	nets::mlp net({ 4, 8, 2 }, layers::activation::relu, layers::activation::identity);
+	optimizers::SGD sgd(metrics::categorical_cross_entropy, 0.1, 5, 8);
+	{
+		serialization::background_checkpointer saver(path);
+		sgd.on_epoch([&](const optimizers::epoch_stats&) { saver.submit(net, sgd); });
+		sgd.optimize(net, { autograd::parameter(X) }, Y);
+		saver.wait();
+		ASSERT_GE(saver.written(), 1);
+	}
+
+	nets::mlp restored({ 4, 8, 2 }, layers::activation::relu, layers::activation::identity);
+	serialization::checkpoint(path).load(restored);
+	ASSERT_EQ(restored.predict(X), net.predict(X));
+
+	std::filesystem::remove(path);
+}
@@ -74,4 +74,76 @@ TEST(MLDataTest, TestReadCsv)
 	auto means = data.mean(0);
 
 	ASSERT_TRUE(means.approx_equal(actualMeans, 0.1));
-}
\ No newline at end of file
+}
+TEST(MLDataTest, TestCsvReaderBlocks)
+{
+	std::string path = "csv_reader_test.csv";
+	{
+		std::ofstream out(path);
+		out << "a,b,c\n";
+		for (int i = 0; i < 7; ++i)
+		{
+			out << i << "," << i * 10 << "," << -i << "\n";
+		}
+	}
+
+	csv_props props;
+	props.ignoreHeader = true;
+	props.excludedCols = { 1 };
+	csv_reader<double> reader(path, props);
+
+	nd::array<> block;
+	std::vector<size_t> blockRows;
+	double total = 0.0;
+	while (reader.next(block, 3))
+	{
+		ASSERT_EQ(block.shape()[1], 2);
+		blockRows.push_back(block.shape()[0]);
+		total += block.sum();
+	}
+
+	ASSERT_EQ(blockRows, (std::vector<size_t>{ 3, 3, 1 }));
+	ASSERT_DOUBLE_EQ(total, 0.0);
+	std::remove(path.c_str());
+}
+
+TEST(MLDataTest, TestReadSparse)
+{
+	std::string path = "libsvm_test.txt";
+	{
+		std::ofstream out(path);
+		out << "1 1:0.5 4:2\n";
+		out << "# comment\n";
+		out << "0 2:-1 # trailing\n";
+		out << "1\n";
+	}
+
+	auto [X, y] = read_libsvm(path);
+	ASSERT_EQ(X.shape(), (nd::shape_t{ 3, 4 }));
+	ASSERT_EQ(X.nnz(), 3);
+	ASSERT_DOUBLE_EQ(X.to_dense()({ 0, 3 }), 2.0);
+	ASSERT_DOUBLE_EQ(X.to_dense()({ 1, 1 }), -1.0);
+	ASSERT_DOUBLE_EQ(y({ 2, 0 }), 1.0);
+	ASSERT_EQ(read_libsvm(path, 10).first.shape()[1], 10);
+	ASSERT_ANY_THROW(read_libsvm(path, 2));
+	std::remove(path.c_str());
+
+	path = "csv_sparse_test.csv";
+	{
+		std::ofstream out(path);
+		out << "a,b,c\n";
+		for (int i = 0; i < 5; ++i)
+		{
+			out << (i % 2) << ",0," << i << "\n";
+		}
+	}
+
+	csv_props props;
+	props.ignoreHeader = true;
+	props.excludedCols = {};
+	auto S = read_csv_sparse<double>(path, props, default_column_parser{}, 2);
+	ASSERT_EQ(S.shape(), (nd::shape_t{ 5, 3 }));
+	ASSERT_EQ(S.nnz(), 6);
+	ASSERT_DOUBLE_EQ(S.to_dense()({ 4, 2 }), 4.0);
+	std::remove(path.c_str());
+}
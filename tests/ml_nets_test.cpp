@@ -5,4 +5,71 @@ using namespace ml;
 TEST(MLNetsTest, TestMLP)
 {
 	nets::mlp mlp({ 10, 64, 10 });
-}
\ No newline at end of file
+}
+TEST(MLNetsTest, TestBatchedInference)
+{
+	nets::mlp mlp({ 5, 8, 3 }, layers::activation::tanh, layers::activation::softmax, 4);
+	ASSERT_EQ(mlp.inputs(), 5);
+	ASSERT_EQ(mlp.outputs(), 3);
+
+	matrix_t X = random({ 11, 5 });
+	auto Y = mlp.predict(X);
+	ASSERT_EQ(Y.shape(), (nd::shape_t{ 11, 3 }));
+
+	// Chunked inference must match applying the layers to the whole batch
+	auto& hidden = mlp.layers()[0];
+	auto& output = mlp.layers()[1];
+	auto expected = row_softmax(tanh(X * hidden.weights() + ones({ 11, 1 }) * hidden.biases()) * output.weights() + ones({ 11, 1 }) * output.biases());
+	ASSERT_TRUE(Y.approx_equal(expected, 1e-12));
+	ASSERT_TRUE(mlp.predict(X).approx_equal(Y));
+
+	ASSERT_ANY_THROW(mlp.predict(random({ 2, 4 })));
+}
+
+TEST(MLNetsTest, TestTrainMLP)
+{
+	// Quadrant XOR, which a linear model cannot separate
+	size_t N = 400;
+	matrix_t X = (random({ N, 2 }) - 0.5) * 2.0;
+	matrix_t labels({ N, 1 });
+	for (size_t i = 0; i < N; ++i)
+	{
+		labels({ i, 0 }) = (X({ i, 0 }) * X({ i, 1 }) > 0.0) ? 1.0 : 0.0;
+	}
+	matrix_t Y = one_hot(labels, 2);
+
+	nets::mlp net({ 2, 16, 2 }, layers::activation::tanh, layers::activation::identity);
+	optimizers::Adam adam(metrics::categorical_cross_entropy, 0.02, 150, 32);
+	adam.seed(1);
+	adam.optimize(net, { autograd::parameter(X) }, Y);
+
+	auto& history = adam.history();
+	ASSERT_LT(history.back().cost, 0.5 * history.front().cost);
+
+	auto logits = net.predict(X);
+	size_t correct = 0;
+	for (size_t i = 0; i < N; ++i)
+	{
+		size_t predicted = (logits({ i, 1 }) > logits({ i, 0 })) ? 1 : 0;
+		if (predicted == labels({ i, 0 })) { correct++; }
+	}
+	ASSERT_GT(correct, 0.9 * N);
+}
+
+TEST(MLNetsTest, TestInitializers)
+{
+	ml::seed(3);
+	ml::matrix_t W = ml::xavier_uniform(300, 200);
+	ml::seed(3);
+	ASSERT_TRUE(ml::xavier_uniform(300, 200).approx_equal(W, 0.0));
+
+	double limit = std::sqrt(6.0 / 500.0);
+	ASSERT_EQ(W.shape(), (nd::shape_t{ 300, 200 }));
+	ASSERT_GE(W.min(), -limit);
+	ASSERT_LT(W.max(), limit);
+	ASSERT_NEAR(W.variance(), limit * limit / 3.0, 0.05 * limit * limit);
+
+	ASSERT_NEAR(ml::he_normal(400, 100).stddev(), std::sqrt(2.0 / 400.0), 0.002);
+	ASSERT_NEAR(ml::xavier_normal(400, 100).stddev(), std::sqrt(2.0 / 500.0), 0.002);
+	ASSERT_LE(ml::he_uniform(400, 100).max(), std::sqrt(6.0 / 400.0));
+}
@@ -77,4 +77,181 @@ TEST(MLOptimizerTest, TestSGD)
 
 	SGD sgd(ml::metrics::cross_entropy, 0.0001, 100);
 	sgd.optimize(logreg, {X}, y);
-}
\ No newline at end of file
+}
+
+class LinearModel : public differentiable
+{
+public:
+	LinearModel(size_t nFeatures)
+		: w(ml::matrix_t({ nFeatures, 1 }))
+	{
+	}
+
+	parameter w;
+
+	parameter operator()(const std::vector<parameter>& params) const
+	{
+		return params[0] * w;
+	}
+
+protected:
+	std::vector<size_t> _trainable_param_ids() const { return { w.id() }; }
+
+	ml::matrix_t& _parameter_value(size_t id) { return w.value(); }
+};
+
+parameter squared_error(const parameter& y, const parameter& yhat)
+{
+	auto diff = yhat - y;
+	return diff.hadamard(diff);
+}
+
+void make_linear_data(ml::matrix_t& X, ml::matrix_t& y, ml::matrix_t& w)
+{
+	X = ml::random({ 103, 3 });
+	w = ml::matrix_t({ 3, 1 });
+	w({ 0, 0 }) = 1.0;
+	w({ 1, 0 }) = -2.0;
+	w({ 2, 0 }) = 0.5;
+	y = X * w;
+}
+
+TEST(MLOptimizerTest, TestMiniBatchSGD)
+{
+	ml::matrix_t X, y, trueW;
+	make_linear_data(X, y, trueW);
+
+	LinearModel model(3);
+	SGD sgd(squared_error, 0.05, 200, 16);
+	sgd.seed(42);
+	sgd.optimize(model, { X }, y);
+
+	ASSERT_TRUE(model.w.value().approx_equal(trueW, 0.05));
+
+	auto& history = sgd.history();
+	ASSERT_EQ(history.size(), 200);
+	ASSERT_EQ(history.back().samples, 103);
+	ASSERT_GT(history.back().samplesPerSec, 0.0);
+}
+
+template <class Opt, typename... Args>
+void check_converges(Args... args)
+{
+	ml::matrix_t X, y, trueW;
+	make_linear_data(X, y, trueW);
+
+	LinearModel model(3);
+	Opt opt(squared_error, args...);
+	opt.seed(7);
+	opt.optimize(model, { X }, y);
+
+	ASSERT_TRUE(model.w.value().approx_equal(trueW, 0.05));
+}
+
+TEST(MLOptimizerTest, TestMomentum)
+{
+	check_converges<Momentum>(0.01, 200, 16);
+	check_converges<Momentum>(0.01, 200, 16, 0.9, false);
+}
+
+TEST(MLOptimizerTest, TestRMSProp)
+{
+	check_converges<RMSProp>(0.01, 300, 16);
+}
+
+TEST(MLOptimizerTest, TestAdam)
+{
+	check_converges<Adam>(0.05, 300, 16);
+	check_converges<AdamW>(0.05, 300, 16, 0.0001);
+}
+
+TEST(MLOptimizerTest, TestDataParallel)
+{
+	ml::matrix_t X, y, trueW;
+	make_linear_data(X, y, trueW);
+
+	LinearModel serialModel(3);
+	SGD serial(squared_error, 0.01, 50, 32);
+	serial.seed(3);
+	serial.optimize(serialModel, { X }, y);
+
+	LinearModel parallelModel(3);
+	SGD parallel(squared_error, 0.01, 50, 32);
+	parallel.seed(3);
+	parallel.set_workers(4);
+	parallel.optimize(parallelModel, { X }, y);
+
+	ASSERT_TRUE(parallelModel.w.value().approx_equal(serialModel.w.value(), 1e-9));
+}
+
+TEST(MLOptimizerTest, TestHogwild)
+{
+	size_t nSamples = 400;
+	size_t nFeatures = 20;
+
+	// Each sample activates two features, the label depends on the first one
+	ml::matrix_t X({ nSamples, nFeatures });
+	ml::matrix_t y({ nSamples, 1 });
+	for (size_t i = 0; i < nSamples; ++i)
+	{
+		size_t a = i % nFeatures;
+		size_t b = (i * 7 + 3) % nFeatures;
+		X({ i, a }) = 1.0;
+		X({ i, b }) = 1.0;
+		y({ i, 0 }) = (a < nFeatures / 2) ? 1.0 : 0.0;
+	}
+
+	ml::regression::logistic logreg(y, X);
+
+	Hogwild hogwild(0.1, 30, 4);
+	hogwild.seed(11);
+	hogwild.optimize(logreg, X, y);
+
+	auto& history = hogwild.history();
+	ASSERT_EQ(history.size(), 30);
+	ASSERT_LT(history.back().cost, history.front().cost);
+	ASSERT_LT(history.back().cost / nSamples, 0.2);
+}
+
+TEST(MLOptimizerTest, TestSparseInputs)
+{
+	size_t nSamples = 200;
+	size_t nFeatures = 10;
+
+	ml::matrix_t X({ nSamples, nFeatures });
+	ml::matrix_t y({ nSamples, 1 });
+	for (size_t i = 0; i < nSamples; ++i)
+	{
+		size_t a = i % nFeatures;
+		X({ i, a }) = 1.0;
+		y({ i, 0 }) = (a < nFeatures / 2) ? 1.0 : 0.0;
+	}
+
+	ml::regression::logistic logreg(y, X);
+	SGD sgd(cross_entropy, 0.5, 30, 16);
+	sgd.seed(5);
+	sgd.optimize(logreg, ml::sparse_t::from_dense(X), y);
+
+	auto& history = sgd.history();
+	ASSERT_LT(history.back().cost, history.front().cost);
+	ASSERT_LT(history.back().cost / nSamples, 0.2);
+
+	ml::regression::logistic sparseLogreg(y, X);
+	Hogwild hogwild(0.1, 20, 2);
+	hogwild.optimize(sparseLogreg, ml::sparse_t::from_dense(X, nd::sparse_format::csc), y);
+	ASSERT_LT(hogwild.history().back().cost, hogwild.history().front().cost);
+}
+
+TEST(MLOptimizerTest, TestLBFGS)
+{
+	ml::matrix_t X, y, trueW;
+	make_linear_data(X, y, trueW);
+
+	LinearModel model(3);
+	LBFGS lbfgs(squared_error, 100, 5);
+	lbfgs.optimize(model, { X }, y);
+
+	ASSERT_TRUE(lbfgs.converged());
+	ASSERT_LT(lbfgs.history().size(), 30);
+	ASSERT_TRUE(model.w.value().approx_equal(trueW, 1e-4));
+}
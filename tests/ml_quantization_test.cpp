@@ -0,0 +1,117 @@
+#include "pch.h"
+
+using namespace ml;
+
+TEST(MLQuantizationTest, TestGemmU8S8)
+{
+	size_t rows = 7, cols = 5, depth = 33;
+	std::vector<uint8_t> A(rows * depth);
+	std::vector<int8_t> B(depth * cols);
+	for (size_t i = 0; i < A.size(); ++i) { A[i] = static_cast<uint8_t>((i * 37) % 256); }
+	int levels = quantization::weight_levels();
+	for (size_t i = 0; i < B.size(); ++i) { B[i] = static_cast<int8_t>(static_cast<int>((i * 53) % (2 * levels + 1)) - levels); }
+
+	std::vector<int32_t> C(rows * cols);
+	quantization::gemm_u8s8s32(rows, cols, depth, A.data(), rows, B.data(), depth, C.data(), rows);
+
+	for (size_t j = 0; j < cols; ++j)
+	{
+		for (size_t i = 0; i < rows; ++i)
+		{
+			int32_t expected = 0;
+			for (size_t p = 0; p < depth; ++p)
+			{
+				expected += (static_cast<int32_t>(A[p * rows + i]) - 128) * B[j * depth + p];
+			}
+			ASSERT_EQ(C[j * rows + i], expected);
+		}
+	}
+}
+
+TEST(MLQuantizationTest, TestGemmWorstCase)
+{
+	// Extreme activations against extreme weights of either sign, where pairwise int16 sums would saturate
+	size_t rows = 4, cols = 4, depth = 64;
+	int levels = quantization::weight_levels();
+	std::vector<uint8_t> A(rows * depth);
+	std::vector<int8_t> B(depth * cols);
+	for (size_t p = 0; p < depth; ++p)
+	{
+		A[p * rows + 0] = 255;
+		A[p * rows + 1] = 0;
+		A[p * rows + 2] = (p % 2 == 0) ? 255 : 0;
+		A[p * rows + 3] = quantization::quantize_u8(1e9, 1.0);
+
+		B[0 * depth + p] = static_cast<int8_t>(levels);
+		B[1 * depth + p] = static_cast<int8_t>(-levels);
+		B[2 * depth + p] = static_cast<int8_t>((p % 2 == 0) ? levels : -levels);
+		B[3 * depth + p] = quantization::quantize_s8(-1e9, 1.0, levels);
+	}
+
+	std::vector<int32_t> C(rows * cols), reference(rows * cols);
+	quantization::gemm_u8s8s32(rows, cols, depth, A.data(), rows, B.data(), depth, C.data(), rows);
+	quantization::gemm_u8s8s32_reference(rows, cols, depth, A.data(), rows, B.data(), depth, reference.data(), rows);
+	ASSERT_EQ(C, reference);
+	ASSERT_EQ(reference[0], static_cast<int32_t>(depth) * 127 * levels);
+	ASSERT_EQ(reference[3 * rows + 3], -static_cast<int32_t>(depth) * 127 * levels);
+}
+
+TEST(MLQuantizationTest, TestInt8Parity)
+{
+	nets::mlp net({ 20, 64, 32, 5 }, layers::activation::relu, layers::activation::identity, 64);
+	matrix_t X = (random({ 300, 20 }) - 0.5) * 2.0;
+	auto expected = net.predict(X);
+
+	quantization::int8_mlp quantized(net, X, 64);
+	auto actual = quantized.predict(X);
+	ASSERT_EQ(actual.shape(), expected.shape());
+
+	double maxOutput = 0.0, maxError = 0.0;
+	size_t agree = 0;
+	for (size_t i = 0; i < X.shape()[0]; ++i)
+	{
+		size_t bestExpected = 0, bestActual = 0;
+		for (size_t k = 0; k < 5; ++k)
+		{
+			maxOutput = std::max(maxOutput, std::abs(expected({ i, k })));
+			maxError = std::max(maxError, std::abs(expected({ i, k }) - actual({ i, k })));
+			if (expected({ i, k }) > expected({ i, bestExpected })) { bestExpected = k; }
+			if (actual({ i, k }) > actual({ i, bestActual })) { bestActual = k; }
+		}
+		if (bestExpected == bestActual) { agree++; }
+	}
+
+	ASSERT_LT(maxError, 0.05 * maxOutput);
+	ASSERT_GT(agree, 0.95 * X.shape()[0]);
+
+	size_t f64Bytes = (20 * 64 + 64 * 32 + 32 * 5) * sizeof(double);
+	ASSERT_LT(quantized.weight_bytes() * 4, f64Bytes);
+}
+
+TEST(MLQuantizationTest, TestTrainedMLP)
+{
+	size_t N = 400;
+	matrix_t X = (random({ N, 2 }) - 0.5) * 2.0;
+	matrix_t labels({ N, 1 });
+	for (size_t i = 0; i < N; ++i)
+	{
+		labels({ i, 0 }) = (X({ i, 0 }) * X({ i, 1 }) > 0.0) ? 1.0 : 0.0;
+	}
+
+	nets::mlp net({ 2, 16, 2 }, layers::activation::tanh, layers::activation::softmax);
+	optimizers::Adam adam(metrics::categorical_cross_entropy, 0.02, 100, 32);
+	adam.seed(2);
+	adam.optimize(net, { autograd::parameter(X) }, one_hot(labels, 2));
+
+	quantization::int8_mlp quantized(net, X);
+	auto expected = net.predict(X);
+	auto actual = quantized.predict(X);
+
+	size_t agree = 0;
+	for (size_t i = 0; i < N; ++i)
+	{
+		ASSERT_NEAR(actual({ i, 0 }) + actual({ i, 1 }), 1.0, 1e-12);
+		if ((expected({ i, 1 }) > expected({ i, 0 })) == (actual({ i, 1 }) > actual({ i, 0 }))) { agree++; }
+	}
+	ASSERT_GT(agree, 0.97 * N);
+}
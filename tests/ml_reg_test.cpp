@@ -1,3 +1,124 @@
 #include "pch.h"
 
-using namespace ml;
\ No newline at end of file
+using namespace ml;
+
+void make_regression_data(matrix_t& X, matrix_t& y, matrix_t& b)
+{
+	X = random({ 50, 4 });
+	b = matrix_t({ 4, 1 });
+	b({ 0, 0 }) = 3.0;
+	b({ 1, 0 }) = -1.0;
+	b({ 2, 0 }) = 0.25;
+	b({ 3, 0 }) = 2.0;
+	y = X * b;
+}
+
+TEST(MLRegressionTest, TestLinearDirectFit)
+{
+	matrix_t X, y, b;
+	make_regression_data(X, y, b);
+
+	regression::linear lin(y, X);
+
+	lin.fit(regression::solver::cholesky);
+	ASSERT_TRUE(lin.coefficients().approx_equal(b, 1e-8));
+
+	lin.fit(regression::solver::qr);
+	ASSERT_TRUE(lin.coefficients().approx_equal(b, 1e-8));
+
+	lin.fit(regression::solver::svd);
+	ASSERT_TRUE(lin.coefficients().approx_equal(b, 1e-8));
+}
+
+TEST(MLRegressionTest, TestLinearRankDeficient)
+{
+	// The last column repeats the first, so only the sum of their coefficients is identifiable
+	matrix_t X = random({ 30, 3 });
+	for (size_t i = 0; i < 30; ++i)
+	{
+		X({ i, 2 }) = X({ i, 0 });
+	}
+
+	matrix_t b({ 3, 1 });
+	b({ 0, 0 }) = 1.0;
+	b({ 1, 0 }) = 2.0;
+	b({ 2, 0 }) = 1.0;
+	matrix_t y = X * b;
+
+	regression::linear lin(y, X);
+
+	lin.fit(regression::solver::svd);
+	ASSERT_TRUE(lin.coefficients().approx_equal(b, 1e-8));
+}
+
+TEST(MLRegressionTest, TestLinearStreaming)
+{
+	matrix_t X, y, b;
+	make_regression_data(X, y, b);
+
+	regression::linear lin;
+	for (size_t first = 0; first < 50; first += 15)
+	{
+		size_t last = std::min<size_t>(first + 15, 50);
+		lin.update(y({ nd::range(first, last), nd::range(1) }), X({ nd::range(first, last), nd::range(4) }));
+	}
+	lin.finalize();
+
+	ASSERT_EQ(lin.samples_seen(), 50);
+	ASSERT_TRUE(lin.coefficients().approx_equal(b, 1e-8));
+
+	// More data refines the existing fit without revisiting old rows
+	matrix_t X2 = random({ 20, 4 });
+	lin.update(X2 * b, X2);
+	lin.finalize();
+	ASSERT_EQ(lin.samples_seen(), 70);
+	ASSERT_TRUE(lin.coefficients().approx_equal(b, 1e-8));
+}
+
+TEST(MLRegressionTest, TestMultinomial)
+{
+	// Three well separated clusters
+	size_t N = 90;
+	matrix_t X({ N, 3 });
+	matrix_t labels({ N, 1 });
+	auto noise = random({ N, 2 });
+	for (size_t i = 0; i < N; ++i)
+	{
+		size_t c = i % 3;
+		X({ i, 0 }) = (c == 1 ? 3.0 : 0.0) + noise({ i, 0 });
+		X({ i, 1 }) = (c == 2 ? 3.0 : 0.0) + noise({ i, 1 });
+		X({ i, 2 }) = 1.0;
+		labels({ i, 0 }) = static_cast<double>(c);
+	}
+
+	regression::multinomial model(3, 3);
+	optimizers::Adam adam(metrics::categorical_cross_entropy, 0.1, 200);
+	adam.optimize(model, { X }, one_hot(labels, 3));
+
+	ASSERT_EQ(model.predict(X), labels);
+
+	auto proba = model.predict_proba(X);
+	ASSERT_NEAR(proba.sum(1)({ 0, 0 }), 1.0, 1e-10);
+}
+
+TEST(MLRegressionTest, TestLogistic)
+{
+	size_t N = 60;
+	matrix_t X({ N, 2 });
+	matrix_t y({ N, 1 });
+	for (size_t i = 0; i < N; ++i)
+	{
+		double x = static_cast<double>(i) / N - 0.5;
+		X({ i, 0 }) = x;
+		X({ i, 1 }) = 1.0;
+		y({ i, 0 }) = x > 0.0 ? 1.0 : 0.0;
+	}
+
+	regression::logistic logreg(y, X);
+	optimizers::LBFGS lbfgs(metrics::cross_entropy, 20);
+	lbfgs.optimize(logreg, { X }, y);
+
+	auto yhat = logreg({ autograd::parameter(X) }).value();
+	ASSERT_LT(yhat({ 0, 0 }), 0.1);
+	ASSERT_GT(yhat({ N - 1, 0 }), 0.9);
+}
@@ -0,0 +1,80 @@
+#include "pch.h"
+
+using namespace ml;
+
+namespace
+{
+	matrix_t row_of(const matrix_t& X, size_t i)
+	{
+		size_t nCols = X.shape()[1];
+		matrix_t row({ 1, nCols });
+		for (size_t k = 0; k < nCols; ++k) { row.data()[k] = X.data()[k * X.shape()[0] + i]; }
+		return row;
+	}
+}
+
+TEST(MLServingTest, TestConcurrentRequests)
+{
+	nets::mlp net({ 12, 32, 4 }, layers::activation::relu, layers::activation::identity);
+	matrix_t X = random({ 400, 12 });
+	auto expected = net.predict(X);
+
+	serving::server_options options;
+	options.maxBatch = 32;
+	options.latencyBudget = std::chrono::milliseconds(2);
+	options.nWorkers = 2;
+	serving::inference_server server(net, options);
+
+	size_t nClients = 8;
+	size_t perClient = X.shape()[0] / nClients;
+	std::vector<matrix_t> results(X.shape()[0]);
+	std::vector<std::thread> clients;
+	for (size_t c = 0; c < nClients; ++c)
+	{
+		clients.emplace_back([&, c]()
+			{
+				std::vector<std::future<matrix_t>> futures;
+				for (size_t i = c * perClient; i < (c + 1) * perClient; ++i) { futures.push_back(server.submit(row_of(X, i))); }
+				for (size_t i = 0; i < perClient; ++i) { results[c * perClient + i] = futures[i].get(); }
+			});
+	}
+	for (auto& client : clients) { client.join(); }
+
+	for (size_t i = 0; i < X.shape()[0]; ++i)
+	{
+		ASSERT_EQ(results[i].shape(), nd::shape_t({ 1, 4 }));
+		for (size_t k = 0; k < 4; ++k) { ASSERT_NEAR(results[i].data()[k], expected({ i, k }), 1e-10); }
+	}
+
+	auto stats = server.stats();
+	ASSERT_EQ(stats.requests, X.shape()[0]);
+	ASSERT_LT(stats.batches, stats.requests);
+	ASSERT_GT(stats.meanBatchSize, 1.0);
+	ASSERT_LE(stats.p50LatencyMs, stats.p99LatencyMs);
+	ASSERT_GT(stats.requestsPerSec, 0.0);
+
+	server.reset_stats();
+	ASSERT_EQ(server.stats().requests, 0);
+}
+
+TEST(MLServingTest, TestRegressionModel)
+{
+	matrix_t X = random({ 50, 3 });
+	regression::logistic model(random({ 50, 1 }), X);
+	auto expected = model({ autograd::parameter(X) }).value();
+
+	serving::inference_server server(model, 3);
+	for (size_t i = 0; i < X.shape()[0]; ++i)
+	{
+		ASSERT_NEAR(server.predict(row_of(X, i)).data()[0], expected({ i, 0 }), 1e-12);
+	}
+}
+
+TEST(MLServingTest, TestErrors)
+{
+	serving::inference_server failing([](const matrix_t& X) -> matrix_t { throw std::invalid_argument("failed"); }, 2);
+	ASSERT_THROW(failing.submit(matrix_t({ 1, 3 })), std::invalid_argument);
+
+	auto result = failing.submit(matrix_t({ 1, 2 }));
+	ASSERT_THROW(result.get(), std::invalid_argument);
+}
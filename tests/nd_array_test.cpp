@@ -106,6 +106,74 @@ TEST(NDArrayTest, TestItemAccess)
 	ASSERT_ANY_THROW(mat3d.at({ 3, 0, 0 }));
 	ASSERT_ANY_THROW(mat3d.at({ 0, 2, 0 }));
 	ASSERT_ANY_THROW(mat3d.at({ 0, 0, 2 }));
+
+	ASSERT_EQ(mat3d(2, 1, 1), 12);
+	ASSERT_EQ(mat3d(1, 0, 1), mat3d({ 1, 0, 1 }));
+	mat3d(0, 1, 0) = 42;
+	ASSERT_EQ(mat3d({ 0, 1, 0 }), 42);
+}
+
+TEST(NDArrayTest, TestShapeTypes)
+{
+	nd::shape_t shape = { 3, 4, 5 };
+	ASSERT_EQ(shape.size(), 3);
+	ASSERT_EQ(shape.back(), 5);
+	ASSERT_EQ(shape, (nd::shape_t{ 3, 4, 5 }));
+	ASSERT_NE(shape, (nd::shape_t{ 3, 4 }));
+	ASSERT_EQ(std::hash<nd::shape_t>()(shape), std::hash<nd::shape_t>()(nd::shape_t{ 3, 4, 5 }));
+
+	shape.push_back(6);
+	shape.resize(2);
+	ASSERT_EQ(shape, (nd::shape_t{ 3, 4 }));
+	ASSERT_EQ(nd::calculate_strides({ 3, 4, 5 }), (nd::stride_t{ 1, 3, 12 }));
+	ASSERT_EQ(nd::offset_of(nd::calculate_strides({ 3, 4, 5 }), 2, 1, 3), nd::offset_of({ 2, 1, 3 }, nd::calculate_strides({ 3, 4, 5 })));
+
+	// Past the inline capacity the items move to the heap
+	nd::shape_t full(nd::max_dims, 1);
+	ASSERT_TRUE(full.is_inline());
+	full.push_back(full[0] + 1);
+	ASSERT_FALSE(full.is_inline());
+	ASSERT_EQ(full.size(), nd::max_dims + 1);
+	ASSERT_EQ(full.back(), 2);
+
+	nd::shape_t copied = full;
+	nd::shape_t moved = std::move(full);
+	ASSERT_EQ(copied, moved);
+	copied.resize(2);
+	ASSERT_EQ(copied, (nd::shape_t{ 1, 1 }));
+	moved = copied;
+	ASSERT_EQ(moved, copied);
+}
+
+TEST(NDArrayTest, TestHighRank)
+{
+	nd::shape_t shape = { 2, 3, 1, 2, 2, 1, 3, 2, 2 };
+	nd::array<> A(shape, 0.0);
+	ASSERT_EQ(A.dims(), 9);
+	ASSERT_EQ(A.N(), 288);
+	for (size_t k = 0; k < A.N(); ++k)
+	{
+		A.data()[k] = static_cast<double>(k);
+	}
+
+	// Column-major, so the offset is the dot product of the index with the strides
+	nd::stride_t strides = nd::calculate_strides(shape);
+	nd::index_t index = { 1, 2, 0, 1, 1, 0, 2, 1, 1 };
+	ASSERT_EQ(A(index), static_cast<double>(nd::offset_of(index, strides)));
+	A(index) = -1.0;
+	ASSERT_EQ(A.data()[nd::offset_of(index, strides)], -1.0);
+	A(index) = static_cast<double>(nd::offset_of(index, strides));
+
+	ASSERT_EQ(A.sum(), 287.0 * 288.0 / 2.0);
+	nd::array<> s = A.sum(8);
+	ASSERT_EQ(s.dims(), 9);
+	ASSERT_EQ(s.shape().back(), 1);
+	ASSERT_EQ(s.N(), 144);
+	ASSERT_EQ(s.data()[0], 0.0 + 144.0);
+
+	nd::array<> B = A + A;
+	ASSERT_EQ(B(index), 2.0 * A(index));
+	ASSERT_EQ(nd::array<>::stack({ A, A }, 9).dims(), 10);
 }
 
 TEST(NDArrayTest, TestSlicing)
@@ -191,6 +259,45 @@ TEST(NDArrayTest, TestSlicing)
 	ASSERT_EQ(slice3({ 0, 2, 1 }), 17);
 }
 
+TEST(NDArrayTest, TestFixedArray)
+{
+	nd::array<int> dynamic({ 3, 4, 2 });
+	fill_array(dynamic);
+
+	nd::fixed_array<int, 3> fixed(dynamic);
+	ASSERT_EQ(fixed.shape(), (std::array<size_t, 3>{ 3, 4, 2 }));
+	ASSERT_EQ(fixed.N(), dynamic.N());
+	for (size_t k = 0; k < 2; ++k)
+	{
+		for (size_t j = 0; j < 4; ++j)
+		{
+			for (size_t i = 0; i < 3; ++i) { ASSERT_EQ(fixed(i, j, k), dynamic({ i, j, k })); }
+		}
+	}
+	ASSERT_EQ(fixed({ 2, 3, 1 }), 24);
+	ASSERT_ANY_THROW(fixed.at(0, 4, 0));
+
+	fixed(1, 2, 1) = -1;
+	ASSERT_EQ(dynamic({ 1, 2, 1 }), 20);
+	ASSERT_EQ(fixed.dynamic()(1, 2, 1), -1);
+
+	auto slice = fixed.slice({ nd::range(1, 3), nd::range(0, 4, 2), nd::range(1, 2) });
+	ASSERT_EQ(slice.shape(), (std::array<size_t, 3>{ 2, 2, 1 }));
+	ASSERT_EQ(slice.dynamic(), fixed.dynamic()(std::vector<nd::range>{ nd::range(1, 3), nd::range(0, 4, 2), nd::range(1, 2) }));
+	ASSERT_EQ(slice(0, 1, 0), -1);
+
+	nd::array<int> back = fixed.release();
+	ASSERT_EQ(back.shape(), (nd::shape_t{ 3, 4, 2 }));
+	ASSERT_EQ(back({ 1, 2, 1 }), -1);
+	ASSERT_TRUE(fixed.empty());
+
+	nd::fixed_matrix<> m({ 2, 3 }, 1.5);
+	const nd::array<>& view = m;
+	ASSERT_EQ(view.shape(), (nd::shape_t{ 2, 3 }));
+	ASSERT_EQ(m(1, 2), 1.5);
+	ASSERT_THROW((nd::fixed_matrix<>(nd::array<>({ 2, 3, 4 }))), std::invalid_argument);
+}
+
 TEST(NDArrayTest, TestReshape)
 {
 	/*
@@ -256,6 +363,70 @@ TEST(NDArrayTest, TestTranspose)
 	ASSERT_ANY_THROW(mat3d.T());
 }
 
+TEST(NDArrayTest, TestConcat)
+{
+	nd::array<> A = nd::array<>::random({ 3, 4, 2 });
+	nd::array<> B = nd::array<>::random({ 3, 4, 5 });
+	nd::array<> C = nd::array<>::random({ 3, 4, 1 });
+
+	auto joined = nd::array<>::concatenate({ A, B, C }, 2);
+	ASSERT_EQ(joined.shape(), (nd::shape_t{ 3, 4, 8 }));
+	ASSERT_EQ(joined(std::vector<nd::range>{ 3_r, 4_r, nd::range(0, 2) }), A);
+	ASSERT_EQ(joined(std::vector<nd::range>{ 3_r, 4_r, nd::range(2, 7) }), B);
+	ASSERT_EQ(joined(std::vector<nd::range>{ 3_r, 4_r, nd::range(7, 8) }), C);
+
+	nd::array<> D = nd::array<>::random({ 3, 6, 2 });
+	auto alongColumns = A.concat(D, 1);
+	ASSERT_EQ(alongColumns.shape(), (nd::shape_t{ 3, 10, 2 }));
+	for (size_t k = 0; k < 2; ++k)
+	{
+		for (size_t j = 0; j < 10; ++j)
+		{
+			for (size_t i = 0; i < 3; ++i) { ASSERT_EQ(alongColumns(i, j, k), (j < 4) ? A(i, j, k) : D(i, j - 4, k)); }
+		}
+	}
+	ASSERT_ANY_THROW(A.concat(D, 0));
+
+	// Large enough to be copied in parallel
+	std::vector<nd::array<>> parts;
+	for (size_t n = 0; n < 8; ++n) { parts.push_back(nd::array<>({ 5000, 3 }, static_cast<double>(n))); }
+	auto rows = nd::array<>::concatenate(parts, 0);
+	ASSERT_EQ(rows.shape(), (nd::shape_t{ 40000, 3 }));
+	ASSERT_EQ(rows(12345, 2), 2.0);
+	ASSERT_EQ(rows.sum(), 3 * 5000 * 28.0);
+
+	nd::array<> squares = A.hadamard(A);
+	auto stacked = nd::array<>::stack({ A, squares }, 1);
+	ASSERT_EQ(stacked.shape(), (nd::shape_t{ 3, 2, 4, 2 }));
+	ASSERT_EQ(stacked(2, 0, 3, 1), A(2, 3, 1));
+	ASSERT_EQ(stacked(2, 1, 3, 1), A(2, 3, 1) * A(2, 3, 1));
+	ASSERT_EQ(nd::array<>::stack({ A, squares }, 3).shape(), (nd::shape_t{ 3, 4, 2, 2 }));
+	ASSERT_ANY_THROW(nd::array<>::stack({ A, C }, 0));
+}
+
+TEST(NDArrayTest, TestAppend)
+{
+	nd::array<> built;
+	nd::array<> column({ 4, 1 });
+	for (size_t j = 0; j < 100; ++j)
+	{
+		for (size_t i = 0; i < 4; ++i) { column(i, 0) = static_cast<double>(i + 4 * j); }
+		built.append(column);
+	}
+	ASSERT_EQ(built.shape(), (nd::shape_t{ 4, 100 }));
+	ASSERT_LE(built.capacity(), 2 * built.N());
+	for (size_t n = 0; n < built.N(); ++n) { ASSERT_EQ(built.data()[n], static_cast<double>(n)); }
+
+	built.append(nd::array<>(nd::shape_t{ 4 }, -1.0));
+	ASSERT_EQ(built.shape(), (nd::shape_t{ 4, 101 }));
+	ASSERT_EQ(built(3, 100), -1.0);
+
+	built.append(built);
+	ASSERT_EQ(built.shape(), (nd::shape_t{ 4, 202 }));
+	ASSERT_EQ(built(1, 102), 5.0);
+	ASSERT_ANY_THROW(built.append(nd::array<>({ 3, 1 })));
+}
+
 TEST(NDArrayTest, TestArithmetic)
 {
 	/*
@@ -356,6 +527,338 @@ TEST(NDArrayTest, TestMatMul)
 	ASSERT_ANY_THROW(y * X);
 }
 
+TEST(NDArrayTest, TestPermute)
+{
+	nd::array<> A = nd::array<>::random({ 3, 4, 5 });
+	auto P = A.permute({ 2, 0, 1 });
+	ASSERT_EQ(P.shape(), (nd::shape_t{ 5, 3, 4 }));
+	for (size_t k = 0; k < 5; ++k)
+	{
+		for (size_t j = 0; j < 4; ++j)
+		{
+			for (size_t i = 0; i < 3; ++i) { ASSERT_EQ(P(k, i, j), A(i, j, k)); }
+		}
+	}
+
+	nd::array<> M = nd::array<>::random({ 300, 70 });
+	ASSERT_EQ(M.permute({ 1, 0 }), M.T());
+	ASSERT_ANY_THROW(A.permute({ 0, 0, 1 }));
+}
+
+TEST(NDArrayTest, TestBatchedMatMul)
+{
+	nd::array<> A = nd::array<>::random({ 3, 4, 2, 5 });
+	nd::array<> B = nd::array<>::random({ 4, 6, 2, 5 });
+	nd::array<> W = nd::array<>::random({ 4, 6 });
+	nd::array<> V = nd::array<>::random({ 7, 3 });
+
+	auto C = nd::matmul(A, B);
+	auto CW = nd::matmul(A, W);
+	auto VA = nd::matmul(V, A);
+	ASSERT_EQ(C.shape(), (nd::shape_t{ 3, 6, 2, 5 }));
+	ASSERT_EQ(CW.shape(), (nd::shape_t{ 3, 6, 2, 5 }));
+	ASSERT_EQ(VA.shape(), (nd::shape_t{ 7, 4, 2, 5 }));
+
+	for (size_t b1 = 0; b1 < 5; ++b1)
+	{
+		for (size_t b0 = 0; b0 < 2; ++b0)
+		{
+			auto Ab = A(std::vector<nd::range>{ 3_r, 4_r, nd::range(b0, b0 + 1), nd::range(b1, b1 + 1) }).reshape({ 3, 4 });
+			auto Bb = B(std::vector<nd::range>{ 4_r, 6_r, nd::range(b0, b0 + 1), nd::range(b1, b1 + 1) }).reshape({ 4, 6 });
+			auto expected = Ab * Bb;
+			auto expectedW = Ab * W;
+			auto expectedV = V * Ab;
+			for (size_t j = 0; j < 6; ++j)
+			{
+				for (size_t i = 0; i < 3; ++i)
+				{
+					ASSERT_NEAR(C(i, j, b0, b1), expected(i, j), 1e-12);
+					ASSERT_NEAR(CW(i, j, b0, b1), expectedW(i, j), 1e-12);
+				}
+			}
+			for (size_t j = 0; j < 4; ++j)
+			{
+				for (size_t i = 0; i < 7; ++i) { ASSERT_NEAR(VA(i, j, b0, b1), expectedV(i, j), 1e-12); }
+			}
+		}
+	}
+
+	ASSERT_ANY_THROW(nd::matmul(A, nd::array<>({ 4, 6, 3, 5 })));
+	ASSERT_ANY_THROW(nd::matmul(A, nd::array<>({ 5, 6 })));
+}
+
+TEST(NDArrayTest, TestMatVecDispatch)
+{
+	auto naive = [](const nd::array<>& A, const nd::array<>& B)
+		{
+			size_t m = A.shape()[0], k = A.shape()[1], n = B.shape()[1];
+			nd::array<> C({ m, n }, 0.0);
+			for (size_t j = 0; j < n; ++j)
+			{
+				for (size_t i = 0; i < m; ++i)
+				{
+					for (size_t p = 0; p < k; ++p) { C(i, j) += A(i, p) * B(p, j); }
+				}
+			}
+			return C;
+		};
+
+	nd::array<> X = nd::array<>::random({ 7, 4 });
+	nd::array<> w = nd::array<>::random({ 4, 1 });
+	nd::array<> r = nd::array<>::random({ 1, 7 });
+	nd::array<> u = nd::array<>::random({ 7, 1 });
+	nd::array<> v = nd::array<>::random({ 1, 5 });
+
+	ASSERT_TRUE((X * w).approx_equal(naive(X, w)));
+	ASSERT_TRUE((r * X).approx_equal(naive(r, X)));
+	ASSERT_TRUE((u * v).approx_equal(naive(u, v)));
+	ASSERT_TRUE((r * u).approx_equal(naive(r, u)));
+
+	nd::array<> x(w);
+	x.reshape({ 4 });
+	nd::array<> Xx = X * x;
+	ASSERT_EQ(Xx.shape(), nd::shape_t{ 7 });
+	ASSERT_TRUE(Xx.reshape({ 7, 1 }).approx_equal(naive(X, w)));
+
+	nd::array<> a = nd::array<>::random(nd::shape_t{ 6 });
+	nd::array<> b = nd::array<>::random(nd::shape_t{ 6 });
+	double expected = 0.0;
+	for (size_t i = 0; i < 6; ++i) { expected += a(i) * b(i); }
+	ASSERT_NEAR((a * b).data()[0], expected, 1e-12);
+
+	ASSERT_TRUE(X.gram().approx_equal(naive(X.T(), X)));
+}
+
+TEST(NDArrayTest, TestGemmInto)
+{
+	nd::array<> A = nd::array<>::random({ 5, 3 });
+	nd::array<> B = nd::array<>::random({ 3, 4 });
+	nd::array<> Bt = B.T();
+	nd::array<> C0 = nd::array<>::random({ 5, 4 });
+
+	// Accumulating writes into the existing buffer
+	nd::array<> C(C0);
+	const double* buffer = C.data();
+	nd::array<>::gemm_into(C, A, B, 2.0, 0.5);
+	ASSERT_EQ(C.data(), buffer);
+	ASSERT_TRUE(C.approx_equal((A * B) * 2.0 + C0 * 0.5));
+
+	nd::array<> CT;
+	nd::array<>::gemm_into(CT, A.T(), Bt, 1.0, 0.0, true, true);
+	ASSERT_TRUE(CT.approx_equal(A * B));
+
+	// Rank-1 update and transposed matrix-vector products
+	nd::array<> x = nd::array<>::random({ 5, 1 });
+	nd::array<> y = nd::array<>::random({ 4, 1 });
+	nd::array<> D(C0);
+	nd::array<>::gemm_into(D, x, y, -1.0, 1.0, false, true);
+	ASSERT_TRUE(D.approx_equal(C0 - x * y.T()));
+
+	nd::array<> g({ 3, 1 }, 1.0);
+	nd::array<>::gemm_into(g, A, x, 1.0, 1.0, true);
+	ASSERT_TRUE(g.approx_equal(A.T() * x + nd::array<>({ 3, 1 }, 1.0)));
+
+	nd::array<> G = nd::array<>::random({ 3, 3 });
+	nd::array<> S = G + G.T();
+	nd::array<> S0(S);
+	nd::array<>::syrk_into(S, A, 1.0, 1.0);
+	ASSERT_TRUE(S.approx_equal(A.T() * A + S0));
+
+	nd::array<> wrong({ 2, 2 });
+	ASSERT_THROW(nd::array<>::gemm_into(wrong, A, B, 1.0, 1.0), std::invalid_argument);
+	ASSERT_THROW(nd::array<>::gemm_into(C, C, nd::array<>::random({ 4, 4 })), std::invalid_argument);
+	ASSERT_THROW(nd::array<>::gemm_into(C, A, A), std::invalid_argument);
+}
+
+TEST(NDArrayTest, TestOutputVariants)
+{
+	nd::array<> A = nd::array<>::random({ 4, 3 });
+	nd::array<> B = nd::array<>::random({ 4, 3 });
+
+	nd::array<> out;
+	nd::array<>::add_into(out, A, B);
+	const double* buffer = out.data();
+	ASSERT_TRUE(out.approx_equal(A + B));
+
+	nd::array<>::subtract_into(out, A, B);
+	nd::array<>::hadamard_into(out, out, B);
+	ASSERT_EQ(out.data(), buffer);
+	ASSERT_TRUE(out.approx_equal((A - B).hadamard(B)));
+
+	nd::array<>::multiply_into(out, A, 3.0);
+	nd::array<>::subtract_into(out, 1.0, out);
+	ASSERT_EQ(out.data(), buffer);
+	ASSERT_TRUE(out.approx_equal(1.0 - A * 3.0));
+
+	nd::array<>::map_into(out, A, [](double x) { return x * x; });
+	ASSERT_TRUE(out.approx_equal(A.hadamard(A)));
+
+	nd::array<> C(A);
+	C.add_scaled(B, -2.0).add_hadamard(A, B);
+	ASSERT_TRUE(C.approx_equal(A - B * 2.0 + A.hadamard(B)));
+	C.apply([](double x) { return -x; });
+	ASSERT_TRUE(C.approx_equal((A - B * 2.0 + A.hadamard(B)) * -1.0));
+
+	nd::array<> sums;
+	A.reduce_into(sums, { 0 }, nd::reduction::sum);
+	const double* sumsBuffer = sums.data();
+	B.reduce_into(sums, { 0 }, nd::reduction::sum);
+	ASSERT_EQ(sums.data(), sumsBuffer);
+	ASSERT_TRUE(sums.approx_equal(B.sum(0)));
+
+	nd::array<> At;
+	nd::array<>::transpose_into(At, A);
+	ASSERT_TRUE(At.approx_equal(A.T()));
+
+	// Outputs may be an operand, but not overlap one partially or be a view of the wrong shape
+	nd::array<> view = nd::array<>::view(A.data() + 1, { 4, 2 });
+	ASSERT_THROW(nd::array<>::map_into(view, A, [](double x) { return x; }), std::invalid_argument);
+	ASSERT_THROW(A.reduce_into(A, { 0 }, nd::reduction::sum), std::invalid_argument);
+	ASSERT_THROW(nd::array<>::transpose_into(A, A), std::invalid_argument);
+	nd::array<> small = nd::array<>::view(out.data(), { 2, 2 });
+	ASSERT_THROW(nd::array<>::add_into(small, B, B), std::invalid_argument);
+}
+
+TEST(NDArrayTest, TestRandom)
+{
+	// Known answer from the Random123 test vectors
+	auto block = nd::philox::block(0, 0);
+	ASSERT_EQ(block, (nd::philox::block_t{ 0x6627e8d5, 0xe169c58d, 0xbc57ac4c, 0x9b00dbd8 }));
+
+	// Every value depends only on the seed and its position, not on how the fill was split
+	nd::random_generator generator(42);
+	nd::array<> U = nd::array<>::random({ 1001, 301 }, generator);
+	for (size_t i : { size_t(0), size_t(1), size_t(77777), U.N() - 1 })
+	{
+		auto b = nd::philox::block(i / 2, 42);
+		uint64_t bits = (i % 2 == 0) ? ((uint64_t(b[0]) << 32) | b[1]) : ((uint64_t(b[2]) << 32) | b[3]);
+		ASSERT_EQ(U.data()[i], static_cast<double>(bits >> 11) * 0x1.0p-53);
+	}
+	ASSERT_GE(U.min(), 0.0);
+	ASSERT_LT(U.max(), 1.0);
+	ASSERT_NEAR(U.mean(), 0.5, 0.01);
+
+	// Later fills continue the stream, reseeding repeats it
+	nd::array<> next = nd::array<>::random({ 1001, 301 }, generator);
+	ASSERT_FALSE(next.approx_equal(U));
+	generator.seed(42);
+	ASSERT_TRUE(nd::array<>::random({ 1001, 301 }, generator).approx_equal(U, 0.0));
+
+	nd::array<> Z = nd::array<>::random_normal(nd::shape_t{ 200001 }, 2.0, 3.0, generator);
+	ASSERT_NEAR(Z.mean(), 2.0, 0.05);
+	ASSERT_NEAR(Z.stddev(), 3.0, 0.05);
+
+	nd::array<> mask = nd::array<>::bernoulli(nd::shape_t{ 100000 }, 0.3, generator);
+	ASSERT_EQ(mask.hadamard(mask).sum(), mask.sum());
+	ASSERT_NEAR(mask.mean(), 0.3, 0.01);
+
+	nd::seed(7);
+	nd::array<> first = nd::array<>::random({ 3, 3 });
+	nd::seed(7);
+	ASSERT_TRUE(nd::array<>::random({ 3, 3 }).approx_equal(first, 0.0));
+}
+
+TEST(NDArrayTest, TestProfiler)
+{
+	auto& profiler = nd::profiling::profiler::global();
+	profiler.clear();
+
+	// Nothing is recorded while stopped
+	{
+		nd::profiling::scope ignored("test", "stopped");
+	}
+
+	profiler.start();
+	for (int i = 0; i < 3; ++i)
+	{
+		nd::profiling::scope outer("test", "outer");
+		nd::profiling::add_flops(100);
+		{
+			nd::profiling::scope inner("test", "inner \"quoted\"");
+			nd::profiling::add_allocation(64);
+			nd::profiling::add_flops(10);
+		}
+	}
+	profiler.stop();
+
+	auto events = profiler.events();
+	ASSERT_EQ(events.size(), 6);
+	auto summary = profiler.summary();
+	ASSERT_EQ(summary.size(), 2);
+	for (auto& op : summary)
+	{
+		ASSERT_EQ(op.calls, 3);
+		ASSERT_EQ(op.allocations, 3);
+		ASSERT_EQ(op.bytesAllocated, 3 * 64);
+		ASSERT_DOUBLE_EQ(op.flops, (op.name == "outer") ? 330.0 : 30.0);
+	}
+	ASSERT_GE(summary[0].totalMs, summary[1].totalMs);
+
+	std::ostringstream trace;
+	profiler.write_chrome_trace(trace);
+	ASSERT_NE(trace.str().find("\"traceEvents\""), std::string::npos);
+	ASSERT_NE(trace.str().find("\"name\":\"inner \\\"quoted\\\"\""), std::string::npos);
+	ASSERT_NE(trace.str().find("\"ph\":\"X\""), std::string::npos);
+
+	std::ostringstream table;
+	profiler.write_summary(table);
+	ASSERT_NE(table.str().find("outer"), std::string::npos);
+
+	profiler.clear();
+	ASSERT_TRUE(profiler.events().empty());
+}
+
+TEST(NDArrayTest, TestContractions)
+{
+	nd::array<> A = nd::array<>::random({ 3, 4, 5 });
+	nd::array<> B = nd::array<>::random({ 5, 4, 2 });
+
+	// Contract A's dimensions 1 and 2 with B's 1 and 0, which needs B permuted
+	auto T = nd::tensordot(A, B, { 1, 2 }, { 1, 0 });
+	ASSERT_EQ(T.shape(), (nd::shape_t{ 3, 2 }));
+	for (size_t j = 0; j < 2; ++j)
+	{
+		for (size_t i = 0; i < 3; ++i)
+		{
+			double expected = 0.0;
+			for (size_t p = 0; p < 4; ++p)
+			{
+				for (size_t q = 0; q < 5; ++q) { expected += A(i, p, q) * B(q, p, j); }
+			}
+			ASSERT_NEAR(T(i, j), expected, 1e-12);
+		}
+	}
+
+	// Leading contracted dimension of A runs as a transposed GEMM
+	nd::array<> M = nd::array<>::random({ 3, 6 });
+	auto L = nd::tensordot(A, M, { 0 }, { 0 });
+	ASSERT_EQ(L.shape(), (nd::shape_t{ 4, 5, 6 }));
+	double expected = 0.0;
+	for (size_t p = 0; p < 3; ++p) { expected += A(p, 2, 4) * M(p, 5); }
+	ASSERT_NEAR(L(2, 4, 5), expected, 1e-12);
+
+	nd::array<> X = nd::array<>::random({ 4, 3 });
+	nd::array<> Y = nd::array<>::random({ 3, 5 });
+	ASSERT_TRUE(nd::tensordot(X, Y).approx_equal(X * Y, 1e-12));
+	ASSERT_TRUE(nd::einsum("ij,jk->ik", X, Y).approx_equal(X * Y, 1e-12));
+	ASSERT_TRUE(nd::einsum("ij,jk->ki", X, Y).approx_equal((X * Y).T(), 1e-12));
+	ASSERT_TRUE(nd::einsum("ij->ji", X).approx_equal(X.T(), 1e-12));
+	ASSERT_TRUE(nd::einsum("ij->j", X).approx_equal(X.sum(0).reshape({ 3 }), 1e-12));
+	ASSERT_NEAR(nd::einsum("ij,ij->", X, X)(0), X.hadamard(X).sum(), 1e-12);
+
+	// Batched: the batch label b is the last dimension of both operands and the output
+	nd::array<> P = nd::array<>::random({ 3, 4, 6 });
+	nd::array<> Q = nd::array<>::random({ 4, 2, 6 });
+	ASSERT_TRUE(nd::einsum("ijb,jkb->ikb", P, Q).approx_equal(nd::matmul(P, Q), 1e-12));
+
+	auto outer = nd::einsum("bi,bj->ijb", nd::array<>::random({ 6, 3 }), nd::array<>::random({ 6, 2 }));
+	ASSERT_EQ(outer.shape(), (nd::shape_t{ 3, 2, 6 }));
+
+	ASSERT_ANY_THROW(nd::einsum("ii->i", M));
+	ASSERT_ANY_THROW(nd::einsum("ij,jk", X, Y));
+	ASSERT_ANY_THROW(nd::einsum("ij,jk->iz", X, Y));
+}
+
 TEST(NDArrayTest, TestMean)
 {
 	/*
@@ -429,4 +932,198 @@ TEST(NDArrayTest, TestMean)
 	ASSERT_DOUBLE_EQ(mean4({ 1, 1, 0 }), 6);
 
 	ASSERT_ANY_THROW(mat2d.mean(3));
-}
\ No newline at end of file
+}
+
+TEST(NDArrayTest, TestReductions)
+{
+	auto check = [](const nd::array<>& A, const std::vector<size_t>& axes)
+		{
+			nd::shape_t outShape = nd::reduced_shape(A.shape(), axes);
+			nd::array<> sum(outShape), maxv(outShape, -1e300), minv(outShape, 1e300), argmax(outShape), count(outShape);
+			nd::array<> sq(outShape);
+
+			// Brute force over every item, positions within the reduced dimensions counted in column-major order
+			nd::index_t index = A.zero_index();
+			for (size_t n = 0; n < A.N(); ++n)
+			{
+				nd::index_t o = index;
+				for (auto axis : axes) { o[axis] = 0; }
+				double x = A(index);
+				sum(o) += x;
+				sq(o) += x * x;
+				if (x > maxv(o)) { maxv(o) = x; argmax(o) = count(o); }
+				minv(o) = std::min(minv(o), x);
+				count(o) += 1;
+				nd::increment_index(index, A.shape());
+			}
+
+			auto actualSum = A.sum(axes);
+			auto actualMean = A.mean(axes);
+			auto actualVar = A.variance(axes);
+			auto actualMax = A.max(axes);
+			auto actualMin = A.min(axes);
+			auto actualArgmax = A.reduce(axes, nd::reduction::argmax);
+			ASSERT_EQ(actualSum.shape(), outShape);
+			for (size_t i = 0; i < sum.N(); ++i)
+			{
+				double n = count.data()[i], mean = sum.data()[i] / n;
+				ASSERT_NEAR(actualSum.data()[i], sum.data()[i], 1e-9);
+				ASSERT_NEAR(actualMean.data()[i], mean, 1e-12);
+				ASSERT_NEAR(actualVar.data()[i], sq.data()[i] / n - mean * mean, 1e-9);
+				ASSERT_EQ(actualMax.data()[i], maxv.data()[i]);
+				ASSERT_EQ(actualMin.data()[i], minv.data()[i]);
+				ASSERT_EQ(actualArgmax.data()[i], argmax.data()[i]);
+			}
+		};
+
+	nd::array<> A = nd::array<>::random({ 5, 4, 3 });
+	for (auto& axes : std::vector<std::vector<size_t>>{ { 0 }, { 1 }, { 2 }, { 0, 1 }, { 0, 2 }, { 1, 2 }, { 0, 1, 2 } })
+	{
+		check(A, axes);
+	}
+
+	// Large enough to be split across threads
+	nd::array<> B = nd::array<>::random({ 3000, 40 });
+	check(B, { 0 });
+	check(B, { 1 });
+
+	nd::array<> M({ 2, 3 });
+	fill_array(M);
+	ASSERT_EQ(M.argmax(1), (nd::array<>({ 2, 1 }, 2.0)));
+	ASSERT_EQ(M.argmin(0), (nd::array<>({ 1, 3 }, 0.0)));
+	ASSERT_NEAR(M.stddev(0)(0, 2), 0.5, 1e-12);
+	ASSERT_ANY_THROW(M.sum(std::vector<size_t>{ 0, 2 }));
+}
+
+TEST(NDArrayTest, TestTake)
+{
+	/*
+	* 1 4
+	* 2 5
+	* 3 6
+	*/
+	nd::array<int> mat2d({ 3, 2 });
+	fill_array(mat2d);
+
+	/*
+	* 3 6
+	* 1 4
+	*/
+	auto rows = mat2d.take(std::vector<size_t>{ 2, 0 });
+	ASSERT_EQ(rows.shape()[0], 2);
+	ASSERT_EQ(rows.shape()[1], 2);
+	ASSERT_EQ(rows({ 0, 0 }), 3);
+	ASSERT_EQ(rows({ 0, 1 }), 6);
+	ASSERT_EQ(rows({ 1, 0 }), 1);
+	ASSERT_EQ(rows({ 1, 1 }), 4);
+
+	/*
+	* 4
+	* 5
+	* 6
+	*/
+	auto cols = mat2d.take(std::vector<size_t>{ 1 }, 1);
+	ASSERT_EQ(cols.shape()[0], 3);
+	ASSERT_EQ(cols.shape()[1], 1);
+	ASSERT_EQ(cols({ 0, 0 }), 4);
+	ASSERT_EQ(cols({ 2, 0 }), 6);
+
+	ASSERT_ANY_THROW(mat2d.take(std::vector<size_t>{ 3 }));
+}
+
+TEST(NDArrayTest, TestSolvers)
+{
+	/*
+	* 4 2 0
+	* 2 5 1
+	* 0 1 3
+	*/
+	nd::array<> A({ 3, 3 });
+	A({ 0, 0 }) = 4; A({ 0, 1 }) = 2;
+	A({ 1, 0 }) = 2; A({ 1, 1 }) = 5; A({ 1, 2 }) = 1;
+	A({ 2, 1 }) = 1; A({ 2, 2 }) = 3;
+
+	nd::array<> x({ 3, 1 });
+	fill_array(x);
+	auto b = A * x;
+
+	ASSERT_TRUE(A.solve(b).approx_equal(x, 1e-10));
+	ASSERT_TRUE(A.cholesky_solve(b).approx_equal(x, 1e-10));
+
+	auto L = A.cholesky();
+	ASSERT_DOUBLE_EQ(L({ 0, 1 }), 0.0);
+	ASSERT_TRUE((L * L.T()).approx_equal(A, 1e-10));
+
+	nd::array<> M({ 4, 3 });
+	fill_array(M);
+	M({ 0, 0 }) = 10;
+
+	auto [Q, R] = M.qr();
+	ASSERT_EQ(Q.shape()[0], 4);
+	ASSERT_EQ(Q.shape()[1], 3);
+	ASSERT_EQ(R.shape()[0], 3);
+	ASSERT_EQ(R.shape()[1], 3);
+	ASSERT_DOUBLE_EQ(R({ 2, 0 }), 0.0);
+	ASSERT_TRUE((Q * R).approx_equal(M, 1e-10));
+	ASSERT_TRUE((Q.T() * Q).approx_equal(nd::array<>::identity(3), 1e-10));
+
+	auto y = M * x;
+	ASSERT_TRUE(M.qr_solve(y).approx_equal(x, 1e-10));
+	ASSERT_TRUE(M.lstsq(y).approx_equal(x, 1e-10));
+
+	nd::array<> yv(nd::shape_t{ 4 });
+	std::copy(y.data(), y.data() + 4, yv.data());
+	auto xv = M.lstsq(yv);
+	ASSERT_EQ(xv.shape(), (nd::shape_t{ 3 }));
+	ASSERT_NEAR(xv({ 2 }), x({ 2, 0 }), 1e-10);
+
+	ASSERT_ANY_THROW(M.solve(y));
+}
+
+TEST(NDArrayTest, TestSparse)
+{
+	/*
+	* 1 0 2
+	* 0 0 3
+	* 4 0 0
+	* 0 5 0
+	*/
+	nd::array<> dense({ 4, 3 });
+	dense({ 0, 0 }) = 1; dense({ 0, 2 }) = 2;
+	dense({ 1, 2 }) = 3;
+	dense({ 2, 0 }) = 4;
+	dense({ 3, 1 }) = 5;
+
+	auto csr = nd::sparse_array<>::from_dense(dense);
+	ASSERT_EQ(csr.nnz(), 5);
+	ASSERT_EQ(csr.pointers(), (std::vector<MKL_INT>{ 0, 2, 3, 4, 5 }));
+	ASSERT_EQ(csr.indices(), (std::vector<MKL_INT>{ 0, 2, 2, 0, 1 }));
+	ASSERT_TRUE(csr.to_dense().approx_equal(dense));
+
+	auto csc = csr.to_format(nd::sparse_format::csc);
+	ASSERT_EQ(csc.pointers(), (std::vector<MKL_INT>{ 0, 2, 3, 5 }));
+	ASSERT_TRUE(csc.to_dense().approx_equal(dense));
+	ASSERT_TRUE(nd::sparse_array<>::from_dense(dense, nd::sparse_format::csc).to_dense().approx_equal(dense));
+	ASSERT_TRUE(csr.T().to_dense().approx_equal(dense.T()));
+
+	nd::array<> B({ 3, 2 });
+	fill_array(B);
+	nd::array<> C({ 4, 2 });
+	fill_array(C);
+	nd::array<> v({ 3, 1 });
+	fill_array(v);
+
+	ASSERT_TRUE((csr * B).approx_equal(dense * B, 1e-12));
+	ASSERT_TRUE((csc * B).approx_equal(dense * B, 1e-12));
+	ASSERT_TRUE((csr * v).approx_equal(dense * v, 1e-12));
+	ASSERT_TRUE(csr.transpose_multiply(C).approx_equal(dense.T() * C, 1e-12));
+	ASSERT_TRUE(csc.transpose_multiply(C).approx_equal(dense.T() * C, 1e-12));
+
+	auto rows = csc.take(std::vector<size_t>{ 3, 0 });
+	ASSERT_EQ(rows.format(), nd::sparse_format::csr);
+	ASSERT_TRUE(rows.to_dense().approx_equal(dense.take(std::vector<size_t>{ 3, 0 })));
+
+	ASSERT_ANY_THROW(csr * C);
+	ASSERT_ANY_THROW(nd::sparse_array<>({ 2, 2 }, nd::sparse_format::csr, { 0, 1 }, { 0 }, { 1.0 }));
+	ASSERT_ANY_THROW(nd::sparse_array<>({ 2, 2 }, nd::sparse_format::csr, { 0, 1, 1 }, { 2 }, { 1.0 }));
+}
@@ -8,6 +8,9 @@
 
 #include "ndimensions/utils.hpp"
 #include "ndimensions/array.hpp"
+#include "ndimensions/sparse.hpp"
+#include "ndimensions/fixed_array.hpp"
+#include "ndimensions/contraction.hpp"
 
 #include "ml/data.hpp"
 #include "ml/math.hpp"
@@ -15,4 +18,7 @@
 #include "ml/optimizers.hpp"
 #include "ml/regression.hpp"
 #include "ml/layers.hpp"
-#include "ml/nets.hpp"
\ No newline at end of file
+#include "ml/nets.hpp"
+#include "ml/quantization.hpp"
+#include "ml/checkpoint.hpp"
+#include "ml/serving.hpp"
\ No newline at end of file